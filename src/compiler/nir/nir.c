@@ -52,6 +52,10 @@ static const struct debug_named_value nir_debug_control[] = {
      "Validate even if a pass does not make progress and test that it properly preserves all types of metadata. This can be very slow" },
    { "invalidate_metadata", NIR_DEBUG_INVALIDATE_METADATA,
      "Invalidate metadata before passes to try to find passes which don't require metadata that they use. This overrides NIR_DEBUG=extended_validation somewhat" },
+   { "incremental_validation", NIR_DEBUG_INCREMENTAL_VALIDATION,
+     "Only validate function implementations which made progress since they were last validated, with a full validation every NIR_VALIDATE_FULL_INTERVAL validations" },
+   { "pass_timing", NIR_DEBUG_PASS_TIMING,
+     "Record the time spent in each lowering/optimization pass and how often it made progress, and dump the statistics of the process as JSON at exit" },
    { "tgsi", NIR_DEBUG_TGSI,
      "Dump NIR/TGSI shaders when doing a NIR<->TGSI translation" },
    { "print", NIR_DEBUG_PRINT,
@@ -570,6 +574,7 @@ nir_function_impl_create_bare(nir_shader *shader)
    impl->ssa_alloc = 0;
    impl->num_blocks = 0;
    impl->valid_metadata = nir_metadata_none;
+   impl->validation_dirty = true;
    impl->structured = true;
 
    /* create start & end blocks */
@@ -91,6 +91,8 @@ extern bool nir_debug_print_shader[MESA_SHADER_KERNEL + 1];
 #define NIR_DEBUG_PRINT_INTERNAL         (1u << 21)
 #define NIR_DEBUG_PRINT_PASS_FLAGS       (1u << 22)
 #define NIR_DEBUG_INVALIDATE_METADATA    (1u << 23)
+#define NIR_DEBUG_INCREMENTAL_VALIDATION (1u << 24)
+#define NIR_DEBUG_PASS_TIMING            (1u << 25)
 
 #define NIR_DEBUG_PRINT (NIR_DEBUG_PRINT_VS |  \
                          NIR_DEBUG_PRINT_TCS | \
@@ -3396,6 +3398,16 @@ typedef struct nir_function_impl {
    bool structured;
 
    nir_metadata valid_metadata;
+
+   /** True if this implementation changed since it was last validated
+    *
+    * Set by nir_progress() whenever a pass reports progress on the impl and
+    * cleared by nir_validate_shader().  With
+    * NIR_DEBUG=incremental_validation, clean impls are skipped by the
+    * validator except on the periodic full validation.
+    */
+   bool validation_dirty;
+
    nir_variable_mode loop_analysis_indirect_mask;
    bool loop_analysis_force_unroll_sampler_indirect;
 } nir_function_impl;
@@ -3710,6 +3722,13 @@ typedef struct nir_shader {
    u_printf_info *printf_info;
 
    bool has_debug_info;
+
+   /** Per-pass statistics gathered with NIR_DEBUG=pass_timing
+    *
+    * Maps pass names to internal statistics records; use
+    * nir_print_pass_timing() to access them.
+    */
+   struct hash_table *pass_stats;
 } nir_shader;
 
 #define nir_foreach_function(func, shader) \
@@ -3807,6 +3826,18 @@ nir_shader_get_function_for_name(const nir_shader *shader, const char *name)
    return NULL;
 }
 
+/* Name to nir_function tables, for looking up many functions by name in
+ * shaders with lots of them such as libclc.  Like
+ * nir_shader_get_function_for_name(), the first function of a given name
+ * wins.
+ */
+struct hash_table *
+nir_function_name_table_create(void *mem_ctx, const nir_shader *shader);
+void nir_function_name_table_add(struct hash_table *table,
+                                 nir_function *func);
+nir_function *nir_function_name_table_lookup(struct hash_table *table,
+                                             const char *name);
+
 /*
  * After all functions are forcibly inlined, these passes remove redundant
  * functions from a shader and library respectively.
@@ -4542,6 +4573,23 @@ void nir_metadata_set_validation_flag(nir_shader *shader);
 void nir_metadata_check_validation_flag(nir_shader *shader);
 void nir_metadata_require_all(nir_shader *shader);
 
+int64_t nir_pass_timing_now(void);
+
+/** Records one invocation of a pass (or of any other named compile step
+ * started at start_ns, as returned by nir_pass_timing_now()) in the
+ * NIR_DEBUG=pass_timing statistics of the shader and of the process.
+ *
+ * The name must outlive the shader and the process statistics, so it should
+ * be a string literal.
+ */
+void nir_pass_timing_record(nir_shader *shader, const char *pass,
+                            int64_t start_ns, bool progress);
+
+/** Prints the NIR_DEBUG=pass_timing statistics of a shader, or of the whole
+ * process if shader is NULL, as JSON.
+ */
+void nir_print_pass_timing(const nir_shader *shader, FILE *fp);
+
 static inline bool
 should_skip_nir(const char *name)
 {
@@ -4597,6 +4645,20 @@ nir_metadata_require_all(nir_shader *shader)
 {
    (void)shader;
 }
+static inline int64_t
+nir_pass_timing_now(void)
+{
+   return 0;
+}
+static inline void
+nir_pass_timing_record(UNUSED nir_shader *shader, UNUSED const char *pass,
+                       UNUSED int64_t start_ns, UNUSED bool progress)
+{
+}
+static inline void
+nir_print_pass_timing(UNUSED const nir_shader *shader, UNUSED FILE *fp)
+{
+}
 static inline bool
 should_skip_nir(UNUSED const char *pass_name)
 {
@@ -4636,7 +4698,11 @@ should_print_nir(UNUSED nir_shader *shader)
    nir_metadata_set_validation_flag(nir);                                                   \
    if (should_print_nir(nir))                                                               \
       printf("%s\n", #pass);                                                                \
-   if (pass(nir, ##__VA_ARGS__)) {                                                          \
+   int64_t _pass_start = NIR_DEBUG(PASS_TIMING) ? nir_pass_timing_now() : 0;                \
+   bool _pass_progress = pass(nir, ##__VA_ARGS__);                                          \
+   if (NIR_DEBUG(PASS_TIMING))                                                              \
+      nir_pass_timing_record(nir, #pass, _pass_start, _pass_progress);                      \
+   if (_pass_progress) {                                                                    \
       nir_validate_shader(nir, "after " #pass " in " __FILE__ ":" NIR_STRINGIZE(__LINE__)); \
       UNUSED bool _;                                                                        \
       progress = true;                                                                      \
@@ -4655,7 +4721,11 @@ should_print_nir(UNUSED nir_shader *shader)
 #define NIR_PASS_V(nir, pass, ...) _PASS(pass, nir, {        \
    if (should_print_nir(nir))                                \
       printf("%s\n", #pass);                                 \
+   int64_t _pass_start =                                     \
+      NIR_DEBUG(PASS_TIMING) ? nir_pass_timing_now() : 0;    \
    pass(nir, ##__VA_ARGS__);                                 \
+   if (NIR_DEBUG(PASS_TIMING))                               \
+      nir_pass_timing_record(nir, #pass, _pass_start, true); \
    nir_validate_shader(nir, "after " #pass " in " __FILE__); \
    if (should_print_nir(nir))                                \
       nir_print_shader(nir, stdout);                         \
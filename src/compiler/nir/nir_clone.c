@@ -866,6 +866,11 @@ nir_shader_clone(void *mem_ctx, const nir_shader *s)
 void
 nir_shader_replace(nir_shader *dst, nir_shader *src)
 {
+   /* Keep the pass statistics of dst, they describe the shader as a whole */
+   struct hash_table *pass_stats = dst->pass_stats;
+   if (pass_stats)
+      ralloc_steal(NULL, pass_stats);
+
    /* Delete all of dest's ralloc children */
    void *dead_ctx = ralloc_context(NULL);
    ralloc_adopt(dead_ctx, dst);
@@ -876,6 +881,11 @@ nir_shader_replace(nir_shader *dst, nir_shader *src)
 
    memcpy(dst, src, sizeof(*dst));
 
+   ralloc_free(dst->pass_stats);
+   dst->pass_stats = pass_stats;
+   if (pass_stats)
+      ralloc_steal(dst, pass_stats);
+
    /* We have to move all the linked lists over separately because we need the
     * pointers in the list elements to point to the lists in dst and not src.
     */
@@ -353,8 +353,40 @@ struct lower_link_state {
    struct hash_table *shader_var_remap;
    const nir_shader *link_shader;
    unsigned printf_index_offset;
+
+   /* Name to nir_function maps of the shader and of link_shader.  Libraries
+    * such as libclc have thousands of functions, so looking callees up with
+    * nir_shader_get_function_for_name() would be quadratic.
+    */
+   struct hash_table *shader_functions;
+   struct hash_table *link_functions;
 };
 
+void
+nir_function_name_table_add(struct hash_table *table, nir_function *func)
+{
+   if (func->name && !_mesa_hash_table_search(table, func->name))
+      _mesa_hash_table_insert(table, func->name, func);
+}
+
+struct hash_table *
+nir_function_name_table_create(void *mem_ctx, const nir_shader *shader)
+{
+   struct hash_table *table = _mesa_string_hash_table_create(mem_ctx);
+
+   nir_foreach_function(func, shader)
+      nir_function_name_table_add(table, func);
+
+   return table;
+}
+
+nir_function *
+nir_function_name_table_lookup(struct hash_table *table, const char *name)
+{
+   struct hash_entry *entry = _mesa_hash_table_search(table, name);
+   return entry ? entry->data : NULL;
+}
+
 static bool
 lower_calls_vars_instr(struct nir_builder *b,
                        nir_instr *instr,
@@ -387,16 +419,21 @@ lower_calls_vars_instr(struct nir_builder *b,
       if (!ncall->callee->name)
          return false;
 
-      nir_function *func = nir_shader_get_function_for_name(b->shader, ncall->callee->name);
+      nir_function *func =
+         nir_function_name_table_lookup(state->shader_functions,
+                                        ncall->callee->name);
       if (func) {
          ncall->callee = func;
          break;
       }
 
       nir_function *new_func;
-      new_func = nir_shader_get_function_for_name(state->link_shader, ncall->callee->name);
-      if (new_func)
+      new_func = nir_function_name_table_lookup(state->link_functions,
+                                                ncall->callee->name);
+      if (new_func) {
          ncall->callee = nir_function_clone(b->shader, new_func);
+         nir_function_name_table_add(state->shader_functions, ncall->callee);
+      }
       break;
    }
    case nir_instr_type_intrinsic: {
@@ -454,7 +491,8 @@ function_link_pass(struct nir_builder *b,
    if (call->callee->impl)
       return false;
 
-   func = nir_shader_get_function_for_name(state->link_shader, call->callee->name);
+   func = nir_function_name_table_lookup(state->link_functions,
+                                         call->callee->name);
    if (!func || !func->impl) {
       return false;
    }
@@ -475,6 +513,8 @@ nir_link_shader_functions(nir_shader *shader,
       .shader_var_remap = copy_vars,
       .link_shader = link_shader,
       .printf_index_offset = shader->printf_info_count,
+      .shader_functions = nir_function_name_table_create(ra_ctx, shader),
+      .link_functions = nir_function_name_table_create(ra_ctx, link_shader),
    };
    /* do progress passes inside the pass */
    do {
@@ -87,6 +87,7 @@ nir_progress(bool progress, nir_function_impl *impl, nir_metadata preserved)
    }
 
    impl->valid_metadata &= preserved;
+   impl->validation_dirty |= progress;
    return progress;
 }
 
@@ -0,0 +1,163 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Per-pass compile-time statistics for NIR_DEBUG=pass_timing.
+ *
+ * Every NIR_PASS/NIR_PASS_V invocation records its wall time, whether it made
+ * progress, and the pass name, both on the shader it ran on and in a
+ * process-wide table.  The process-wide table is dumped as JSON to stderr at
+ * exit, and each invocation is also emitted as a slice on a perfetto track
+ * when perfetto tracing is enabled.
+ */
+
+#include "nir.h"
+
+#ifndef NDEBUG
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include "util/detect_os.h"
+#include "util/os_time.h"
+#include "util/perf/cpu_trace.h"
+#include "util/simple_mtx.h"
+
+typedef struct {
+   const char *name;
+   uint64_t invocations;
+   uint64_t progress;
+   uint64_t time_ns;
+} nir_pass_stats;
+
+/* os_time_get_nano() is based on the monotonic clock. */
+#if DETECT_OS_POSIX
+#define PASS_TIMING_CLOCK CLOCK_MONOTONIC
+#else
+#define PASS_TIMING_CLOCK 0
+#endif
+
+static simple_mtx_t process_stats_mtx = SIMPLE_MTX_INITIALIZER;
+static struct hash_table *process_stats;
+static uint64_t pass_track_id;
+
+static nir_pass_stats *
+get_pass_stats(struct hash_table *stats, const char *pass)
+{
+   struct hash_entry *entry = _mesa_hash_table_search(stats, pass);
+   if (entry)
+      return entry->data;
+
+   nir_pass_stats *s = rzalloc(stats, nir_pass_stats);
+   s->name = pass;
+   _mesa_hash_table_insert(stats, pass, s);
+   return s;
+}
+
+static void
+add_pass_stats(struct hash_table *stats, const char *pass,
+               int64_t time_ns, bool progress)
+{
+   nir_pass_stats *s = get_pass_stats(stats, pass);
+   s->invocations++;
+   s->progress += progress;
+   s->time_ns += time_ns;
+}
+
+static int
+compare_pass_stats(const void *_a, const void *_b)
+{
+   const nir_pass_stats *a = *(const nir_pass_stats *const *)_a;
+   const nir_pass_stats *b = *(const nir_pass_stats *const *)_b;
+
+   if (a->time_ns != b->time_ns)
+      return a->time_ns > b->time_ns ? -1 : 1;
+
+   return strcmp(a->name, b->name);
+}
+
+static void
+print_pass_stats(struct hash_table *stats, FILE *fp)
+{
+   unsigned count = stats ? _mesa_hash_table_num_entries(stats) : 0;
+   const nir_pass_stats **sorted = malloc(MAX2(count, 1) * sizeof(*sorted));
+   uint64_t total_ns = 0;
+   unsigned i = 0;
+
+   if (stats) {
+      hash_table_foreach(stats, entry) {
+         sorted[i++] = entry->data;
+         total_ns += ((const nir_pass_stats *)entry->data)->time_ns;
+      }
+   }
+
+   qsort(sorted, count, sizeof(*sorted), compare_pass_stats);
+
+   fprintf(fp, "{\n  \"total_ns\": %" PRIu64 ",\n  \"passes\": [", total_ns);
+   for (i = 0; i < count; i++) {
+      const nir_pass_stats *s = sorted[i];
+      fprintf(fp, "%s\n    { \"name\": \"%s\", \"invocations\": %" PRIu64
+                  ", \"progress\": %" PRIu64 ", \"time_ns\": %" PRIu64 " }",
+              i ? "," : "", s->name, s->invocations, s->progress, s->time_ns);
+   }
+   fprintf(fp, "%s]\n}\n", count ? "\n  " : "");
+
+   free((void *)sorted);
+}
+
+static void
+print_process_pass_timing_at_exit(void)
+{
+   nir_print_pass_timing(NULL, stderr);
+}
+
+int64_t
+nir_pass_timing_now(void)
+{
+   return os_time_get_nano();
+}
+
+void
+nir_pass_timing_record(nir_shader *shader, const char *pass,
+                       int64_t start_ns, bool progress)
+{
+   int64_t end_ns = os_time_get_nano();
+   int64_t time_ns = end_ns - start_ns;
+
+   if (shader) {
+      if (!shader->pass_stats)
+         shader->pass_stats = _mesa_string_hash_table_create(shader);
+      add_pass_stats(shader->pass_stats, pass, time_ns, progress);
+   }
+
+   simple_mtx_lock(&process_stats_mtx);
+   if (!process_stats) {
+      process_stats = _mesa_string_hash_table_create(NULL);
+      atexit(print_process_pass_timing_at_exit);
+   }
+   add_pass_stats(process_stats, pass, time_ns, progress);
+
+   if (util_perfetto_is_tracing_enabled() && !pass_track_id)
+      pass_track_id = util_perfetto_new_track("NIR passes");
+   UNUSED uint64_t track_id = pass_track_id;
+   simple_mtx_unlock(&process_stats_mtx);
+
+   MESA_TRACE_TIMESTAMP_BEGIN(pass, track_id, 0, PASS_TIMING_CLOCK, start_ns);
+   MESA_TRACE_TIMESTAMP_END(pass, track_id, PASS_TIMING_CLOCK, end_ns);
+}
+
+void
+nir_print_pass_timing(const nir_shader *shader, FILE *fp)
+{
+   if (shader) {
+      print_pass_stats(shader->pass_stats, fp);
+      return;
+   }
+
+   simple_mtx_lock(&process_stats_mtx);
+   print_pass_stats(process_stats, fp);
+   simple_mtx_unlock(&process_stats_mtx);
+}
+
+#endif /* NDEBUG */
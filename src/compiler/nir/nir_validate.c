@@ -29,6 +29,8 @@
 #include "c11/threads.h"
 #include "util/hash_table.h"
 #include "util/simple_mtx.h"
+#include "util/u_atomic.h"
+#include "util/u_debug.h"
 #include "nir.h"
 #include "nir_xfb_info.h"
 
@@ -89,6 +91,11 @@ typedef struct {
 
    /* map of instruction/var/etc to failed assert string */
    struct hash_table *errors;
+
+   /* whether function implementations without validation_dirty set are
+    * skipped
+    */
+   bool incremental;
 } validate_state;
 
 static void
@@ -2093,7 +2100,8 @@ validate_function(nir_function *func, validate_state *state)
 {
    if (func->impl != NULL) {
       validate_assert(state, func->impl->function == func);
-      validate_function_impl(func->impl, state);
+      if (!state->incremental || func->impl->validation_dirty)
+         validate_function_impl(func->impl, state);
    }
 }
 
@@ -2111,6 +2119,7 @@ init_validate_state(validate_state *state)
    state->in_loop_continue_construct = false;
    state->instr = NULL;
    state->var = NULL;
+   state->incremental = false;
 }
 
 static void
@@ -2154,6 +2163,27 @@ dump_errors(validate_state *state, const char *when)
    abort();
 }
 
+DEBUG_GET_ONCE_NUM_OPTION(nir_validate_full_interval, "NIR_VALIDATE_FULL_INTERVAL", 16)
+
+/* With NIR_DEBUG=incremental_validation, only every Nth validation in the
+ * process looks at function implementations which haven't changed since they
+ * were last validated.  This catches passes which modify an impl without
+ * reporting progress on it, at a fraction of the cost of always doing so.
+ */
+static bool
+use_incremental_validation(void)
+{
+   if (!NIR_DEBUG(INCREMENTAL_VALIDATION))
+      return false;
+
+   static uint32_t validation_count = 0;
+   uint32_t interval = debug_get_option_nir_validate_full_interval();
+   if (interval == 0)
+      return true;
+
+   return p_atomic_inc_return(&validation_count) % interval != 0;
+}
+
 void
 nir_validate_shader(nir_shader *shader, const char *when)
 {
@@ -2164,6 +2194,7 @@ nir_validate_shader(nir_shader *shader, const char *when)
    init_validate_state(&state);
 
    state.shader = shader;
+   state.incremental = use_incremental_validation();
 
    nir_variable_mode valid_modes =
       nir_var_shader_in |
@@ -2219,6 +2250,9 @@ nir_validate_shader(nir_shader *shader, const char *when)
    if (_mesa_hash_table_num_entries(state.errors) > 0)
       dump_errors(&state, when);
 
+   nir_foreach_function_impl(impl, shader)
+      impl->validation_dirty = false;
+
    destroy_validate_state(&state);
 }
 
@@ -0,0 +1,104 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "helpers.h"
+
+class Functions : public spirv_test {
+protected:
+   nir_function *find_function(const char *name)
+   {
+      nir_foreach_function(func, shader) {
+         if (func->name && strcmp(func->name, name) == 0)
+            return func;
+      }
+      return NULL;
+   }
+};
+
+/*
+               OpCapability Shader
+               OpMemoryModel Logical GLSL450
+               OpEntryPoint GLCompute %main "main"
+               OpName %dead "dead"
+               OpName %callee "callee"
+               OpName %x "x"
+       %void = OpTypeVoid
+          %2 = OpTypeFunction %void
+       %uint = OpTypeInt 32 0
+          %4 = OpTypeFunction %uint %uint
+     %uint_1 = OpConstant %uint 1
+       %dead = OpFunction %void None %2
+          %7 = OpLabel
+               OpReturn
+               OpFunctionEnd
+     %callee = OpFunction %uint None %4
+          %x = OpFunctionParameter %uint
+         %10 = OpLabel
+         %11 = OpIAdd %uint %x %uint_1
+               OpReturnValue %11
+               OpFunctionEnd
+       %main = OpFunction %void None %2
+         %13 = OpLabel
+         %14 = OpFunctionCall %uint %callee %uint_1
+               OpReturn
+               OpFunctionEnd
+*/
+static const uint32_t call_words[] = {
+   0x07230203, 0x00010000, 0x00000000, 0x0000000f, 0x00000000, 0x00020011,
+   0x00000001, 0x0003000e, 0x00000000, 0x00000001, 0x0005000f, 0x00000005,
+   0x0000000c, 0x6e69616d, 0x00000000, 0x00040005, 0x00000006, 0x64616564,
+   0x00000000, 0x00040005, 0x00000008, 0x6c6c6163, 0x00006565, 0x00030005,
+   0x00000009, 0x00000078, 0x00020013, 0x00000001, 0x00030021, 0x00000002,
+   0x00000001, 0x00040015, 0x00000003, 0x00000020, 0x00000000, 0x00040021,
+   0x00000004, 0x00000003, 0x00000003, 0x0004002b, 0x00000003, 0x00000005,
+   0x00000001, 0x00050036, 0x00000001, 0x00000006, 0x00000000, 0x00000002,
+   0x000200f8, 0x00000007, 0x000100fd, 0x00010038, 0x00050036, 0x00000003,
+   0x00000008, 0x00000000, 0x00000004, 0x00030037, 0x00000003, 0x00000009,
+   0x000200f8, 0x0000000a, 0x00050080, 0x00000003, 0x0000000b, 0x00000009,
+   0x00000005, 0x000200fe, 0x0000000b, 0x00010038, 0x00050036, 0x00000001,
+   0x0000000c, 0x00000000, 0x00000002, 0x000200f8, 0x0000000d, 0x00050039,
+   0x00000003, 0x0000000e, 0x00000008, 0x00000005, 0x000100fd, 0x00010038,
+};
+
+TEST_F(Functions, unreferenced_function_is_skipped)
+{
+   get_nir(sizeof(call_words) / sizeof(call_words[0]), call_words);
+   ASSERT_NE(shader, nullptr);
+
+   EXPECT_EQ(find_function("dead"), nullptr);
+   EXPECT_EQ(exec_list_length(&shader->functions), 2);
+
+   nir_function *callee = find_function("callee");
+   ASSERT_NE(callee, nullptr);
+   ASSERT_NE(callee->impl, nullptr);
+
+   /* The return value pointer comes first, then x. */
+   ASSERT_EQ(callee->num_params, 2);
+   EXPECT_TRUE(callee->params[0].is_return);
+   EXPECT_STREQ(callee->params[1].name, "x");
+
+   unsigned param_loads = 0;
+   nir_foreach_block(block, callee->impl) {
+      nir_foreach_instr(instr, block) {
+         if (instr->type == nir_instr_type_intrinsic &&
+             nir_instr_as_intrinsic(instr)->intrinsic == nir_intrinsic_load_param)
+            param_loads++;
+      }
+   }
+   EXPECT_EQ(param_loads, 2);
+}
+
+TEST_F(Functions, library_keeps_unreferenced_functions)
+{
+   spirv_options.create_library = true;
+
+   get_nir(sizeof(call_words) / sizeof(call_words[0]), call_words);
+   ASSERT_NE(shader, nullptr);
+
+   nir_function *dead = find_function("dead");
+   ASSERT_NE(dead, nullptr);
+   EXPECT_NE(dead->impl, nullptr);
+   EXPECT_EQ(exec_list_length(&shader->functions), 3);
+}
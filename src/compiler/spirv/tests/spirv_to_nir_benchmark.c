@@ -0,0 +1,165 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Measures spirv_to_nir on a generated compute shader with many functions
+ * of straight-line integer code, which is dominated by the passes over the
+ * instruction stream rather than by any particular opcode.
+ *
+ * The number of functions, of instructions per function and of functions
+ * called from the entry point can be given as the first three arguments.
+ * Calling only some of them models a large module of which only one kernel
+ * is compiled.
+ */
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "compiler/glsl_types.h"
+#include "compiler/nir/nir.h"
+#include "compiler/spirv/nir_spirv.h"
+#include "compiler/spirv/spirv.h"
+#include "compiler/spirv/spirv_info.h"
+#include "util/os_time.h"
+
+#define ITERATIONS 20
+
+enum {
+   ID_VOID = 1,
+   ID_VOID_FUNC,
+   ID_INT,
+   ID_ONE,
+   ID_MAIN,
+   ID_FIRST_FREE,
+};
+
+struct module {
+   uint32_t *words;
+   size_t count;
+   uint32_t next_id;
+};
+
+static void
+emit(struct module *m, SpvOp op, unsigned num_operands, ...)
+{
+   va_list args;
+
+   va_start(args, num_operands);
+   m->words[m->count++] = ((num_operands + 1) << SpvWordCountShift) | op;
+   for (unsigned i = 0; i < num_operands; i++)
+      m->words[m->count++] = va_arg(args, uint32_t);
+   va_end(args);
+}
+
+static void
+build_module(struct module *m, unsigned num_funcs, unsigned func_size,
+             unsigned num_calls)
+{
+   m->words = malloc(sizeof(uint32_t) *
+                     (32 + num_funcs * (func_size * 5 + 16)));
+   m->count = 0;
+   m->next_id = ID_FIRST_FREE;
+
+   m->words[m->count++] = SpvMagicNumber;
+   m->words[m->count++] = 0x00010000;
+   m->words[m->count++] = 0;
+   m->words[m->count++] = 0; /* bound, set at the end */
+   m->words[m->count++] = 0;
+
+   emit(m, SpvOpCapability, 1, SpvCapabilityShader);
+   emit(m, SpvOpMemoryModel, 2, SpvAddressingModelLogical,
+        SpvMemoryModelGLSL450);
+   /* "main" */
+   emit(m, SpvOpEntryPoint, 4, SpvExecutionModelGLCompute, ID_MAIN,
+        0x6e69616d, 0);
+   emit(m, SpvOpExecutionMode, 5, ID_MAIN, SpvExecutionModeLocalSize,
+        1, 1, 1);
+   emit(m, SpvOpTypeVoid, 1, ID_VOID);
+   emit(m, SpvOpTypeFunction, 2, ID_VOID_FUNC, ID_VOID);
+   emit(m, SpvOpTypeInt, 3, ID_INT, 32, 0);
+   emit(m, SpvOpConstant, 3, ID_INT, ID_ONE, 1);
+
+   uint32_t first_func = m->next_id;
+   for (unsigned f = 0; f < num_funcs; f++) {
+      uint32_t func = m->next_id++;
+      uint32_t value = ID_ONE;
+
+      emit(m, SpvOpFunction, 4, ID_VOID, func, SpvFunctionControlMaskNone,
+           ID_VOID_FUNC);
+      emit(m, SpvOpLabel, 1, m->next_id++);
+      for (unsigned i = 0; i < func_size; i++) {
+         emit(m, SpvOpIAdd, 4, ID_INT, m->next_id, value, ID_ONE);
+         value = m->next_id++;
+      }
+      emit(m, SpvOpReturn, 0);
+      emit(m, SpvOpFunctionEnd, 0);
+   }
+
+   emit(m, SpvOpFunction, 4, ID_VOID, ID_MAIN, SpvFunctionControlMaskNone,
+        ID_VOID_FUNC);
+   emit(m, SpvOpLabel, 1, m->next_id++);
+   for (unsigned f = 0; f < num_calls; f++) {
+      /* Functions take two ids each, the function and its label. */
+      emit(m, SpvOpFunctionCall, 3, ID_VOID, m->next_id++,
+           first_func + f * (func_size + 2));
+   }
+   emit(m, SpvOpReturn, 0);
+   emit(m, SpvOpFunctionEnd, 0);
+
+   m->words[3] = m->next_id;
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned num_funcs = argc > 1 ? MAX2(strtoul(argv[1], NULL, 0), 1) : 500;
+   unsigned func_size = argc > 2 ? MAX2(strtoul(argv[2], NULL, 0), 1) : 100;
+   unsigned num_calls = argc > 3 ? MIN2(strtoul(argv[3], NULL, 0), num_funcs)
+                                 : num_funcs;
+   struct module m;
+
+   build_module(&m, num_funcs, func_size, num_calls);
+
+   glsl_type_singleton_init_or_ref();
+
+   const struct spirv_capabilities caps = {
+      .Shader = true,
+   };
+   const struct spirv_to_nir_options options = {
+      .environment = NIR_SPIRV_VULKAN,
+      .capabilities = &caps,
+      .ubo_addr_format = nir_address_format_32bit_index_offset,
+      .ssbo_addr_format = nir_address_format_32bit_index_offset,
+      .phys_ssbo_addr_format = nir_address_format_64bit_global,
+      .push_const_addr_format = nir_address_format_32bit_offset,
+      .shared_addr_format = nir_address_format_32bit_offset,
+      .task_payload_addr_format = nir_address_format_32bit_offset,
+   };
+   const nir_shader_compiler_options nir_options = { 0 };
+
+   /* Report the fastest run, the others mostly measure noise. */
+   int64_t best = INT64_MAX;
+   for (unsigned i = 0; i < ITERATIONS; i++) {
+      int64_t start = os_time_get_nano();
+      nir_shader *shader = spirv_to_nir(m.words, m.count, NULL, 0,
+                                        MESA_SHADER_COMPUTE, "main",
+                                        &options, &nir_options);
+      int64_t ns = os_time_get_nano() - start;
+
+      if (!shader)
+         return 1;
+      ralloc_free(shader);
+      best = MIN2(best, ns);
+   }
+
+   printf("%zu words: %.3f ms, %.2f ns/word\n", m.count, best / 1e6,
+          (double)best / m.count);
+
+   glsl_type_singleton_decref();
+   free(m.words);
+   return 0;
+}
@@ -204,8 +204,9 @@ vtn_handle_function_call(struct vtn_builder *b, SpvOp opcode,
 
    vtn_callee->referenced = true;
 
-   nir_call_instr *call = nir_call_instr_create(b->nb.shader,
-                                                vtn_callee->nir_func);
+   nir_call_instr *call =
+      nir_call_instr_create(b->nb.shader,
+                            vtn_get_nir_function(b, vtn_callee));
 
    unsigned param_idx = 0;
 
@@ -281,10 +282,128 @@ function_execution_mode_cb(struct vtn_builder *b, struct vtn_value *func,
    }
 }
 
+/* Returns the nir_function for a SPIR-V function, creating it the first time
+ * it is needed.  Must not be called before the function's OpFunctionEnd has
+ * been seen by the CFG prepass.
+ */
+nir_function *
+vtn_get_nir_function(struct vtn_builder *b, struct vtn_function *vtn_func)
+{
+   if (vtn_func->nir_func)
+      return vtn_func->nir_func;
+
+   struct vtn_value *val = vtn_untyped_value(b, vtn_func->start[2]);
+   const struct vtn_type *func_type = vtn_func->type;
+
+   nir_function *func =
+      nir_function_create(b->shader, ralloc_strdup(b->shader, val->name));
+
+   /* Execution modes are gathered per-function with create_library (here)
+    * but per shader with !create_library (elsewhere).
+    */
+   if (b->options->create_library)
+      vtn_foreach_execution_mode(b, val, function_execution_mode_cb, func);
+
+   unsigned num_params = 0;
+   for (unsigned i = 0; i < func_type->length; i++)
+      num_params += glsl_type_count_function_params(func_type->params[i]->type);
+
+   /* Add one parameter for the function return value */
+   if (func_type->return_type->base_type != vtn_base_type_void)
+      num_params++;
+
+   func->should_inline = vtn_func->control & SpvFunctionControlInlineMask;
+   func->dont_inline = vtn_func->control & SpvFunctionControlDontInlineMask;
+   func->is_exported = vtn_func->linkage == SpvLinkageTypeExport;
+
+   /* This is a bit subtle: if we are compiling a non-library, we will have
+    * exactly one entrypoint. But in library mode, we can have 0, 1, or even
+    * multiple entrypoints. This is OK.
+    *
+    * So, we set is_entrypoint for libraries here (plumbing OpEntryPoint),
+    * but set is_entrypoint elsewhere for graphics shaders.
+    */
+   if (b->options->create_library) {
+      func->is_entrypoint = val->is_entrypoint;
+   }
+
+   func->num_params = num_params;
+   func->params = rzalloc_array(b->shader, nir_parameter, num_params);
+
+   unsigned idx = 0;
+   if (func_type->return_type->base_type != vtn_base_type_void) {
+      nir_address_format addr_format =
+         vtn_mode_to_address_format(b, vtn_variable_mode_function);
+      /* The return value is a regular pointer */
+      func->params[idx++] = (nir_parameter) {
+         .num_components = nir_address_format_num_components(addr_format),
+         .bit_size = nir_address_format_bit_size(addr_format),
+         .is_return = true,
+         .type = func_type->return_type->type,
+      };
+   }
+
+   for (unsigned i = 0; i < func_type->length; i++)
+      glsl_type_add_to_function_params(func_type->params[i]->type, func, &idx);
+   assert(idx == num_params);
+
+   /* Name the parameters, a struct parameter is named by its first member */
+   idx = func_type->return_type->base_type != vtn_base_type_void;
+   unsigned param = 0;
+   for (const uint32_t *w = vtn_func->start; w < vtn_func->end;
+        w += w[0] >> SpvWordCountShift) {
+      SpvOp opcode = w[0] & SpvOpCodeMask;
+      if (opcode == SpvOpLabel)
+         break;
+      if (opcode != SpvOpFunctionParameter)
+         continue;
+
+      vtn_fail_if(param >= func_type->length,
+                  "Function has more parameters than its type");
+      func->params[idx].name =
+         ralloc_strdup(b->shader, vtn_untyped_value(b, w[2])->name);
+      idx += glsl_type_count_function_params(func_type->params[param++]->type);
+   }
+
+   /* A function declaration (no basic blocks) is just a prototype. */
+   if (vtn_func->start_block != NULL)
+      nir_function_impl_create(func);
+
+   vtn_func->nir_func = func;
+
+   return func;
+}
+
+static bool
+vtn_handle_function_parameter(struct vtn_builder *b, SpvOp opcode,
+                              const uint32_t *w, unsigned count)
+{
+   if (opcode != SpvOpFunctionParameter)
+      return true;
+
+   vtn_assert(b->func_param_idx < b->func->nir_func->num_params);
+
+   struct vtn_func_arg_info arg_info = {0};
+   struct vtn_type *type = vtn_get_type(b, w[1]);
+   struct vtn_ssa_value *ssa = vtn_create_ssa_value(b, type->type);
+   struct vtn_value *val = vtn_untyped_value(b, w[2]);
+
+   vtn_foreach_decoration(b, val, function_parameter_decoration_cb, &arg_info);
+   vtn_ssa_value_load_function_param(b, ssa, type, &arg_info, &b->func_param_idx);
+   vtn_push_ssa_value(b, w[2], ssa);
+   return true;
+}
+
 bool
 vtn_cfg_handle_prepass_instruction(struct vtn_builder *b, SpvOp opcode,
                                    const uint32_t *w, unsigned count)
 {
+   /* Result types are gathered in this same walk rather than in a separate
+    * pass over all function bodies.  Nothing below looks at the type of a
+    * value defined after the current instruction, so this is safe.
+    */
+   vtn_set_instruction_result_type(b, opcode, w, count);
+
    switch (opcode) {
    case SpvOpFunction: {
       vtn_assert(b->func == NULL);
@@ -293,6 +412,7 @@ vtn_cfg_handle_prepass_instruction(struct vtn_builder *b, SpvOp opcode,
       list_inithead(&b->func->body);
       b->func->linkage = SpvLinkageTypeMax;
       b->func->control = w[3];
+      b->func->start = w;
       list_inithead(&b->func->constructs);
 
       UNUSED const struct glsl_type *result_type = vtn_get_type(b, w[1])->type;
@@ -302,76 +422,8 @@ vtn_cfg_handle_prepass_instruction(struct vtn_builder *b, SpvOp opcode,
       vtn_foreach_decoration(b, val, function_decoration_cb, b->func);
 
       b->func->type = vtn_get_type(b, w[4]);
-      const struct vtn_type *func_type = b->func->type;
-
-      vtn_assert(func_type->return_type->type == result_type);
-
-      nir_function *func =
-         nir_function_create(b->shader, ralloc_strdup(b->shader, val->name));
-
-      /* Execution modes are gathered per-function with create_library (here)
-       * but per shader with !create_library (elsewhere).
-       */
-      if (b->options->create_library)
-         vtn_foreach_execution_mode(b, val, function_execution_mode_cb, func);
-
-      unsigned num_params = 0;
-      for (unsigned i = 0; i < func_type->length; i++)
-         num_params += glsl_type_count_function_params(func_type->params[i]->type);
-
-      /* Add one parameter for the function return value */
-      if (func_type->return_type->base_type != vtn_base_type_void)
-         num_params++;
-
-      func->should_inline = b->func->control & SpvFunctionControlInlineMask;
-      func->dont_inline = b->func->control & SpvFunctionControlDontInlineMask;
-      func->is_exported = b->func->linkage == SpvLinkageTypeExport;
-
-      /* This is a bit subtle: if we are compiling a non-library, we will have
-       * exactly one entrypoint. But in library mode, we can have 0, 1, or even
-       * multiple entrypoints. This is OK.
-       *
-       * So, we set is_entrypoint for libraries here (plumbing OpEntryPoint),
-       * but set is_entrypoint elsewhere for graphics shaders.
-       */
-      if (b->options->create_library) {
-         func->is_entrypoint = val->is_entrypoint;
-      }
-
-      func->num_params = num_params;
-      func->params = rzalloc_array(b->shader, nir_parameter, num_params);
-
-      unsigned idx = 0;
-      if (func_type->return_type->base_type != vtn_base_type_void) {
-         nir_address_format addr_format =
-            vtn_mode_to_address_format(b, vtn_variable_mode_function);
-         /* The return value is a regular pointer */
-         func->params[idx++] = (nir_parameter) {
-            .num_components = nir_address_format_num_components(addr_format),
-            .bit_size = nir_address_format_bit_size(addr_format),
-            .is_return = true,
-            .type = func_type->return_type->type,
-         };
-      }
-
-      for (unsigned i = 0; i < func_type->length; i++)
-         glsl_type_add_to_function_params(func_type->params[i]->type, func, &idx);
-      assert(idx == num_params);
-
-      b->func->nir_func = func;
-
-      /* Set up a nir_function_impl and the builder so we can load arguments
-       * directly in our OpFunctionParameter handler.
-       */
-      nir_function_impl *impl = nir_function_impl_create(func);
-      b->nb = nir_builder_at(nir_before_impl(impl));
-      b->nb.exact = b->exact;
 
-      b->func_param_idx = 0;
-
-      /* The return value is the first parameter */
-      if (func_type->return_type->base_type != vtn_base_type_void)
-         b->func_param_idx++;
+      vtn_assert(b->func->type->return_type->type == result_type);
       break;
    }
 
@@ -382,34 +434,26 @@ vtn_cfg_handle_prepass_instruction(struct vtn_builder *b, SpvOp opcode,
                      "A function declaration (an OpFunction with no basic "
                      "blocks), must have a Linkage Attributes Decoration "
                      "with the Import Linkage Type.");
-
-         /* In this case, the function didn't have any actual blocks.  It's
-          * just a prototype so delete the function_impl.
-          */
-         b->func->nir_func->impl = NULL;
       } else {
          vtn_fail_if(b->func->linkage == SpvLinkageTypeImport,
                      "A function definition (an OpFunction with basic blocks) "
                      "cannot be decorated with the Import Linkage Type.");
       }
-      b->func = NULL;
-      break;
-
-   case SpvOpFunctionParameter: {
-      vtn_assert(b->func_param_idx < b->func->nir_func->num_params);
 
-      struct vtn_func_arg_info arg_info = {0};
-      struct vtn_type *type = vtn_get_type(b, w[1]);
-      struct vtn_ssa_value *ssa = vtn_create_ssa_value(b, type->type);
-      struct vtn_value *val = vtn_untyped_value(b, w[2]);
+      /* Other than in libraries, only functions reachable from the entry
+       * point are emitted, and their nir_function is created once they are
+       * first referenced.  Declarations are created right away because
+       * vtn_opencl.c looks those up by name.
+       */
+      if (b->options->create_library || b->func->start_block == NULL)
+         vtn_get_nir_function(b, b->func);
 
-      b->func->nir_func->params[b->func_param_idx].name = ralloc_strdup(b->shader, val->name);
+      b->func = NULL;
+      break;
 
-      vtn_foreach_decoration(b, val, function_parameter_decoration_cb, &arg_info);
-      vtn_ssa_value_load_function_param(b, ssa, type, &arg_info, &b->func_param_idx);
-      vtn_push_ssa_value(b, w[2], ssa);
+   case SpvOpFunctionParameter:
+      /* Parameters are loaded by vtn_function_emit() */
       break;
-   }
 
    case SpvOpLabel: {
       vtn_assert(b->block == NULL);
@@ -535,11 +579,6 @@ vtn_build_cfg(struct vtn_builder *b, const uint32_t *words, const uint32_t *end)
 {
    vtn_foreach_instruction(b, words, end,
                            vtn_cfg_handle_prepass_instruction);
-
-   if (b->shader->info.stage == MESA_SHADER_KERNEL)
-      return;
-
-   vtn_build_structured_cfg(b, words, end);
 }
 
 bool
@@ -770,16 +809,28 @@ vtn_function_emit(struct vtn_builder *b, struct vtn_function *func,
          debug_get_bool_option("MESA_SPIRV_FORCE_UNSTRUCTURED", false);
    }
 
-   nir_function_impl *impl = func->nir_func->impl;
+   nir_function_impl *impl = vtn_get_nir_function(b, func)->impl;
    b->nb = nir_builder_at(nir_after_impl(impl));
    b->func = func;
    b->nb.exact = b->exact;
    b->phi_table = _mesa_pointer_hash_table_create(b);
 
+   /* The return value is the first parameter */
+   b->func_param_idx = 0;
+   if (func->type->return_type->base_type != vtn_base_type_void)
+      b->func_param_idx++;
+
+   vtn_foreach_instruction(b, func->start, func->start_block->label,
+                           vtn_handle_function_parameter);
+
    if (b->shader->info.stage == MESA_SHADER_KERNEL || force_unstructured) {
       impl->structured = false;
       vtn_emit_cf_func_unstructured(b, func, instruction_handler);
    } else {
+      /* The structured CFG is only built for functions that are emitted,
+       * unreferenced ones are never looked at after the prepass.
+       */
+      vtn_build_structured_cfg(b, func);
       vtn_emit_cf_func_structured(b, func, instruction_handler);
    }
 
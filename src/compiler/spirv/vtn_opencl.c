@@ -132,6 +132,17 @@ vtn_opencl_mangle(const char *in_name,
    *outstring = strdup(local_name);
 }
 
+static nir_function *
+find_clc_shader_function(struct vtn_builder *b, const char *mname)
+{
+   if (!b->clc_shader_functions) {
+      b->clc_shader_functions =
+         nir_function_name_table_create(b, b->options->clc_shader);
+   }
+
+   return nir_function_name_table_lookup(b->clc_shader_functions, mname);
+}
+
 static nir_function *mangle_and_find(struct vtn_builder *b,
                                      const char *name,
                                      uint32_t const_mask,
@@ -142,12 +153,25 @@ static nir_function *mangle_and_find(struct vtn_builder *b,
 
    vtn_opencl_mangle(name, const_mask, num_srcs, src_types, &mname);
 
+   if (!b->clc_mangled_functions)
+      b->clc_mangled_functions = _mesa_string_hash_table_create(b);
+
+   /* Builtins are usually called many times per kernel, reuse the function
+    * we found or declared the first time.
+    */
+   struct hash_entry *entry =
+      _mesa_hash_table_search(b->clc_mangled_functions, mname);
+   if (entry) {
+      free(mname);
+      return entry->data;
+   }
+
    /* try and find in current shader first. */
    nir_function *found = nir_shader_get_function_for_name(b->shader, mname);
 
    /* if not found here find in clc shader and create a decl mirroring it */
    if (!found && b->options->clc_shader && b->options->clc_shader != b->shader) {
-      found = nir_shader_get_function_for_name(b->options->clc_shader, mname);
+      found = find_clc_shader_function(b, mname);
       if (found) {
          nir_function *decl = nir_function_create(b->shader, mname);
          decl->num_params = found->num_params;
@@ -161,6 +185,9 @@ static nir_function *mangle_and_find(struct vtn_builder *b,
    }
    if (!found)
       vtn_fail("Can't find clc function %s\n", mname);
+
+   _mesa_hash_table_insert(b->clc_mangled_functions,
+                           ralloc_strdup(b, mname), found);
    free(mname);
    return found;
 }
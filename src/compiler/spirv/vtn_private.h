@@ -211,6 +211,8 @@ struct vtn_function {
 
    struct list_head body;
 
+   /* The OpFunction instruction, followed by the parameters */
+   const uint32_t *start;
    const uint32_t *end;
 
    SpvLinkageType linkage;
@@ -249,13 +251,14 @@ void vtn_handle_function_call(struct vtn_builder *b, SpvOp opcode,
 
 bool vtn_cfg_handle_prepass_instruction(struct vtn_builder *b, SpvOp opcode,
                                         const uint32_t *w, unsigned count);
+nir_function *vtn_get_nir_function(struct vtn_builder *b,
+                                   struct vtn_function *vtn_func);
 void vtn_emit_cf_func_structured(struct vtn_builder *b, struct vtn_function *func,
                                  vtn_instruction_handler handler);
 bool vtn_handle_phis_first_pass(struct vtn_builder *b, SpvOp opcode,
                                 const uint32_t *w, unsigned count);
 void vtn_emit_ret_store(struct vtn_builder *b, const struct vtn_block *block);
-void vtn_build_structured_cfg(struct vtn_builder *b, const uint32_t *words,
-                              const uint32_t *end);
+void vtn_build_structured_cfg(struct vtn_builder *b, struct vtn_function *func);
 
 const uint32_t *
 vtn_foreach_instruction(struct vtn_builder *b, const uint32_t *start,
@@ -694,6 +697,16 @@ struct vtn_builder {
 
    struct hash_table *strings;
 
+   /* Map from mangled OpenCL builtin names to the nir_function in the shader
+    * implementing or declaring them.
+    */
+   struct hash_table *clc_mangled_functions;
+
+   /* Map from function names to nir_functions of options->clc_shader, built
+    * on first use to avoid walking its function list for each builtin call.
+    */
+   struct hash_table *clc_shader_functions;
+
    /* Current function parameter index */
    unsigned func_param_idx;
 
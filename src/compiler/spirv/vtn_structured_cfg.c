@@ -1085,30 +1085,28 @@ find_merge_pos(struct vtn_builder *b)
 }
 
 void
-vtn_build_structured_cfg(struct vtn_builder *b, const uint32_t *words, const uint32_t *end)
+vtn_build_structured_cfg(struct vtn_builder *b, struct vtn_function *func)
 {
-   vtn_foreach_function(func, &b->functions) {
-      b->func = func;
+   b->func = func;
 
-      sort_blocks(b);
+   sort_blocks(b);
 
-      create_constructs(b);
+   create_constructs(b);
 
-      validate_constructs(b);
+   validate_constructs(b);
 
-      find_innermost_constructs(b);
+   find_innermost_constructs(b);
 
-      find_merge_pos(b);
+   find_merge_pos(b);
 
-      set_branch_types(b);
+   set_branch_types(b);
 
-      if (MESA_SPIRV_DEBUG(STRUCTURED)) {
-         printf("\nBLOCKS (%u):\n", func->ordered_blocks_count);
-         print_ordered_blocks(func);
-         printf("\nCONSTRUCTS (%u):\n", list_length(&func->constructs));
-         print_constructs(func);
-         printf("\n");
-      }
+   if (MESA_SPIRV_DEBUG(STRUCTURED)) {
+      printf("\nBLOCKS (%u):\n", func->ordered_blocks_count);
+      print_ordered_blocks(func);
+      printf("\nCONSTRUCTS (%u):\n", list_length(&func->constructs));
+      print_constructs(func);
+      printf("\n");
    }
 }
 
@@ -1459,11 +1459,22 @@ set_samplers(struct cso_context_priv *ctx,
              const struct pipe_sampler_state **templates,
              size_t key_size)
 {
+   struct cso_sampler **cso_samplers = ctx->samplers[shader_stage].cso_samplers;
    int last = -1;
    for (unsigned i = 0; i < nr; i++) {
       if (!templates[i])
          continue;
 
+      /* Keep the sampler state CSO already in this slot if it's identical.
+       * Only a few units usually change between draws, so this skips
+       * hashing the others.
+       */
+      if (cso_samplers[i] &&
+          !memcmp(templates[i], &cso_samplers[i]->state, key_size)) {
+         last = i;
+         continue;
+      }
+
       /* Reuse the same sampler state CSO if 2 consecutive sampler states
        * are identical.
        *
@@ -1321,6 +1321,16 @@ hud_parse_env_var(struct hud_context *hud, struct pipe_screen *screen,
       else if (strcmp(name, "API-thread-num-batches") == 0) {
          hud_thread_counter_install(pane, name, HUD_COUNTER_BATCHES);
       }
+      else if (strcmp(name, "API-thread-call-syncs") == 0) {
+         hud_thread_counter_install(pane, name, HUD_COUNTER_CALL_SYNCS);
+      }
+      else if (strcmp(name, "API-thread-partial-syncs") == 0) {
+         hud_thread_counter_install(pane, name, HUD_COUNTER_PARTIAL_SYNCS);
+      }
+      else if (strcmp(name, "API-thread-stall-time") == 0) {
+         hud_thread_counter_install(pane, name, HUD_COUNTER_STALL_TIME);
+         pane->type = PIPE_DRIVER_QUERY_TYPE_MICROSECONDS;
+      }
       else if (strcmp(name, "main-thread-busy") == 0) {
          hud_thread_busy_install(pane, name, true);
       }
@@ -424,6 +424,18 @@ static unsigned get_counter(struct hud_graph *gr, enum hud_counter counter)
       value = mon->num_batches;
       mon->num_batches = 0;
       return value;
+   case HUD_COUNTER_CALL_SYNCS:
+      value = mon->num_call_syncs;
+      mon->num_call_syncs = 0;
+      return value;
+   case HUD_COUNTER_PARTIAL_SYNCS:
+      value = mon->num_partial_syncs;
+      mon->num_partial_syncs = 0;
+      return value;
+   case HUD_COUNTER_STALL_TIME:
+      value = mon->stall_time_us;
+      mon->stall_time_us = 0;
+      return value;
    default:
       assert(0);
       return 0;
@@ -40,6 +40,9 @@ enum hud_counter {
    HUD_COUNTER_DIRECT,
    HUD_COUNTER_SYNCS,
    HUD_COUNTER_BATCHES,
+   HUD_COUNTER_CALL_SYNCS,
+   HUD_COUNTER_PARTIAL_SYNCS,
+   HUD_COUNTER_STALL_TIME,
 };
 
 struct hud_context {
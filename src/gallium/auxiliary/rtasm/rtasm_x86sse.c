@@ -1518,6 +1518,22 @@ void sse2_pcmpgtd(struct x86_function *p,
    emit_modrm(p, dst, src);
 }
 
+/***********************************************************************
+ * F16C instructions
+ */
+
+/* vcvtph2ps: converts the 4 half floats in the low 64 bits of src. */
+void f16c_vcvtph2ps(struct x86_function *p,
+                    struct x86_reg dst,
+                    struct x86_reg src)
+{
+   DUMP_RR(dst, src);
+   /* VEX.128.66.0F38.W0 13 /r, with no extended registers. */
+   emit_3ub(p, 0xc4, 0xe2, 0x79);
+   emit_1ub(p, 0x13);
+   emit_modrm(p, dst, src);
+}
+
 /***********************************************************************
  * x87 instructions
  */
@@ -2172,6 +2188,8 @@ static void x86_init_func_common( struct x86_function *p )
       p->caps |= X86_SSE3;
    if(util_get_cpu_caps()->has_sse4_1)
       p->caps |= X86_SSE4_1;
+   if(util_get_cpu_caps()->has_f16c)
+      p->caps |= X86_F16C;
    p->csr = p->store;
 #if DETECT_ARCH_X86
    emit_1i(p, 0xfb1e0ff3);
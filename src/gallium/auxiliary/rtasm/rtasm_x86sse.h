@@ -47,6 +47,7 @@ struct x86_reg {
 #define X86_SSE2 8
 #define X86_SSE3 0x10
 #define X86_SSE4_1 0x20
+#define X86_F16C 0x40
 
 struct x86_function {
    unsigned caps;
@@ -272,6 +273,8 @@ void sse2_pshufd( struct x86_function *p, struct x86_reg dst, struct x86_reg src
 
 void sse2_pcmpgtd( struct x86_function *p, struct x86_reg dst, struct x86_reg src );
 
+void f16c_vcvtph2ps( struct x86_function *p, struct x86_reg dst, struct x86_reg src );
+
 void sse_prefetchnta( struct x86_function *p, struct x86_reg ptr);
 void sse_prefetch0( struct x86_function *p, struct x86_reg ptr);
 void sse_prefetch1( struct x86_function *p, struct x86_reg ptr);
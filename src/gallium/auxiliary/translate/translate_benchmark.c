@@ -0,0 +1,134 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Measures translate on the vertex formats u_vbuf has to convert for
+ * drivers without native support for them: fixed-function vertices with
+ * fixed-point, half-float and packed attributes, and legacy formats.
+ *
+ * The vertex count can be given as the first argument.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "translate/translate.h"
+#include "util/format/u_format.h"
+#include "util/os_time.h"
+#include "util/u_math.h"
+
+#define ITERATIONS 20
+#define MAX_ELEMENTS 4
+
+struct benchmark {
+   const char *name;
+   unsigned nr_elements;
+   struct {
+      enum pipe_format input_format;
+      enum pipe_format output_format;
+   } element[MAX_ELEMENTS];
+   bool indexed;
+};
+
+static const struct benchmark benchmarks[] = {
+   { "fixed pos + ubyte color + half tex", 3, {
+     { PIPE_FORMAT_R32G32B32_FIXED, PIPE_FORMAT_R32G32B32_FLOAT },
+     { PIPE_FORMAT_R8G8B8A8_UNORM, PIPE_FORMAT_R8G8B8A8_UNORM },
+     { PIPE_FORMAT_R16G16_FLOAT, PIPE_FORMAT_R32G32_FLOAT } } },
+   { "float pos + packed normal + ubyte color", 3, {
+     { PIPE_FORMAT_R32G32B32_FLOAT, PIPE_FORMAT_R32G32B32_FLOAT },
+     { PIPE_FORMAT_R10G10B10A2_SNORM, PIPE_FORMAT_R32G32B32A32_FLOAT },
+     { PIPE_FORMAT_B8G8R8A8_UNORM, PIPE_FORMAT_R32G32B32A32_FLOAT } } },
+   { "half4 -> float4", 1, {
+     { PIPE_FORMAT_R16G16B16A16_FLOAT, PIPE_FORMAT_R32G32B32A32_FLOAT } } },
+   { "half3 -> float3", 1, {
+     { PIPE_FORMAT_R16G16B16_FLOAT, PIPE_FORMAT_R32G32B32_FLOAT } } },
+   { "fixed3 -> float3", 1, {
+     { PIPE_FORMAT_R32G32B32_FIXED, PIPE_FORMAT_R32G32B32_FLOAT } } },
+   { "ubyte3 -> float3", 1, {
+     { PIPE_FORMAT_R8G8B8_UNORM, PIPE_FORMAT_R32G32B32_FLOAT } } },
+   { "short2 snorm -> float2", 1, {
+     { PIPE_FORMAT_R16G16_SNORM, PIPE_FORMAT_R32G32_FLOAT } } },
+   { "double3 -> float3", 1, {
+     { PIPE_FORMAT_R64G64B64_FLOAT, PIPE_FORMAT_R32G32B32_FLOAT } } },
+   { "fixed pos + half tex, indexed", 2, {
+     { PIPE_FORMAT_R32G32B32_FIXED, PIPE_FORMAT_R32G32B32_FLOAT },
+     { PIPE_FORMAT_R16G16_FLOAT, PIPE_FORMAT_R32G32_FLOAT } }, true },
+};
+
+int
+main(int argc, char **argv)
+{
+   unsigned count = argc > 1 ? MAX2(strtoul(argv[1], NULL, 0), 1) : 65536;
+   unsigned max_stride = 64;
+
+   uint8_t *src = malloc((size_t)count * max_stride);
+   uint8_t *dst = malloc((size_t)count * max_stride);
+   unsigned *elts = malloc(count * sizeof(*elts));
+   if (!src || !dst || !elts)
+      return 1;
+
+   /* Small values that are valid in every format. */
+   for (size_t i = 0; i < (size_t)count * max_stride; i++)
+      src[i] = i % 61;
+
+   /* A vertex cache friendly index order. */
+   for (unsigned i = 0; i < count; i++)
+      elts[i] = (i & ~7u) + ((i * 3) & 7u);
+
+   for (unsigned b = 0; b < ARRAY_SIZE(benchmarks); b++) {
+      const struct benchmark *bench = &benchmarks[b];
+      struct translate_key key;
+      unsigned input_stride = 0;
+
+      memset(&key, 0, sizeof(key));
+      key.nr_elements = bench->nr_elements;
+
+      for (unsigned i = 0; i < bench->nr_elements; i++) {
+         struct translate_element *elem = &key.element[i];
+
+         elem->type = TRANSLATE_ELEMENT_NORMAL;
+         elem->input_format = bench->element[i].input_format;
+         elem->output_format = bench->element[i].output_format;
+         elem->input_buffer = 0;
+         elem->input_offset = input_stride;
+         elem->output_offset = key.output_stride;
+
+         input_stride += util_format_get_blocksize(elem->input_format);
+         key.output_stride += util_format_get_blocksize(elem->output_format);
+      }
+      assert(input_stride <= max_stride && key.output_stride <= max_stride);
+
+      struct translate *translate = translate_create(&key);
+      if (!translate)
+         return 1;
+
+      translate->set_buffer(translate, 0, src, input_stride, count - 1);
+
+      /* Fault in the destination before timing. */
+      translate->run(translate, 0, count, 0, 0, dst);
+
+      int64_t start = os_time_get_nano();
+      for (unsigned i = 0; i < ITERATIONS; i++) {
+         if (bench->indexed)
+            translate->run_elts(translate, elts, count, 0, 0, dst);
+         else
+            translate->run(translate, 0, count, 0, 0, dst);
+      }
+      int64_t ns = os_time_get_nano() - start;
+
+      printf("%-40s %6.2f ns/vertex\n", bench->name,
+             (double)ns / ((double)count * ITERATIONS));
+
+      translate->release(translate);
+   }
+
+   free(src);
+   free(dst);
+   free(elts);
+   return 0;
+}
@@ -74,12 +74,12 @@ enum
    CONST_INV_255,
    CONST_INV_32767,
    CONST_INV_65535,
-   CONST_INV_2147483647,
-   CONST_INV_4294967295,
+   CONST_INV_65536,
    CONST_255,
-   CONST_2147483648,
+   CONST_65536,
+   CONST_MINUS_1,
    /* float consts end */
-   CONST_2147483647_INT,
+   CONST_65535_INT,
 };
 
 #define C(v) {(float)(v), (float)(v), (float)(v), (float)(v)}
@@ -89,16 +89,16 @@ static float consts[NUM_FLOAT_CONSTS][4] = {
    C(1.0 / 255.0),
    C(1.0 / 32767.0),
    C(1.0 / 65535.0),
-   C(1.0 / 2147483647.0),
-   C(1.0 / 4294967295.0),
+   C(1.0 / 65536.0),
    C(255.0),
-   C(2147483648.0),
+   C(65536.0),
+   C(-1.0),
 };
 
 #undef C
 
 static unsigned uconsts[NUM_UNSIGNED_CONSTS][4] = {
-   {0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff},
+   {0xffff, 0xffff, 0xffff, 0xffff},
 };
 
 struct translate_sse
@@ -471,6 +471,33 @@ emit_memcpy(struct translate_sse *p, struct x86_reg dst, struct x86_reg src,
    }
 }
 
+/* Whether two channels have the same type, regardless of their position. */
+static bool
+channels_match(const struct util_format_channel_description *a,
+               const struct util_format_channel_description *b)
+{
+   return a->type == b->type &&
+          a->normalized == b->normalized &&
+          a->pure_integer == b->pure_integer &&
+          a->size == b->size;
+}
+
+
+/* Whether translate_generic gets a channel of this type back unchanged when
+ * it converts it to float and back. Otherwise, copying the channel exactly
+ * would give different results than translate_generic.
+ */
+static bool
+float_round_trip_is_exact(const struct util_format_channel_description *c)
+{
+   if (c->pure_integer)
+      return true;
+   if (c->normalized)
+      return c->type == UTIL_FORMAT_TYPE_UNSIGNED && c->size == 8;
+   return c->size <= 16;
+}
+
+
 static bool
 translate_attr_convert(struct translate_sse *p,
                        const struct translate_element *a,
@@ -499,18 +526,13 @@ translate_attr_convert(struct translate_sse *p,
       return false;
 
    for (i = 1; i < input_desc->nr_channels; ++i) {
-      if (memcmp
-          (&input_desc->channel[i], &input_desc->channel[0],
-           sizeof(input_desc->channel[0])))
+      if (!channels_match(&input_desc->channel[i], &input_desc->channel[0]))
          return false;
    }
 
    for (i = 1; i < output_desc->nr_channels; ++i) {
-      if (memcmp
-          (&output_desc->channel[i], &output_desc->channel[0],
-           sizeof(output_desc->channel[0]))) {
+      if (!channels_match(&output_desc->channel[i], &output_desc->channel[0]))
          return false;
-      }
    }
 
    for (i = 0; i < output_desc->nr_channels; ++i) {
@@ -544,6 +566,10 @@ translate_attr_convert(struct translate_sse *p,
          case UTIL_FORMAT_TYPE_UNSIGNED:
             if (!(x86_target_caps(p->func) & X86_SSE2))
                return false;
+            /* 32-bit unorm is scaled in double precision in C. */
+            if (input_desc->channel[0].normalized &&
+                input_desc->channel[0].size == 32)
+               return false;
             emit_load_sse2(p, dataXMM, src,
                            input_desc->channel[0].size *
                            input_desc->nr_channels >> 3);
@@ -560,26 +586,24 @@ translate_attr_convert(struct translate_sse *p,
             case 16:
                sse2_punpcklwd(p->func, dataXMM, get_const(p, CONST_IDENTITY));
                break;
-            case 32:           /* we lose precision here */
-               /* No unsigned conversion (except in AVX512F), so we check if
-                * it's negative, and stick the high bit as a separate float
-                * value in an aux register: */
+            case 32:
+               /* No unsigned conversion (except in AVX512F), so convert
+                * the high and low 16 bits separately. Both halves and
+                * high * 65536 are exact, so the sum is rounded only once,
+                * like the C cast.
+                */
                auxXMM = x86_make_reg(file_XMM, 1);
-               /* aux = 0 */
-               sse_xorps(p->func, auxXMM, auxXMM);
-               /* aux = aux > data ? 0xffffffff : 0 */
-               sse2_pcmpgtd(p->func, auxXMM, dataXMM);
-               /* data = data & 0x7fffffff */
-               sse_andps(p->func, dataXMM, get_const(p, CONST_2147483647_INT));
-               /* aux = aux & 2147483648.0 */
-               sse_andps(p->func, auxXMM, get_const(p, CONST_2147483648));
+               sse_movaps(p->func, auxXMM, dataXMM);
+               sse2_psrld_imm(p->func, auxXMM, 16);
+               sse_andps(p->func, dataXMM, get_const(p, CONST_65535_INT));
+               sse2_cvtdq2ps(p->func, auxXMM, auxXMM);
+               sse_mulps(p->func, auxXMM, get_const(p, CONST_65536));
                break;
             default:
                return false;
             }
             sse2_cvtdq2ps(p->func, dataXMM, dataXMM);
             if (input_desc->channel[0].size == 32)
-               /* add in the high bit's worth of float that we AND'd away */
                sse_addps(p->func, dataXMM, auxXMM);
             if (input_desc->channel[0].normalized) {
                struct x86_reg factor;
@@ -590,9 +614,6 @@ translate_attr_convert(struct translate_sse *p,
                case 16:
                   factor = get_const(p, CONST_INV_65535);
                   break;
-               case 32:
-                  factor = get_const(p, CONST_INV_4294967295);
-                  break;
                default:
                   assert(0);
                   factor.disp = 0;
@@ -607,6 +628,10 @@ translate_attr_convert(struct translate_sse *p,
          case UTIL_FORMAT_TYPE_SIGNED:
             if (!(x86_target_caps(p->func) & X86_SSE2))
                return false;
+            /* 32-bit snorm is scaled in double precision in C. */
+            if (input_desc->channel[0].normalized &&
+                input_desc->channel[0].size == 32)
+               return false;
             emit_load_sse2(p, dataXMM, src,
                            input_desc->channel[0].size *
                            input_desc->nr_channels >> 3);
@@ -622,7 +647,7 @@ translate_attr_convert(struct translate_sse *p,
                sse2_punpcklwd(p->func, dataXMM, dataXMM);
                sse2_psrad_imm(p->func, dataXMM, 16);
                break;
-            case 32:           /* we lose precision here */
+            case 32:
                break;
             default:
                return false;
@@ -637,9 +662,6 @@ translate_attr_convert(struct translate_sse *p,
                case 16:
                   factor = get_const(p, CONST_INV_32767);
                   break;
-               case 32:
-                  factor = get_const(p, CONST_INV_2147483647);
-                  break;
                default:
                   assert(0);
                   factor.disp = 0;
@@ -649,11 +671,29 @@ translate_attr_convert(struct translate_sse *p,
                   break;
                }
                sse_mulps(p->func, dataXMM, factor);
+               /* The most negative value maps to -1.0 as well. */
+               sse_maxps(p->func, dataXMM, get_const(p, CONST_MINUS_1));
             }
             break;
-
+         case UTIL_FORMAT_TYPE_FIXED:
+            /* 16.16 fixed point, as used by GL_FIXED attributes. Scaling by
+             * a power of two is exact, so this rounds like the C version.
+             */
+            if (!(x86_target_caps(p->func) & X86_SSE2) ||
+                input_desc->channel[0].size != 32)
+               return false;
+            emit_load_sse2(p, dataXMM, src, 4 * input_desc->nr_channels);
+            sse2_cvtdq2ps(p->func, dataXMM, dataXMM);
+            sse_mulps(p->func, dataXMM, get_const(p, CONST_INV_65536));
             break;
          case UTIL_FORMAT_TYPE_FLOAT:
+            if (input_desc->channel[0].size == 16) {
+               if (!(x86_target_caps(p->func) & X86_F16C))
+                  return false;
+               emit_load_sse2(p, dataXMM, src, 2 * input_desc->nr_channels);
+               f16c_vcvtph2ps(p->func, dataXMM, dataXMM);
+               break;
+            }
             if (input_desc->channel[0].size != 32
                 && input_desc->channel[0].size != 64) {
                return false;
@@ -758,6 +798,9 @@ translate_attr_convert(struct translate_sse *p,
             && output_desc->channel[0].size == 16
             && output_desc->channel[0].normalized ==
             input_desc->channel[0].normalized &&
+            /* The snorm expansions below don't map 1.0 to 1.0. */
+            !(input_desc->channel[0].normalized &&
+              output_desc->channel[0].type == UTIL_FORMAT_TYPE_SIGNED) &&
             (0 || (input_desc->channel[0].type == UTIL_FORMAT_TYPE_UNSIGNED
                    && output_desc->channel[0].type == UTIL_FORMAT_TYPE_UNSIGNED)
              || (input_desc->channel[0].type == UTIL_FORMAT_TYPE_UNSIGNED
@@ -911,8 +954,8 @@ translate_attr_convert(struct translate_sse *p,
       }
       return true;
    }
-   else if (!memcmp(&output_desc->channel[0], &input_desc->channel[0],
-                    sizeof(output_desc->channel[0]))) {
+   else if (channels_match(&output_desc->channel[0], &input_desc->channel[0]) &&
+            float_round_trip_is_exact(&input_desc->channel[0])) {
       struct x86_reg tmp = p->tmp_EAX;
       unsigned i;
 
@@ -0,0 +1,153 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <gtest/gtest.h>
+
+#include "translate/translate.h"
+#include "util/format/u_format.h"
+#include "util/half_float.h"
+
+#define NUM_VERTICES 257
+#define STRIDE 32
+
+/* Plain formats whose channels all have the same type, which are the only
+ * ones translate_sse can convert.
+ */
+static bool
+is_input_format(enum pipe_format format)
+{
+   const struct util_format_description *desc = util_format_description(format);
+
+   if (!desc || desc->layout != UTIL_FORMAT_LAYOUT_PLAIN ||
+       desc->colorspace != UTIL_FORMAT_COLORSPACE_RGB ||
+       desc->block.width != 1 || desc->block.height != 1 ||
+       desc->block.bits > STRIDE * 8)
+      return false;
+
+   for (unsigned c = 0; c < desc->nr_channels; c++) {
+      if (desc->channel[c].type != desc->channel[0].type ||
+          desc->channel[c].size != desc->channel[0].size ||
+          desc->channel[c].size % 8)
+         return false;
+   }
+
+   return util_format_unpack_description(format)->unpack_rgba != NULL;
+}
+
+static void
+fill_vertices(enum pipe_format format, uint8_t *data)
+{
+   const struct util_format_description *desc = util_format_description(format);
+   unsigned size = desc->channel[0].size / 8;
+   uint32_t seed = format;
+
+   for (unsigned i = 0; i < NUM_VERTICES * STRIDE / size; i++) {
+      uint8_t *dst = data + i * size;
+
+      seed = seed * 1103515245 + 12345;
+      if (desc->channel[0].type != UTIL_FORMAT_TYPE_FLOAT) {
+         /* Random bit patterns, and the most negative snorm value, which
+          * maps to -1.0 as well, in the first vertex.
+          */
+         for (unsigned b = 0; b < size; b++) {
+            if (i < STRIDE / size)
+               dst[b] = b == size - 1 ? 0x80 : 0;
+            else
+               dst[b] = seed >> (8 + 8 * b);
+         }
+         continue;
+      }
+
+      /* Values that every output format can represent. */
+      float f = (seed >> 16) / 65535.0f;
+      if (size == 2) {
+         uint16_t h = _mesa_float_to_half(f);
+         memcpy(dst, &h, sizeof(h));
+      } else if (size == 4) {
+         memcpy(dst, &f, sizeof(f));
+      } else {
+         double d = f;
+         memcpy(dst, &d, sizeof(d));
+      }
+   }
+}
+
+/* translate_sse has to give the same results as translate_generic for every
+ * conversion it accepts.
+ */
+TEST(translate_sse, matches_generic)
+{
+   static uint8_t src[NUM_VERTICES * STRIDE];
+   static uint8_t expected[NUM_VERTICES * STRIDE];
+   static uint8_t actual[NUM_VERTICES * STRIDE];
+   unsigned tested = 0;
+
+   for (unsigned in = 1; in < PIPE_FORMAT_COUNT; in++) {
+      enum pipe_format input_format = (enum pipe_format)in;
+      if (!is_input_format(input_format))
+         continue;
+
+      const struct util_format_description *input_desc =
+         util_format_description(input_format);
+      fill_vertices(input_format, src);
+
+      for (unsigned out = 1; out < PIPE_FORMAT_COUNT; out++) {
+         enum pipe_format output_format = (enum pipe_format)out;
+         if (!translate_generic_is_output_format_supported(output_format))
+            continue;
+
+         /* Pure integers are only ever converted to pure integers. */
+         if (util_format_description(output_format)->channel[0].pure_integer !=
+             input_desc->channel[0].pure_integer)
+            continue;
+
+         /* draw's float color to 4ub special case rounds to nearest, where
+          * translate_generic truncates.
+          */
+         if (input_format == PIPE_FORMAT_R32G32B32A32_FLOAT &&
+             (output_format == PIPE_FORMAT_R8G8B8A8_UNORM ||
+              output_format == PIPE_FORMAT_B8G8R8A8_UNORM))
+            continue;
+
+         struct translate_key key;
+         memset(&key, 0, sizeof(key));
+         key.output_stride = STRIDE;
+         key.nr_elements = 1;
+         key.element[0].type = TRANSLATE_ELEMENT_NORMAL;
+         key.element[0].input_format = input_format;
+         key.element[0].output_format = output_format;
+
+         struct translate *generic = translate_generic_create(&key);
+         if (!generic)
+            continue;
+         struct translate *sse = translate_sse2_create(&key);
+         if (!sse) {
+            generic->release(generic);
+            continue;
+         }
+
+         generic->set_buffer(generic, 0, src, STRIDE, NUM_VERTICES - 1);
+         sse->set_buffer(sse, 0, src, STRIDE, NUM_VERTICES - 1);
+         memset(expected, 0xcd, sizeof(expected));
+         memset(actual, 0xcd, sizeof(actual));
+         generic->run(generic, 0, NUM_VERTICES, 0, 0, expected);
+         sse->run(sse, 0, NUM_VERTICES, 0, 0, actual);
+
+         unsigned size = util_format_get_blocksize(output_format);
+         for (unsigned v = 0; v < NUM_VERTICES; v++) {
+            if (memcmp(expected + v * STRIDE, actual + v * STRIDE, size)) {
+               ADD_FAILURE() << input_desc->short_name << " -> "
+                             << util_format_short_name(output_format)
+                             << " differs at vertex " << v;
+               break;
+            }
+         }
+         tested++;
+
+         generic->release(generic);
+         sse->release(sse);
+      }
+   }
+
+   if (!tested)
+      GTEST_SKIP() << "translate_sse isn't available";
+}
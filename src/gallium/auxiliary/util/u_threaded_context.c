@@ -32,6 +32,7 @@
 #include "util/u_upload_mgr.h"
 #include "driver_trace/tr_context.h"
 #include "util/log.h"
+#include "util/os_time.h"
 #include "util/perf/cpu_trace.h"
 #include "util/thread_sched.h"
 #include "compiler/shader_info.h"
@@ -485,15 +486,43 @@ tc_add_call_end(struct tc_batch *next)
 #endif
 }
 
+/* Choose the size of the next batch, see TC_BATCH_TARGET_NS. */
+static void
+tc_update_batch_slot_limit(struct threaded_context *tc, bool driver_busy)
+{
+   unsigned slot_time_ps = p_atomic_read(&tc->slot_execution_time_ps);
+
+   if (driver_busy || !slot_time_ps) {
+      tc->batch_slot_limit = TC_SLOTS_PER_BATCH - 1;
+   } else {
+      uint64_t num_slots = TC_BATCH_TARGET_NS * 1000ull / slot_time_ps;
+
+      tc->batch_slot_limit = CLAMP(num_slots, TC_MIN_SLOTS_PER_BATCH,
+                                   TC_SLOTS_PER_BATCH - 1);
+   }
+}
+
 static void
 tc_batch_flush(struct threaded_context *tc, bool full_copy)
 {
    struct tc_batch *next = &tc->batch_slots[tc->next];
    unsigned next_id = (tc->next + 1) % TC_MAX_BATCHES;
+   bool driver_busy =
+      !util_queue_fence_is_signalled(&tc->batch_slots[tc->last].fence);
 
    tc_assert(next->num_total_slots != 0);
    tc_add_call_end(next);
 
+   /* If the driver thread hasn't executed the batch we are going to record
+    * next, the queue is full and we have to wait. Do it here to measure it.
+    */
+   if (!util_queue_fence_is_signalled(&tc->batch_slots[next_id].fence)) {
+      int64_t start = os_time_get_nano();
+
+      util_queue_fence_wait(&tc->batch_slots[next_id].fence);
+      p_atomic_add(&tc->stall_time_us, (os_time_get_nano() - start) / 1000);
+   }
+
    tc_batch_check(next);
    tc_debug_check(tc);
    tc->bytes_mapped_estimate = 0;
@@ -523,7 +552,7 @@ tc_batch_flush(struct threaded_context *tc, bool full_copy)
    if (next_id == 0)
       tc->batch_generation++;
    tc_begin_next_buffer_list(tc);
-
+   tc_update_batch_slot_limit(tc, driver_busy);
 }
 
 /* This is the function that adds variable-sized calls into the current
@@ -539,7 +568,8 @@ tc_add_sized_call(struct threaded_context *tc, enum tc_call_id id,
    assert(num_slots <= TC_SLOTS_PER_BATCH - 1);
    tc_debug_check(tc);
 
-   if (unlikely(next->num_total_slots + num_slots > TC_SLOTS_PER_BATCH - 1)) {
+   if (unlikely(next->num_total_slots + num_slots > tc->batch_slot_limit &&
+                next->num_total_slots)) {
       /* copy existing renderpass info during flush */
       tc_batch_flush(tc, true);
       next = &tc->batch_slots[tc->next];
@@ -608,7 +638,7 @@ tc_enlarge_last_mergeable_call(struct threaded_context *tc, unsigned desired_num
 
    unsigned added_slots = desired_num_slots - call->num_slots;
 
-   if (unlikely(batch->num_total_slots + added_slots > TC_SLOTS_PER_BATCH - 1))
+   if (unlikely(batch->num_total_slots + added_slots > tc->batch_slot_limit))
       return false;
 
    batch->num_total_slots += added_slots;
@@ -636,8 +666,29 @@ tc_is_sync(struct threaded_context *tc)
           !next->num_total_slots;
 }
 
+/* Whether the unflushed batch should be executed by the calling thread
+ * instead of being queued, see TC_DIRECT_FLUSH_MAX_NS.
+ */
+static bool
+tc_should_execute_directly(struct threaded_context *tc)
+{
+   struct tc_batch *last = &tc->batch_slots[tc->last];
+   struct tc_batch *next = &tc->batch_slots[tc->next];
+   unsigned slot_time_ps = p_atomic_read(&tc->slot_execution_time_ps);
+   unsigned flush_time_ns = p_atomic_read(&tc->flush_execution_time_ns);
+
+   return slot_time_ps && flush_time_ns &&
+          util_queue_fence_is_signalled(&last->fence) &&
+          (uint64_t)next->num_total_slots * slot_time_ps +
+          flush_time_ns * 1000ull <= TC_DIRECT_FLUSH_MAX_NS * 1000ull;
+}
+
+/* If "direct_flush" is true, this is a flush that chose to execute
+ * the unflushed batch directly, which isn't counted as a sync.
+ */
 static void
-_tc_sync(struct threaded_context *tc, UNUSED const char *info, UNUSED const char *func)
+_tc_sync(struct threaded_context *tc, UNUSED const char *info, UNUSED const char *func,
+         bool direct_flush)
 {
    struct tc_batch *last = &tc->batch_slots[tc->last];
    struct tc_batch *next = &tc->batch_slots[tc->next];
@@ -685,7 +736,9 @@ _tc_sync(struct threaded_context *tc, UNUSED const char *info, UNUSED const char
       synced = true;
    }
 
-   if (synced) {
+   if (direct_flush) {
+      p_atomic_inc(&tc->num_direct_flushes);
+   } else if (synced) {
       p_atomic_inc(&tc->num_syncs);
 
       if (tc_strcmp(func, "tc_destroy") != 0) {
@@ -713,8 +766,8 @@ _tc_sync(struct threaded_context *tc, UNUSED const char *info, UNUSED const char
    }
 }
 
-#define tc_sync(tc) _tc_sync(tc, "", __func__)
-#define tc_sync_msg(tc, info) _tc_sync(tc, info, __func__)
+#define tc_sync(tc) _tc_sync(tc, "", __func__, false)
+#define tc_sync_msg(tc, info) _tc_sync(tc, info, __func__, false)
 
 /**
  * Call this from fence_finish for same-context fence waits of deferred fences
@@ -3590,11 +3643,25 @@ tc_call_flush(struct pipe_context *pipe, void *call)
 {
    struct tc_flush_call *p = to_call(call, tc_flush_call);
    struct pipe_screen *screen = pipe->screen;
+   struct threaded_context *tc = p->tc;
 
+   /* Timing every flush is cheap compared to the flush itself. The cost
+    * is used by tc_should_execute_directly and left out of the time per slot
+    * in tc_batch_execute.
+    */
+   int64_t start = os_time_get_nano();
    pipe->flush(pipe, p->fence ? &p->fence : NULL, p->flags);
+   uint64_t flush_ns = os_time_get_nano() - start;
+   uint64_t average = p_atomic_read(&tc->flush_execution_time_ns);
+
+   average = average ? (average * 7 + flush_ns) / 8 : flush_ns;
+   p_atomic_set(&tc->flush_execution_time_ns,
+                MAX2(MIN2(average, UINT32_MAX), 1));
+   tc->executed_flush_time_ns += flush_ns;
+
    screen->fence_reference(screen, &p->fence, NULL);
 
-   tc_flush_queries(p->tc);
+   tc_flush_queries(tc);
 
    return call_size(tc_flush_call);
 }
@@ -3645,7 +3712,13 @@ tc_flush(struct pipe_context *_pipe, struct pipe_fence_handle **fence,
       if (!deferred) {
          /* non-deferred async flushes indicate completion of existing renderpass info */
          tc_signal_renderpass_info_ready(tc);
-         tc_batch_flush(tc, false);
+         if (tc_should_execute_directly(tc)) {
+            tc->flushing = true;
+            _tc_sync(tc, "", __func__, true);
+            tc->flushing = false;
+         } else {
+            tc_batch_flush(tc, false);
+         }
          tc->seen_fb_state = false;
       }
 
@@ -4013,10 +4086,10 @@ tc_draw_multi(struct pipe_context *_pipe, const struct pipe_draw_info *info,
    while (num_draws) {
       struct tc_batch *next = &tc->batch_slots[tc->next];
 
-      int nb_slots_left = TC_SLOTS_PER_BATCH - 1 - next->num_total_slots;
+      int nb_slots_left = (int)tc->batch_slot_limit - next->num_total_slots;
       /* If there isn't enough place for one draw, try to fill the next one */
       if (nb_slots_left < SLOTS_FOR_ONE_DRAW)
-         nb_slots_left = TC_SLOTS_PER_BATCH - 1;
+         nb_slots_left = tc->batch_slot_limit;
       const int size_left_bytes = nb_slots_left * sizeof(struct tc_call_base);
 
       /* How many draws can we fit in the current batch */
@@ -4082,10 +4155,10 @@ tc_draw_user_indices_multi(struct pipe_context *_pipe,
    while (num_draws) {
       struct tc_batch *next = &tc->batch_slots[tc->next];
 
-      int nb_slots_left = TC_SLOTS_PER_BATCH - 1 - next->num_total_slots;
+      int nb_slots_left = (int)tc->batch_slot_limit - next->num_total_slots;
       /* If there isn't enough place for one draw, try to fill the next one */
       if (nb_slots_left < SLOTS_FOR_ONE_DRAW)
-         nb_slots_left = TC_SLOTS_PER_BATCH - 1;
+         nb_slots_left = tc->batch_slot_limit;
       const int size_left_bytes = nb_slots_left * sizeof(struct tc_call_base);
 
       /* How many draws can we fit in the current batch */
@@ -4377,10 +4450,10 @@ tc_draw_vertex_state(struct pipe_context *_pipe,
    while (num_draws) {
       struct tc_batch *next = &tc->batch_slots[tc->next];
 
-      int nb_slots_left = TC_SLOTS_PER_BATCH - 1 - next->num_total_slots;
+      int nb_slots_left = (int)tc->batch_slot_limit - next->num_total_slots;
       /* If there isn't enough place for one draw, try to fill the next one */
       if (nb_slots_left < slots_for_one_draw)
-         nb_slots_left = TC_SLOTS_PER_BATCH - 1;
+         nb_slots_left = tc->batch_slot_limit;
       const int size_left_bytes = nb_slots_left * sizeof(struct tc_call_base);
 
       /* How many draws can we fit in the current batch */
@@ -5167,6 +5240,14 @@ tc_batch_execute(void *job, UNUSED void *gdata, int thread_index)
 {
    struct tc_batch *batch = job;
    struct pipe_context *pipe = batch->tc->pipe;
+   bool sample = batch->tc->num_executed_batches++ %
+                 TC_BATCH_SAMPLE_INTERVAL == 0;
+   int64_t start = 0;
+
+   if (sample) {
+      batch->tc->executed_flush_time_ns = 0;
+      start = os_time_get_nano();
+   }
 
    tc_batch_check(batch);
    tc_set_driver_thread(batch->tc);
@@ -5189,6 +5270,18 @@ tc_batch_execute(void *job, UNUSED void *gdata, int thread_index)
       batch_execute(batch, pipe, false);
    }
 
+   /* Update the average time per slot for tc_update_batch_slot_limit. */
+   if (sample && batch->num_total_slots) {
+      uint64_t batch_ns = os_time_get_nano() - start;
+      uint64_t flush_ns = MIN2(batch->tc->executed_flush_time_ns, batch_ns);
+      uint64_t slot_ps = (batch_ns - flush_ns) * 1000 / batch->num_total_slots;
+      uint64_t average = p_atomic_read(&batch->tc->slot_execution_time_ps);
+
+      average = average ? (average * 7 + slot_ps) / 8 : slot_ps;
+      p_atomic_set(&batch->tc->slot_execution_time_ps,
+                   MAX2(MIN2(average, UINT32_MAX), 1));
+   }
+
    /* Add the fence to the list of fences for the driver to signal at the next
     * flush, which we use for tracking which buffers are referenced by
     * an unflushed command buffer.
@@ -5361,6 +5454,7 @@ threaded_context_create(struct pipe_context *pipe,
       goto fail;
 
    tc->last_completed = -1;
+   tc->batch_slot_limit = TC_SLOTS_PER_BATCH - 1;
    for (unsigned i = 0; i < TC_MAX_BATCHES; i++) {
 #if !defined(NDEBUG) && TC_DEBUG >= 1
       tc->batch_slots[i].sentinel = TC_SENTINEL;
@@ -252,6 +252,28 @@ struct tc_unflushed_batch_token;
  */
 #define TC_SLOTS_PER_BATCH    1536
 
+/* Batches are flushed early when the driver is slow to execute them, so that
+ * it can start sooner. The number of slots is chosen so that the driver takes
+ * about TC_BATCH_TARGET_NS to execute a batch, based on the measured time per
+ * slot, but never fewer than TC_MIN_SLOTS_PER_BATCH. If the driver thread is
+ * still busy when a batch is flushed, the next batch uses all slots, because
+ * smaller batches would only make the queue fill up sooner.
+ */
+#define TC_MIN_SLOTS_PER_BATCH 256
+#define TC_BATCH_TARGET_NS    (100 * 1000)
+
+/* Only one batch in this many is timed, because os_time_get_nano() is too
+ * expensive to call for every batch with some clock sources.
+ */
+#define TC_BATCH_SAMPLE_INTERVAL 16
+
+/* A non-deferred flush executes the unflushed batch directly in the calling
+ * thread if the driver thread is idle and the batch, including the driver
+ * flush at its end, is expected to take less than this, which is cheaper
+ * than waking up the driver thread.
+ */
+#define TC_DIRECT_FLUSH_MAX_NS (10 * 1000)
+
 /* The buffer list queue is much deeper than the batch queue because buffer
  * lists need to stay around until the driver internally flushes its command
  * buffer.
@@ -585,6 +607,22 @@ struct threaded_context {
    unsigned num_offloaded_slots;
    unsigned num_direct_slots;
    unsigned num_syncs;
+   unsigned num_direct_flushes;
+   unsigned stall_time_us; /* time spent waiting for a free batch */
+
+   /* The unflushed batch is flushed when it would exceed this number of
+    * slots. See TC_BATCH_TARGET_NS.
+    */
+   unsigned batch_slot_limit;
+   /* Moving average of the time the driver takes to execute one slot,
+    * not counting driver flushes.
+    */
+   unsigned slot_execution_time_ps;
+   /* Moving average of the time pipe->flush takes in the driver thread. */
+   unsigned flush_execution_time_ns;
+   /* Only accessed by the thread executing batches. */
+   unsigned num_executed_batches;
+   uint64_t executed_flush_time_ns;
 
    bool use_forced_staging_uploads;
    bool add_all_gfx_bindings_to_buffer_list;
@@ -29,14 +29,27 @@
  * coalescing small buffers into larger ones.
  */
 
+#include <inttypes.h>
+
 #include "pipe/p_defines.h"
 #include "util/u_inlines.h"
 #include "pipe/p_context.h"
 #include "util/u_memory.h"
 #include "util/u_math.h"
+#include "util/u_debug.h"
+#include "util/log.h"
 
 #include "u_upload_mgr.h"
 
+#define U_UPLOAD_MAX_RING_BUFFERS 8
+
+DEBUG_GET_ONCE_BOOL_OPTION(upload_stats, "GALLIUM_UPLOAD_STATS", false)
+
+struct u_upload_ring_buffer {
+   struct pipe_resource *buffer;
+   struct pipe_transfer *transfer;
+   uint8_t *map;
+};
 
 struct u_upload_mgr {
    struct pipe_context *pipe;
@@ -55,6 +68,14 @@ struct u_upload_mgr {
    unsigned offset; /* Aligned offset to the upload buffer, pointing
                      * at the first unused byte. */
    int buffer_private_refcount;
+
+   /* Full buffers kept mapped for reuse, oldest first. */
+   struct u_upload_ring_buffer ring[U_UPLOAD_MAX_RING_BUFFERS];
+   unsigned num_ring_buffers;
+   unsigned max_ring_buffers;
+   int map_refcount; /* Buffer references held by a mapping. */
+
+   struct u_upload_stats stats;
 };
 
 
@@ -108,16 +129,41 @@ u_upload_clone(struct pipe_context *pipe, struct u_upload_mgr *upload)
                                                  upload->flags);
    if (!upload->map_persistent && result->map_persistent)
       u_upload_disable_persistent(result);
+   if (upload->max_ring_buffers)
+      u_upload_enable_ring(result, upload->max_ring_buffers);
 
    return result;
 }
 
+static void
+u_upload_release_ring(struct u_upload_mgr *upload)
+{
+   for (unsigned i = 0; i < upload->num_ring_buffers; i++) {
+      pipe_buffer_unmap(upload->pipe, upload->ring[i].transfer);
+      pipe_resource_reference(&upload->ring[i].buffer, NULL);
+   }
+   upload->num_ring_buffers = 0;
+}
+
 void
 u_upload_disable_persistent(struct u_upload_mgr *upload)
 {
    upload->map_persistent = false;
    upload->map_flags &= ~(PIPE_MAP_COHERENT | PIPE_MAP_PERSISTENT);
    upload->map_flags |= PIPE_MAP_FLUSH_EXPLICIT;
+   u_upload_release_ring(upload);
+}
+
+void
+u_upload_enable_ring(struct u_upload_mgr *upload, unsigned max_buffers)
+{
+   upload->max_ring_buffers = MIN2(max_buffers, U_UPLOAD_MAX_RING_BUFFERS);
+}
+
+void
+u_upload_get_stats(struct u_upload_mgr *upload, struct u_upload_stats *stats)
+{
+   *stats = upload->stats;
 }
 
 static void
@@ -147,10 +193,8 @@ u_upload_unmap(struct u_upload_mgr *upload)
 
 
 static void
-u_upload_release_buffer(struct u_upload_mgr *upload)
+u_upload_drop_private_refs(struct u_upload_mgr *upload)
 {
-   /* Unmap and unreference the upload buffer. */
-   upload_unmap_internal(upload, true);
    if (upload->buffer_private_refcount) {
       /* Subtract the remaining private references before unreferencing
        * the buffer. The mega comment below explains it.
@@ -160,33 +204,117 @@ u_upload_release_buffer(struct u_upload_mgr *upload)
                    -upload->buffer_private_refcount);
       upload->buffer_private_refcount = 0;
    }
+}
+
+
+static void
+u_upload_release_buffer(struct u_upload_mgr *upload)
+{
+   /* Unmap and unreference the upload buffer. */
+   upload_unmap_internal(upload, true);
+   u_upload_drop_private_refs(upload);
    pipe_resource_reference(&upload->buffer, NULL);
    upload->buffer_size = 0;
 }
 
 
+/* Move the full upload buffer to the ring, keeping it mapped. */
+static bool
+u_upload_retire_buffer(struct u_upload_mgr *upload)
+{
+   if (!upload->max_ring_buffers || !upload->map_persistent ||
+       !upload->buffer || !upload->map)
+      return false;
+
+   if (upload->num_ring_buffers == upload->max_ring_buffers) {
+      pipe_buffer_unmap(upload->pipe, upload->ring[0].transfer);
+      pipe_resource_reference(&upload->ring[0].buffer, NULL);
+      memmove(&upload->ring[0], &upload->ring[1],
+              (upload->num_ring_buffers - 1) * sizeof(upload->ring[0]));
+      upload->num_ring_buffers--;
+   }
+
+   u_upload_drop_private_refs(upload);
+   upload->ring[upload->num_ring_buffers++] = (struct u_upload_ring_buffer) {
+      upload->buffer, upload->transfer, upload->map,
+   };
+   upload->buffer = NULL;
+   upload->transfer = NULL;
+   upload->map = NULL;
+   upload->buffer_size = 0;
+   return true;
+}
+
+
+static bool
+u_upload_buffer_is_idle(struct u_upload_mgr *upload,
+                        struct pipe_resource *buffer)
+{
+   struct pipe_transfer *transfer;
+
+   /* Only the ring and its mapping reference it, so it's not bound
+    * anywhere, and the driver doesn't use it anymore if it can be mapped
+    * without waiting.
+    */
+   if (p_atomic_read(&buffer->reference.count) != 1 + upload->map_refcount)
+      return false;
+
+   if (!pipe_buffer_map_range(upload->pipe, buffer, 0, 1,
+                              PIPE_MAP_WRITE | PIPE_MAP_DONTBLOCK,
+                              &transfer))
+      return false;
+
+   pipe_buffer_unmap(upload->pipe, transfer);
+   return true;
+}
+
+
+/* Make an idle ring buffer of at least min_size bytes current. */
+static bool
+u_upload_reuse_ring_buffer(struct u_upload_mgr *upload, unsigned min_size)
+{
+   for (unsigned i = 0; i < upload->num_ring_buffers; i++) {
+      struct u_upload_ring_buffer *ring = &upload->ring[i];
+
+      if (ring->buffer->width0 < min_size ||
+          !u_upload_buffer_is_idle(upload, ring->buffer))
+         continue;
+
+      upload->buffer = ring->buffer;
+      upload->transfer = ring->transfer;
+      upload->map = ring->map;
+      memmove(ring, ring + 1,
+              (upload->num_ring_buffers - i - 1) * sizeof(*ring));
+      upload->num_ring_buffers--;
+      return true;
+   }
+   return false;
+}
+
+
 void
 u_upload_destroy(struct u_upload_mgr *upload)
 {
+   if (debug_get_option_upload_stats()) {
+      mesa_logi("u_upload_mgr %p: %" PRIu64 " bytes allocated, %" PRIu64
+                " bytes copied, %u buffers created, %u buffers reused",
+                (void *)upload, upload->stats.bytes_allocated,
+                upload->stats.bytes_copied, upload->stats.buffers_created,
+                upload->stats.buffers_reused);
+   }
+
    u_upload_release_buffer(upload);
+   u_upload_release_ring(upload);
    FREE(upload);
 }
 
-/* Return the allocated buffer size or 0 if it failed. */
+/* Create a new upload buffer and return its size or 0 if it failed. */
 static unsigned
-u_upload_alloc_buffer(struct u_upload_mgr *upload, unsigned min_size)
+u_upload_create_buffer(struct u_upload_mgr *upload, unsigned min_size)
 {
    struct pipe_screen *screen = upload->pipe->screen;
    struct pipe_resource buffer;
-   unsigned size;
-
-   /* Release the old buffer, if present:
-    */
-   u_upload_release_buffer(upload);
-
-   /* Allocate a new one:
-    */
-   size = align(MAX2(upload->default_size, min_size), 4096);
+   unsigned size = align(MAX2(upload->default_size, min_size), 4096);
 
    memset(&buffer, 0, sizeof buffer);
    buffer.target = PIPE_BUFFER;
@@ -208,6 +336,32 @@ u_upload_alloc_buffer(struct u_upload_mgr *upload, unsigned min_size)
    if (upload->buffer == NULL)
       return 0;
 
+   upload->stats.buffers_created++;
+   return size;
+}
+
+/* Return the allocated buffer size or 0 if it failed. */
+static unsigned
+u_upload_alloc_buffer(struct u_upload_mgr *upload, unsigned min_size)
+{
+   unsigned size;
+
+   /* Release the old buffer, if present, or keep it for reuse:
+    */
+   if (!u_upload_retire_buffer(upload))
+      u_upload_release_buffer(upload);
+
+   /* Reuse an idle one or allocate a new one:
+    */
+   if (u_upload_reuse_ring_buffer(upload, min_size)) {
+      size = upload->buffer->width0;
+      upload->stats.buffers_reused++;
+   } else {
+      size = u_upload_create_buffer(upload, min_size);
+      if (!size)
+         return 0;
+   }
+
    /* Since atomic operations are very very slow when 2 threads are not
     * sharing the same L3 cache (which happens on AMD Zen), eliminate all
     * atomics in u_upload_alloc as follows:
@@ -235,13 +389,19 @@ u_upload_alloc_buffer(struct u_upload_mgr *upload, unsigned min_size)
    assert(upload->buffer_private_refcount < INT32_MAX / 2);
    p_atomic_add(&upload->buffer->reference.count, upload->buffer_private_refcount);
 
-   /* Map the new buffer. */
-   upload->map = pipe_buffer_map_range(upload->pipe, upload->buffer,
-                                       0, size, upload->map_flags,
-                                       &upload->transfer);
-   if (upload->map == NULL) {
-      u_upload_release_buffer(upload);
-      return 0;
+   /* Map the new buffer. Reused buffers are still mapped. */
+   if (!upload->map) {
+      int refcount = p_atomic_read(&upload->buffer->reference.count);
+
+      upload->map = pipe_buffer_map_range(upload->pipe, upload->buffer,
+                                          0, size, upload->map_flags,
+                                          &upload->transfer);
+      if (upload->map == NULL) {
+         u_upload_release_buffer(upload);
+         return 0;
+      }
+      upload->map_refcount =
+         p_atomic_read(&upload->buffer->reference.count) - refcount;
    }
 
    upload->buffer_size = size;
@@ -312,6 +472,7 @@ u_upload_alloc(struct u_upload_mgr *upload,
    }
 
    upload->offset = offset + size;
+   upload->stats.bytes_allocated += size;
 }
 
 void
@@ -328,6 +489,8 @@ u_upload_data(struct u_upload_mgr *upload,
    u_upload_alloc(upload, min_out_offset, size, alignment,
                   out_offset, outbuf,
                   (void**)&ptr);
-   if (ptr)
+   if (ptr) {
       memcpy(ptr, data, size);
+      upload->stats.bytes_copied += size;
+   }
 }
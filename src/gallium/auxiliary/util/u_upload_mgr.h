@@ -42,6 +42,13 @@ struct pipe_resource;
 extern "C" {
 #endif
 
+struct u_upload_stats {
+   uint64_t bytes_allocated;  /**< Bytes returned by u_upload_alloc */
+   uint64_t bytes_copied;     /**< Bytes copied by u_upload_data */
+   unsigned buffers_created;
+   unsigned buffers_reused;   /**< Buffers taken back from the ring */
+};
+
 /**
  * Create the upload manager.
  *
@@ -73,6 +80,20 @@ u_upload_clone(struct pipe_context *pipe, struct u_upload_mgr *upload);
 void
 u_upload_disable_persistent(struct u_upload_mgr *upload);
 
+/**
+ * Keep up to max_buffers full upload buffers mapped and reuse them once
+ * nothing references them and the driver is done with them, instead of
+ * creating a new buffer every time the current one is full.
+ *
+ * This only has an effect with persistent mappings.
+ */
+void
+u_upload_enable_ring(struct u_upload_mgr *upload, unsigned max_buffers);
+
+/** Return the statistics of the upload manager. */
+void
+u_upload_get_stats(struct u_upload_mgr *upload, struct u_upload_stats *stats);
+
 /**
  * Destroy the upload manager.
  */
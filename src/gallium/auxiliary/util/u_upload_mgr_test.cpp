@@ -0,0 +1,175 @@
+/* SPDX-License-Identifier: MIT */
+
+#include "pipe/p_context.h"
+#include "pipe/p_screen.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "u_upload_mgr.h"
+#include <gtest/gtest.h>
+
+/* A driver whose buffers live in malloc'ed memory. Mappings hold a buffer
+ * reference like in real drivers, and a buffer marked busy can't be mapped
+ * with PIPE_MAP_DONTBLOCK, like a buffer the GPU still uses.
+ */
+struct test_buffer {
+   struct pipe_resource base;
+   uint8_t *data;
+   bool busy;
+};
+
+static struct pipe_resource *
+test_resource_create(struct pipe_screen *screen,
+                     const struct pipe_resource *templ)
+{
+   struct test_buffer *buf = CALLOC_STRUCT(test_buffer);
+
+   buf->base = *templ;
+   buf->base.screen = screen;
+   pipe_reference_init(&buf->base.reference, 1);
+   buf->data = (uint8_t *)CALLOC(1, templ->width0);
+   return &buf->base;
+}
+
+static void
+test_resource_destroy(struct pipe_screen *screen, struct pipe_resource *res)
+{
+   struct test_buffer *buf = (struct test_buffer *)res;
+
+   FREE(buf->data);
+   FREE(buf);
+}
+
+static void *
+test_buffer_map(struct pipe_context *pipe, struct pipe_resource *res,
+                unsigned level, unsigned usage, const struct pipe_box *box,
+                struct pipe_transfer **out_transfer)
+{
+   struct test_buffer *buf = (struct test_buffer *)res;
+
+   if (buf->busy && (usage & PIPE_MAP_DONTBLOCK))
+      return NULL;
+
+   struct pipe_transfer *transfer = CALLOC_STRUCT(pipe_transfer);
+   pipe_resource_reference(&transfer->resource, res);
+   transfer->usage = (enum pipe_map_flags)usage;
+   transfer->box = *box;
+
+   *out_transfer = transfer;
+   return buf->data + box->x;
+}
+
+static void
+test_buffer_unmap(struct pipe_context *pipe, struct pipe_transfer *transfer)
+{
+   pipe_resource_reference(&transfer->resource, NULL);
+   FREE(transfer);
+}
+
+class u_upload_mgr_ring : public ::testing::Test {
+protected:
+   /* Allocated because pipe_screen has a const member. */
+   struct pipe_screen *screen;
+   struct pipe_context *pipe;
+   struct u_upload_mgr *upload;
+
+   static const unsigned buffer_size = 4096;
+   static const unsigned max_ring_buffers = 2;
+
+   void SetUp() override
+   {
+      screen = CALLOC_STRUCT(pipe_screen);
+      pipe = CALLOC_STRUCT(pipe_context);
+
+      ((struct pipe_caps *)&screen->caps)->buffer_map_persistent_coherent = true;
+      screen->resource_create = test_resource_create;
+      screen->resource_destroy = test_resource_destroy;
+      pipe->screen = screen;
+      pipe->buffer_map = test_buffer_map;
+      pipe->buffer_unmap = test_buffer_unmap;
+
+      upload = u_upload_create(pipe, buffer_size, PIPE_BIND_VERTEX_BUFFER,
+                               PIPE_USAGE_STREAM, 0);
+      u_upload_enable_ring(upload, max_ring_buffers);
+   }
+
+   void TearDown() override
+   {
+      u_upload_destroy(upload);
+      FREE(pipe);
+      FREE(screen);
+   }
+
+   /* Fill a whole upload buffer and return it with a reference. */
+   struct pipe_resource *fill_buffer()
+   {
+      struct pipe_resource *buffer = NULL;
+      unsigned offset;
+      void *ptr;
+
+      u_upload_alloc(upload, 0, buffer_size, 4, &offset, &buffer, &ptr);
+      EXPECT_NE(ptr, nullptr);
+      EXPECT_EQ(offset, 0u);
+      return buffer;
+   }
+};
+
+TEST_F(u_upload_mgr_ring, bound_buffer_is_not_reused)
+{
+   struct pipe_resource *bound = fill_buffer();
+
+   /* Go through more buffers than the ring holds while the first one stays
+    * bound. The others are released right away, so they can be reused.
+    */
+   for (unsigned i = 0; i < max_ring_buffers * 2; i++) {
+      struct pipe_resource *buffer = fill_buffer();
+
+      EXPECT_NE(buffer, bound);
+      pipe_resource_reference(&buffer, NULL);
+   }
+
+   struct u_upload_stats stats;
+   u_upload_get_stats(upload, &stats);
+   EXPECT_EQ(stats.buffers_created, 2u);
+   EXPECT_EQ(stats.buffers_reused, max_ring_buffers * 2 - 1);
+
+   /* Once unbound, the first buffer is the oldest idle one. */
+   struct pipe_resource *unbound = bound;
+   pipe_resource_reference(&bound, NULL);
+
+   struct pipe_resource *buffer = fill_buffer();
+   EXPECT_EQ(buffer, unbound);
+   pipe_resource_reference(&buffer, NULL);
+
+   u_upload_get_stats(upload, &stats);
+   EXPECT_EQ(stats.buffers_created, 2u);
+}
+
+TEST_F(u_upload_mgr_ring, busy_buffer_is_not_reused)
+{
+   struct pipe_resource *busy = fill_buffer();
+   struct pipe_resource *first_busy = busy;
+
+   ((struct test_buffer *)busy)->busy = true;
+   pipe_resource_reference(&busy, NULL);
+
+   struct pipe_resource *buffer = fill_buffer();
+   pipe_resource_reference(&buffer, NULL);
+
+   /* The busy buffer is the oldest in the ring, but only the other one
+    * can be mapped without waiting.
+    */
+   buffer = fill_buffer();
+   EXPECT_NE(buffer, first_busy);
+   pipe_resource_reference(&buffer, NULL);
+
+   ((struct test_buffer *)first_busy)->busy = false;
+
+   buffer = fill_buffer();
+   EXPECT_EQ(buffer, first_busy);
+   pipe_resource_reference(&buffer, NULL);
+
+   struct u_upload_stats stats;
+   u_upload_get_stats(upload, &stats);
+   EXPECT_EQ(stats.buffers_created, 2u);
+   EXPECT_EQ(stats.buffers_reused, 2u);
+}
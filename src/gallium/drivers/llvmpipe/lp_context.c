@@ -309,6 +309,7 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    llvmpipe->pipe.stream_uploader = u_upload_create_default(&llvmpipe->pipe);
    if (!llvmpipe->pipe.stream_uploader)
       goto fail;
+   u_upload_enable_ring(llvmpipe->pipe.stream_uploader, 4);
 
    llvmpipe->pipe.const_uploader = llvmpipe->pipe.stream_uploader;
 
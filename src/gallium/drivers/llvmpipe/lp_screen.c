@@ -101,6 +101,7 @@ static const struct debug_named_value lp_perf_flags[] = {
    { "no_alphatest",   PERF_NO_ALPHATEST, NULL },
    { "no_rast_linear", PERF_NO_RAST_LINEAR, NULL },
    { "no_shade",       PERF_NO_SHADE, NULL },
+   { "pbo_transfer",   PERF_PBO_TRANSFER, NULL },
    DEBUG_NAMED_VALUE_END
 };
 
@@ -198,9 +199,7 @@ llvmpipe_init_screen_caps(struct pipe_screen *screen)
 
    u_init_pipe_screen_caps(screen, 0);
 
-#ifdef HAVE_LIBDRM
    struct llvmpipe_screen *lscreen = llvmpipe_screen(screen);
-#endif
 
 #ifdef HAVE_LIBDRM
    if (lscreen->winsys->get_fd)
@@ -290,7 +289,13 @@ llvmpipe_init_screen_caps(struct pipe_screen *screen)
    /* Adressing that many 64bpp texels fits in an i32 so this is a reasonable value */
    caps->max_texel_buffer_elements = LP_MAX_TEXEL_BUFFER_ELEMENTS;
    caps->texture_buffer_offset_alignment = 16;
-   caps->texture_transfer_modes = 0;
+   /* Converting between textures and PBOs in fragment shaders runs on all
+    * the rasterizer threads and doesn't need to map either resource. It
+    * isn't tuned yet, so it's opt-in.
+    */
+   caps->texture_transfer_modes =
+      lscreen->num_threads && (LP_PERF & PERF_PBO_TRANSFER) ?
+      PIPE_TEXTURE_TRANSFER_PBO : 0;
    caps->max_viewports = PIPE_MAX_VIEWPORTS;
    caps->endianness = PIPE_ENDIAN_NATIVE;
    caps->tes_layer_viewport = true;
@@ -135,6 +135,12 @@ static bool r600_query_sw_begin(struct r600_common_context *rctx,
 	case R600_QUERY_TC_NUM_SYNCS:
 		query->begin_result = rctx->tc ? rctx->tc->num_syncs : 0;
 		break;
+	case R600_QUERY_TC_DIRECT_FLUSHES:
+		query->begin_result = rctx->tc ? rctx->tc->num_direct_flushes : 0;
+		break;
+	case R600_QUERY_TC_STALL_TIME:
+		query->begin_result = rctx->tc ? rctx->tc->stall_time_us : 0;
+		break;
 	case R600_QUERY_REQUESTED_VRAM:
 	case R600_QUERY_REQUESTED_GTT:
 	case R600_QUERY_MAPPED_VRAM:
@@ -287,6 +293,12 @@ static bool r600_query_sw_end(struct r600_common_context *rctx,
 	case R600_QUERY_TC_NUM_SYNCS:
 		query->end_result = rctx->tc ? rctx->tc->num_syncs : 0;
 		break;
+	case R600_QUERY_TC_DIRECT_FLUSHES:
+		query->end_result = rctx->tc ? rctx->tc->num_direct_flushes : 0;
+		break;
+	case R600_QUERY_TC_STALL_TIME:
+		query->end_result = rctx->tc ? rctx->tc->stall_time_us : 0;
+		break;
 	case R600_QUERY_REQUESTED_VRAM:
 	case R600_QUERY_REQUESTED_GTT:
 	case R600_QUERY_MAPPED_VRAM:
@@ -1947,6 +1959,8 @@ static const struct pipe_driver_query_info r600_driver_query_list[] = {
 	X("tc-offloaded-slots",		TC_OFFLOADED_SLOTS,     UINT64, AVERAGE),
 	X("tc-direct-slots",		TC_DIRECT_SLOTS,	UINT64, AVERAGE),
 	X("tc-num-syncs",		TC_NUM_SYNCS,		UINT64, AVERAGE),
+	X("tc-direct-flushes",	TC_DIRECT_FLUSHES,	UINT64, AVERAGE),
+	X("tc-stall-time",		TC_STALL_TIME,		MICROSECONDS, AVERAGE),
 	X("CS-thread-busy",		CS_THREAD_BUSY,		UINT64, AVERAGE),
 	X("gallium-thread-busy",	GALLIUM_THREAD_BUSY,	UINT64, AVERAGE),
 	X("requested-VRAM",		REQUESTED_VRAM,		BYTES, AVERAGE),
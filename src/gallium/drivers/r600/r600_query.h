@@ -39,6 +39,8 @@ enum {
 	R600_QUERY_TC_OFFLOADED_SLOTS,
 	R600_QUERY_TC_DIRECT_SLOTS,
 	R600_QUERY_TC_NUM_SYNCS,
+	R600_QUERY_TC_DIRECT_FLUSHES,
+	R600_QUERY_TC_STALL_TIME,
 	R600_QUERY_CS_THREAD_BUSY,
 	R600_QUERY_GALLIUM_THREAD_BUSY,
 	R600_QUERY_REQUESTED_VRAM,
@@ -259,6 +259,7 @@ softpipe_create_context(struct pipe_screen *screen,
    softpipe->pipe.stream_uploader = u_upload_create_default(&softpipe->pipe);
    if (!softpipe->pipe.stream_uploader)
       goto fail;
+   u_upload_enable_ring(softpipe->pipe.stream_uploader, 4);
    softpipe->pipe.const_uploader = softpipe->pipe.stream_uploader;
 
    /*
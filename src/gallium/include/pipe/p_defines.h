@@ -704,6 +704,8 @@ enum pipe_texture_transfer_mode {
    PIPE_TEXTURE_TRANSFER_DEFAULT = 0,
    PIPE_TEXTURE_TRANSFER_BLIT = (1 << 0),
    PIPE_TEXTURE_TRANSFER_COMPUTE = (1 << 1),
+   /* Only use the blit paths when the data is in a pixel buffer object. */
+   PIPE_TEXTURE_TRANSFER_PBO = (1 << 2),
 };
 
 /**
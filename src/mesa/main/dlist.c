@@ -59,7 +59,8 @@
 
 static bool
 _mesa_glthread_should_execute_list(struct gl_context *ctx,
-                                   struct gl_display_list *dlist);
+                                   struct gl_display_list *dlist,
+                                   bool *invalidates_glthread);
 
 /**
  * Flush vertices.
@@ -10841,6 +10842,34 @@ _mesa_get_list(struct gl_context *ctx, GLuint list,
 /**********************************************************************/
 
 
+/**
+ * Draw a run of vertex lists found by mark_vertex_list_runs and return
+ * the node following it.
+ */
+static Node *
+execute_vertex_list_run(struct gl_context *ctx, Node *n)
+{
+   const struct vbo_save_vertex_list *nodes[VBO_SAVE_MAX_RUN_LENGTH];
+   unsigned num_nodes = ((struct vbo_save_vertex_list *)n)->run_length;
+   bool copy_to_current = false;
+
+   for (unsigned i = 0; i < num_nodes; i++) {
+      assert(n[0].opcode == OPCODE_VERTEX_LIST ||
+             (n[0].opcode == OPCODE_VERTEX_LIST_COPY_CURRENT &&
+              i == num_nodes - 1));
+      nodes[i] = (struct vbo_save_vertex_list *)n;
+      copy_to_current = n[0].opcode == OPCODE_VERTEX_LIST_COPY_CURRENT;
+
+      n += n[0].InstSize;
+      if (n[0].opcode == OPCODE_CONTINUE)
+         n = (Node *)get_pointer(&n[1]);
+   }
+
+   vbo_save_playback_vertex_lists(ctx, nodes, num_nodes, copy_to_current);
+   return n;
+}
+
+
 /*
  * Execute a display list.  Note that the ListBase offset must have already
  * been added before calling this function.  I.e. the list argument is
@@ -13041,6 +13070,10 @@ execute_list(struct gl_context *ctx, GLuint list)
                                        n[5].f, n[6].f, n[7].f, n[8].f));
             break;
          case OPCODE_VERTEX_LIST:
+            if (((struct vbo_save_vertex_list *)n)->run_length) {
+               n = execute_vertex_list_run(ctx, n);
+               continue;
+            }
             vbo_save_playback_vertex_list(ctx, &n[0], false);
             break;
 
@@ -13316,6 +13349,59 @@ replace_op_vertex_list_recursively(struct gl_context *ctx, struct gl_display_lis
 }
 
 
+/**
+ * Find runs of consecutive vertex lists with the same enabled attribs, and
+ * record their length in the first vertex list of each run, so that
+ * execute_list can draw them after validating state only once.
+ */
+static void
+mark_vertex_list_runs(struct gl_context *ctx, struct gl_display_list *dlist)
+{
+   struct vbo_save_vertex_list *first = NULL;
+   bool copied_to_current = false;
+   Node *n = get_list_head(ctx, dlist);
+
+   while (true) {
+      const OpCode opcode = n[0].opcode;
+
+      if (opcode == OPCODE_CONTINUE) {
+         n = (Node *)get_pointer(&n[1]);
+         continue;
+      }
+
+      bool is_vertex_list = opcode == OPCODE_VERTEX_LIST ||
+                            opcode == OPCODE_VERTEX_LIST_COPY_CURRENT;
+      struct vbo_save_vertex_list *node = (struct vbo_save_vertex_list *)n;
+
+      /* Copying to the current attribs must be the last thing a run does. */
+      if (first &&
+          (!is_vertex_list || copied_to_current ||
+           first->run_length == VBO_SAVE_MAX_RUN_LENGTH ||
+           memcmp(node->enabled_attribs, first->enabled_attribs,
+                  sizeof(node->enabled_attribs)))) {
+         /* Single vertex lists are drawn as usual. */
+         if (first->run_length == 1)
+            first->run_length = 0;
+         first = NULL;
+      }
+
+      if (is_vertex_list) {
+         if (first) {
+            first->run_length++;
+         } else {
+            first = node;
+            first->run_length = 1;
+         }
+         copied_to_current = opcode == OPCODE_VERTEX_LIST_COPY_CURRENT;
+      }
+
+      if (opcode == OPCODE_END_OF_LIST)
+         break;
+      n += n[0].InstSize;
+   }
+}
+
+
 /**
  * End definition of current display list.
  */
@@ -13351,11 +13437,16 @@ _mesa_EndList(void)
 
    if (ctx->ListState.Current.UseLoopback)
       replace_op_vertex_list_recursively(ctx, ctx->ListState.CurrentList);
+   else
+      mark_vertex_list_runs(ctx, ctx->ListState.CurrentList);
 
    struct gl_dlist_state *list = &ctx->ListState;
+   bool invalidates_glthread;
    list->CurrentList->execute_glthread =
-      _mesa_glthread_should_execute_list(ctx, list->CurrentList);
+      _mesa_glthread_should_execute_list(ctx, list->CurrentList,
+                                         &invalidates_glthread);
    ctx->Shared->DisplayListsAffectGLThread |= list->CurrentList->execute_glthread;
+   ctx->Shared->DisplayListsInvalidateGLThread |= invalidates_glthread;
 
    if ((list->CurrentList->Head == list->CurrentBlock) &&
        (list->CurrentPos < BLOCK_SIZE)) {
@@ -13998,6 +14089,12 @@ _mesa_glthread_execute_list(struct gl_context *ctx, GLuint list)
          case OPCODE_MATRIX_POP:
             _mesa_glthread_MatrixPopEXT(ctx, n[1].e);
             break;
+         case OPCODE_DISABLE_INDEXED:
+            _mesa_glthread_Disablei(ctx, n[1].e, n[2].ui);
+            break;
+         case OPCODE_ENABLE_INDEXED:
+            _mesa_glthread_Enablei(ctx, n[1].e, n[2].ui);
+            break;
          case OPCODE_CONTINUE:
             n = (Node *)get_pointer(&n[1]);
             continue;
@@ -14015,11 +14112,19 @@ _mesa_glthread_execute_list(struct gl_context *ctx, GLuint list)
    }
 }
 
+/* Returns whether glthread has to replay the list to keep its state in sync.
+ * The texture bindings and the viewport aren't replayed, glCallList only
+ * invalidates them in glthread if *invalidates_glthread is set.
+ */
 static bool
 _mesa_glthread_should_execute_list(struct gl_context *ctx,
-                                   struct gl_display_list *dlist)
+                                   struct gl_display_list *dlist,
+                                   bool *invalidates_glthread)
 {
    Node *n = get_list_head(ctx, dlist);
+   bool execute = false;
+
+   *invalidates_glthread = false;
 
    while (1) {
       const OpCode opcode = n[0].opcode;
@@ -14038,12 +14143,23 @@ _mesa_glthread_should_execute_list(struct gl_context *ctx,
       case OPCODE_ACTIVE_TEXTURE:   /* GL_ARB_multitexture */
       case OPCODE_MATRIX_PUSH:
       case OPCODE_MATRIX_POP:
-         return true;
+      case OPCODE_DISABLE_INDEXED:
+      case OPCODE_ENABLE_INDEXED:
+         execute = true;
+         break;
+      case OPCODE_BIND_TEXTURE:
+      case OPCODE_BIND_MULTITEXTURE:
+      case OPCODE_VIEWPORT:
+      case OPCODE_VIEWPORT_ARRAY_V:
+      case OPCODE_VIEWPORT_INDEXED_F:
+      case OPCODE_VIEWPORT_INDEXED_FV:
+         *invalidates_glthread = true;
+         break;
       case OPCODE_CONTINUE:
          n = (Node *)get_pointer(&n[1]);
          continue;
       case OPCODE_END_OF_LIST:
-         return false;
+         return execute;
       default:
          /* ignore */
          break;
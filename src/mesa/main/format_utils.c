@@ -29,6 +29,12 @@
 #include "glformats.h"
 #include "format_pack.h"
 #include "format_unpack.h"
+#include "sse_swizzle.h"
+#include "c11/threads.h"
+#include "util/u_atomic.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_debug.h"
+#include "util/u_queue.h"
 
 const mesa_array_format RGBA32_FLOAT =
    MESA_ARRAY_FORMAT(MESA_ARRAY_FORMAT_BASE_FORMAT_RGBA_VARIANTS,
@@ -191,6 +197,72 @@ _mesa_compute_rgba2base2rgba_component_mapping(GLenum baseFormat, uint8_t *map)
 }
 
 
+/**
+ * Returns whether _mesa_swizzle_and_convert has an SSE4.1 or AVX2 path for
+ * a conversion. These are the conversions of RGBA8, BGRA8, RGB8 and float
+ * RGBA images most common in texture uploads and readbacks.
+ */
+static bool
+is_vectorized_conversion(enum mesa_array_format_datatype dst_type,
+                         int num_dst_channels,
+                         enum mesa_array_format_datatype src_type,
+                         int num_src_channels, bool normalized)
+{
+#if defined(USE_SSE41)
+   if (!util_get_cpu_caps()->has_sse4_1 || num_dst_channels != 4)
+      return false;
+
+   if (dst_type == MESA_ARRAY_FORMAT_TYPE_UBYTE &&
+       src_type == MESA_ARRAY_FORMAT_TYPE_UBYTE)
+      return num_src_channels >= 3;
+
+   return normalized && num_src_channels == 4 &&
+          ((dst_type == MESA_ARRAY_FORMAT_TYPE_UBYTE &&
+            src_type == MESA_ARRAY_FORMAT_TYPE_FLOAT) ||
+           (dst_type == MESA_ARRAY_FORMAT_TYPE_FLOAT &&
+            src_type == MESA_ARRAY_FORMAT_TYPE_UBYTE));
+#else
+   return false;
+#endif
+}
+
+/**
+ * Converts the pixels filling whole vectors for a conversion accepted by
+ * is_vectorized_conversion, and returns how many were converted.
+ */
+static int
+swizzle_convert_vectorized(void *dst, enum mesa_array_format_datatype dst_type,
+                           const void *src,
+                           enum mesa_array_format_datatype src_type,
+                           int num_src_channels, const uint8_t swizzle[4],
+                           bool normalized, int count)
+{
+   const uint8_t one = normalized ? UINT8_MAX : 1;
+
+#if defined(USE_AVX2)
+   if (util_get_cpu_caps()->has_avx2) {
+      if (src_type == dst_type)
+         return _mesa_swizzle_ubyte_avx2(dst, src, num_src_channels, swizzle,
+                                         one, count);
+      else if (dst_type == MESA_ARRAY_FORMAT_TYPE_UBYTE)
+         return _mesa_float_to_unorm8_avx2(dst, src, swizzle, count);
+      else
+         return _mesa_unorm8_to_float_avx2(dst, src, swizzle, count);
+   }
+#endif
+#if defined(USE_SSE41)
+   if (src_type == dst_type)
+      return _mesa_swizzle_ubyte_sse41(dst, src, num_src_channels, swizzle,
+                                       one, count);
+   else if (dst_type == MESA_ARRAY_FORMAT_TYPE_UBYTE)
+      return _mesa_float_to_unorm8_sse41(dst, src, swizzle, count);
+   else
+      return _mesa_unorm8_to_float_sse41(dst, src, swizzle, count);
+#else
+   return 0;
+#endif
+}
+
 /**
  * Special case conversion function to swap r/b channels from the source
  * image to the dest image.
@@ -202,6 +274,20 @@ convert_ubyte_rgba_to_bgra(size_t width, size_t height,
 {
    int row;
 
+   if (is_vectorized_conversion(MESA_ARRAY_FORMAT_TYPE_UBYTE, 4,
+                                MESA_ARRAY_FORMAT_TYPE_UBYTE, 4, true)) {
+      static const uint8_t rgba2bgra[4] = { 2, 1, 0, 3 };
+
+      for (row = 0; row < height; row++) {
+         _mesa_swizzle_and_convert(dst, MESA_ARRAY_FORMAT_TYPE_UBYTE, 4,
+                                   src, MESA_ARRAY_FORMAT_TYPE_UBYTE, 4,
+                                   rgba2bgra, true, width);
+         src += src_stride;
+         dst += dst_stride;
+      }
+      return;
+   }
+
    if (sizeof(void *) == 8 &&
        src_stride % 8 == 0 &&
        dst_stride % 8 == 0 &&
@@ -274,10 +360,10 @@ convert_ubyte_rgba_to_bgra(size_t width, size_t height,
  *                        the dst or the src -depending on whether we are doing
  *                        an upload or a download respectively- are the same).
  */
-void
-_mesa_format_convert(void *void_dst, uint32_t dst_format, size_t dst_stride,
-                     void *void_src, uint32_t src_format, size_t src_stride,
-                     size_t width, size_t height, uint8_t *rebase_swizzle)
+static void
+format_convert(void *void_dst, uint32_t dst_format, size_t dst_stride,
+               void *void_src, uint32_t src_format, size_t src_stride,
+               size_t width, size_t height, uint8_t *rebase_swizzle)
 {
    uint8_t *dst = (uint8_t *)void_dst;
    uint8_t *src = (uint8_t *)void_src;
@@ -312,6 +398,19 @@ _mesa_format_convert(void *void_dst, uint32_t dst_format, size_t dst_stride,
       dst_array_format = _mesa_format_to_array_format(dst_format);
    }
 
+   /* The vectorized conversions between array formats are faster than the
+    * pack and unpack functions.
+    */
+   bool vectorized =
+      src_array_format && dst_array_format &&
+      _mesa_array_format_is_normalized(src_array_format) ==
+      _mesa_array_format_is_normalized(dst_array_format) &&
+      is_vectorized_conversion(_mesa_array_format_get_datatype(dst_array_format),
+                               _mesa_array_format_get_num_channels(dst_array_format),
+                               _mesa_array_format_get_datatype(src_array_format),
+                               _mesa_array_format_get_num_channels(src_array_format),
+                               _mesa_array_format_is_normalized(src_array_format));
+
    /* First we see if we can implement the conversion with a direct pack
     * or unpack.
     *
@@ -338,7 +437,7 @@ _mesa_format_convert(void *void_dst, uint32_t dst_format, size_t dst_stride,
       }
 
       /* Handle the cases where we can directly unpack */
-      if (!src_format_is_mesa_array_format) {
+      if (!src_format_is_mesa_array_format && !vectorized) {
          if (dst_array_format == RGBA32_FLOAT) {
             for (row = 0; row < height; ++row) {
                _mesa_unpack_rgba_row(src_format, width,
@@ -377,7 +476,7 @@ _mesa_format_convert(void *void_dst, uint32_t dst_format, size_t dst_stride,
       }
 
       /* Handle the cases where we can directly pack */
-      if (!dst_format_is_mesa_array_format) {
+      if (!dst_format_is_mesa_array_format && !vectorized) {
          if (src_array_format == RGBA32_FLOAT) {
             for (row = 0; row < height; ++row) {
                _mesa_pack_float_rgba_row(dst_format, width,
@@ -666,6 +765,132 @@ _mesa_format_convert(void *void_dst, uint32_t dst_format, size_t dst_stride,
    }
 }
 
+/* Images with at least this many pixels per thread are converted in
+ * stripes on several threads, smaller ones don't amortize the job overhead.
+ */
+#define FORMAT_CONVERT_STRIPE_MIN_PIXELS (128 * 1024)
+#define FORMAT_CONVERT_MAX_STRIPES 16
+
+struct format_convert_job {
+   struct util_queue_fence fence;
+   int claimed;
+
+   void *dst;
+   uint32_t dst_format;
+   size_t dst_stride;
+   void *src;
+   uint32_t src_format;
+   size_t src_stride;
+   size_t width, height;
+   uint8_t *rebase_swizzle;
+};
+
+static struct util_queue format_convert_queue;
+static unsigned format_convert_max_stripes;
+static once_flag format_convert_queue_once = ONCE_FLAG_INIT;
+
+DEBUG_GET_ONCE_NUM_OPTION(pixel_transfer_threads, "MESA_PIXEL_TRANSFER_THREADS", 4)
+
+static void
+format_convert_queue_init(void)
+{
+   unsigned num_threads = CLAMP(debug_get_option_pixel_transfer_threads(),
+                                1, FORMAT_CONVERT_MAX_STRIPES);
+
+   num_threads = MIN2(num_threads, util_get_cpu_caps()->nr_cpus);
+
+   /* The calling thread converts a stripe too. */
+   if (num_threads > 1 &&
+       util_queue_init(&format_convert_queue, "pixconv", 32, num_threads - 1,
+                       UTIL_QUEUE_INIT_USE_SHARED_THREADS, NULL))
+      format_convert_max_stripes = num_threads;
+   else
+      format_convert_max_stripes = 1;
+}
+
+static void
+format_convert_job_run(struct format_convert_job *job)
+{
+   format_convert(job->dst, job->dst_format, job->dst_stride,
+                  job->src, job->src_format, job->src_stride,
+                  job->width, job->height, job->rebase_swizzle);
+}
+
+static void
+format_convert_job_execute(void *data, void *gdata, int thread_index)
+{
+   struct format_convert_job *job = data;
+
+   /* The thread that queued the job may have converted it already. */
+   if (!p_atomic_xchg(&job->claimed, 1))
+      format_convert_job_run(job);
+}
+
+/**
+ * Converts an image as described above for format_convert, splitting large
+ * images in stripes of rows converted on several threads.
+ */
+void
+_mesa_format_convert(void *void_dst, uint32_t dst_format, size_t dst_stride,
+                     void *void_src, uint32_t src_format, size_t src_stride,
+                     size_t width, size_t height, uint8_t *rebase_swizzle)
+{
+   struct format_convert_job jobs[FORMAT_CONVERT_MAX_STRIPES];
+   size_t num_stripes = width * height / FORMAT_CONVERT_STRIPE_MIN_PIXELS;
+
+   if (num_stripes > 1) {
+      call_once(&format_convert_queue_once, format_convert_queue_init);
+      num_stripes = MIN3(num_stripes, format_convert_max_stripes, height);
+   }
+
+   if (num_stripes <= 1) {
+      format_convert(void_dst, dst_format, dst_stride,
+                     void_src, src_format, src_stride,
+                     width, height, rebase_swizzle);
+      return;
+   }
+
+   size_t rows_per_stripe = DIV_ROUND_UP(height, num_stripes);
+   num_stripes = DIV_ROUND_UP(height, rows_per_stripe);
+
+   for (unsigned i = 0; i < num_stripes; i++) {
+      size_t row = i * rows_per_stripe;
+
+      jobs[i] = (struct format_convert_job) {
+         .dst = (uint8_t *)void_dst + row * dst_stride,
+         .dst_format = dst_format,
+         .dst_stride = dst_stride,
+         .src = (uint8_t *)void_src + row * src_stride,
+         .src_format = src_format,
+         .src_stride = src_stride,
+         .width = width,
+         .height = MIN2(rows_per_stripe, height - row),
+         .rebase_swizzle = rebase_swizzle,
+      };
+   }
+
+   for (unsigned i = 1; i < num_stripes; i++) {
+      util_queue_fence_init(&jobs[i].fence);
+      util_queue_add_job(&format_convert_queue, &jobs[i], &jobs[i].fence,
+                         format_convert_job_execute, NULL, 0);
+   }
+
+   format_convert_job_run(&jobs[0]);
+
+   /* Don't wait for busy threads, convert the stripes they haven't started,
+    * from the last one as they start from the first one.
+    */
+   for (unsigned i = num_stripes - 1; i > 0; i--) {
+      if (!p_atomic_xchg(&jobs[i].claimed, 1))
+         format_convert_job_run(&jobs[i]);
+   }
+
+   for (unsigned i = 1; i < num_stripes; i++) {
+      util_queue_drop_job(&format_convert_queue, &jobs[i].fence);
+      util_queue_fence_destroy(&jobs[i].fence);
+   }
+}
+
 /**
  * Attempts to perform the given swizzle-and-convert operation with memcpy
  *
@@ -1423,6 +1648,22 @@ _mesa_swizzle_and_convert(void *void_dst, enum mesa_array_format_datatype dst_ty
                                   swizzle, normalized, count))
       return;
 
+   if (is_vectorized_conversion(dst_type, num_dst_channels,
+                                src_type, num_src_channels, normalized)) {
+      int done = swizzle_convert_vectorized(void_dst, dst_type,
+                                            void_src, src_type,
+                                            num_src_channels, swizzle,
+                                            normalized, count);
+      if (done == count)
+         return;
+
+      void_dst = (uint8_t *)void_dst + done * num_dst_channels *
+                 _mesa_array_format_datatype_get_size(dst_type);
+      void_src = (const uint8_t *)void_src + done * num_src_channels *
+                 _mesa_array_format_datatype_get_size(src_type);
+      count -= done;
+   }
+
    switch (dst_type) {
    case MESA_ARRAY_FORMAT_TYPE_FLOAT:
       convert_float(void_dst, num_dst_channels, void_src, src_type,
@@ -32,12 +32,17 @@
  * thread.
  */
 
+#include <stdio.h>
+
 #include "main/mtypes.h"
+#include "main/enums.h"
 #include "main/glthread.h"
 #include "main/glthread_marshal.h"
 #include "main/hash.h"
 #include "main/pixelstore.h"
+#include "util/hash_table.h"
 #include "util/u_atomic.h"
+#include "util/u_debug.h"
 #include "util/u_thread.h"
 #include "util/u_cpu_detect.h"
 #include "util/thread_sched.h"
@@ -151,9 +156,8 @@ glthread_unmarshal_batch(void *job, void *gdata, int thread_index)
    assert(pos == used);
    batch->used = 0;
 
-   unsigned batch_index = batch - ctx->GLThread.batches;
-   _mesa_glthread_signal_call(&ctx->GLThread.LastProgramChangeBatch, batch_index);
-   _mesa_glthread_signal_call(&ctx->GLThread.LastDListChangeBatchIndex, batch_index);
+   _mesa_glthread_signal_call(&ctx->GLThread.LastProgramChangeBatch, batch->index);
+   _mesa_glthread_signal_call(&ctx->GLThread.LastDListChangeBatchIndex, batch->index);
 
    p_atomic_inc(&ctx->GLThread.stats.num_batches);
 }
@@ -193,6 +197,77 @@ glthread_thread_initialization(void *job, void *gdata, int thread_index)
    _mesa_glapi_set_context(ctx);
 }
 
+static bool
+glthread_alloc_batch(struct gl_context *ctx, unsigned index)
+{
+   struct glthread_batch *batch = malloc(sizeof(*batch));
+   if (!batch)
+      return false;
+
+   batch->ctx = ctx;
+   batch->index = index;
+   batch->used = 0;
+   util_queue_fence_init(&batch->fence);
+   ctx->GLThread.batches[index] = batch;
+   return true;
+}
+
+static void
+glthread_free_batches(struct glthread_state *glthread)
+{
+   for (unsigned i = 0; i < glthread->num_batches; i++) {
+      util_queue_fence_destroy(&glthread->batches[i]->fence);
+      free(glthread->batches[i]);
+      glthread->batches[i] = NULL;
+   }
+   glthread->num_batches = 0;
+}
+
+DEBUG_GET_ONCE_BOOL_OPTION(glthread_sync_stats, "MESA_GLTHREAD_SYNC_STATS", false)
+
+static int
+compare_sync_counts(const void *a, const void *b)
+{
+   const struct hash_entry *ea = *(const struct hash_entry **)a;
+   const struct hash_entry *eb = *(const struct hash_entry **)b;
+
+   return (uintptr_t)eb->data > (uintptr_t)ea->data ? 1 :
+          (uintptr_t)eb->data < (uintptr_t)ea->data ? -1 : 0;
+}
+
+static void
+print_sync_stats(struct hash_table *ht, const char *title, bool enums)
+{
+   struct hash_entry **entries = malloc(ht->entries * sizeof(*entries));
+   unsigned num = 0;
+
+   if (!entries)
+      return;
+
+   hash_table_foreach(ht, entry)
+      entries[num++] = entry;
+   qsort(entries, num, sizeof(*entries), compare_sync_counts);
+
+   fprintf(stderr, "glthread: synchronizations per %s:\n", title);
+   for (unsigned i = 0; i < num; i++) {
+      fprintf(stderr, "%10" PRIuPTR " %s\n", (uintptr_t)entries[i]->data,
+              enums ? _mesa_enum_to_string((uintptr_t)entries[i]->key) :
+                      (const char *)entries[i]->key);
+   }
+   free(entries);
+}
+
+static void
+count_sync(struct hash_table *ht, const void *key)
+{
+   struct hash_entry *entry = _mesa_hash_table_search(ht, key);
+
+   if (entry)
+      entry->data = (void *)((uintptr_t)entry->data + 1);
+   else
+      _mesa_hash_table_insert(ht, key, (void *)(uintptr_t)1);
+}
+
 static void
 _mesa_glthread_init_dispatch(struct gl_context *ctx,
                              struct _glapi_table *table)
@@ -227,8 +302,17 @@ _mesa_glthread_init(struct gl_context *ctx)
    _mesa_glthread_reset_vao(&glthread->DefaultVAO);
    glthread->CurrentVAO = &glthread->DefaultVAO;
 
+   for (unsigned i = 0; i < MARSHAL_MIN_BATCHES; i++) {
+      if (!glthread_alloc_batch(ctx, i))
+         break;
+      glthread->num_batches++;
+   }
+
    ctx->MarshalExec = _mesa_alloc_dispatch_table(true);
-   if (!ctx->MarshalExec) {
+   if (glthread->num_batches < MARSHAL_MIN_BATCHES || !ctx->MarshalExec) {
+      free(ctx->MarshalExec);
+      ctx->MarshalExec = NULL;
+      glthread_free_batches(glthread);
       _mesa_DeinitHashTable(&glthread->VAOs, NULL, NULL);
       util_queue_destroy(&glthread->queue);
       return;
@@ -237,17 +321,20 @@ _mesa_glthread_init(struct gl_context *ctx)
    _mesa_glthread_init_dispatch(ctx, ctx->MarshalExec);
    _mesa_init_pixelstore_attrib(ctx, &glthread->Unpack);
 
-   for (unsigned i = 0; i < MARSHAL_MAX_BATCHES; i++) {
-      glthread->batches[i].ctx = ctx;
-      util_queue_fence_init(&glthread->batches[i].fence);
-   }
-   glthread->next_batch = &glthread->batches[glthread->next];
+   glthread->next_batch = glthread->batches[glthread->next];
    glthread->used = 0;
+   /* The batch size that was used before it became adaptive. */
+   glthread->batch_limit = MARSHAL_MAX_CMD_SIZE / 8;
    glthread->stats.queue = &glthread->queue;
 
    _mesa_glthread_init_call_fence(&glthread->LastProgramChangeBatch);
    _mesa_glthread_init_call_fence(&glthread->LastDListChangeBatchIndex);
 
+   if (debug_get_option_glthread_sync_stats()) {
+      glthread->SyncStats = _mesa_string_hash_table_create(NULL);
+      glthread->GetSyncStats = _mesa_hash_table_create_u32_keys(NULL);
+   }
+
    _mesa_glthread_enable(ctx);
 
    /* Execute the thread initialization function in the thread. */
@@ -279,13 +366,43 @@ _mesa_glthread_destroy(struct gl_context *ctx)
 
    if (util_queue_is_initialized(&glthread->queue)) {
       util_queue_destroy(&glthread->queue);
-
-      for (unsigned i = 0; i < MARSHAL_MAX_BATCHES; i++)
-         util_queue_fence_destroy(&glthread->batches[i].fence);
+      glthread_free_batches(glthread);
 
       _mesa_DeinitHashTable(&glthread->VAOs, free_vao, NULL);
       _mesa_glthread_release_upload_buffer(ctx);
    }
+
+   if (glthread->SyncStats) {
+      print_sync_stats(glthread->SyncStats, "function", false);
+      print_sync_stats(glthread->GetSyncStats, "glGet pname", true);
+      _mesa_hash_table_destroy(glthread->SyncStats, NULL);
+      _mesa_hash_table_destroy(glthread->GetSyncStats, NULL);
+      glthread->SyncStats = NULL;
+      glthread->GetSyncStats = NULL;
+   }
+}
+
+/* Initialize the state shadowed by glthread from the context, which is
+ * idle while glthread is disabled. State that is only needed by queries
+ * is invalidated and read back by the first query instead.
+ */
+static void
+glthread_init_shadowed_state(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = &ctx->GLThread;
+
+   glthread->Blend = ctx->Color.BlendEnabled & 1;
+   glthread->CullFace = ctx->Polygon.CullFlag;
+   glthread->DepthTest = ctx->Depth.Test;
+   glthread->Dither = ctx->Color.DitherFlag;
+   glthread->Lighting = ctx->Light.Enabled;
+   glthread->PolygonOffsetFill = ctx->Polygon.OffsetFill;
+   glthread->PolygonStipple = ctx->Polygon.StippleFlag;
+   glthread->ScissorTest = ctx->Scissor.EnableFlags & 1;
+   glthread->StencilTest = ctx->Stencil.Enabled;
+
+   glthread->ViewportValid = false;
+   glthread->TextureBindingsValid = 0;
 }
 
 void _mesa_glthread_enable(struct gl_context *ctx)
@@ -295,6 +412,8 @@ void _mesa_glthread_enable(struct gl_context *ctx)
        ctx->GLThread.DebugOutputSynchronous)
       return;
 
+   glthread_init_shadowed_state(ctx);
+
    ctx->GLThread.enabled = true;
    ctx->GLApi = ctx->MarshalExec;
 
@@ -353,6 +472,69 @@ glthread_finalize_batch(struct glthread_state *glthread,
    glthread->LastBindBuffer2 = NULL;
 }
 
+/**
+ * Adapts the batch size to the relative speed of the application thread and
+ * the worker thread. If the worker thread is still busy with the previous
+ * batch, it's the bottleneck and larger batches reduce its per-batch
+ * overhead. If it's idle, it's waiting for us and smaller batches let it
+ * start sooner, and leave less to execute in the application thread at
+ * synchronization points.
+ *
+ * This looks at the fence instead of measuring the time spent by each
+ * thread, because os_time_get_nano() is too expensive to call per batch
+ * with some clock sources.
+ */
+static void
+glthread_update_batch_limit(struct glthread_state *glthread)
+{
+   struct glthread_batch *last = glthread->batches[glthread->last];
+
+   if (!util_queue_fence_is_signalled(&last->fence)) {
+      if (++glthread->batch_limit_trend < 4)
+         return;
+
+      glthread->batch_limit = MIN2(glthread->batch_limit * 2,
+                                   MARSHAL_MAX_CMD_BUFFER_SIZE / 8 - 1);
+   } else {
+      if (--glthread->batch_limit_trend > -4)
+         return;
+
+      glthread->batch_limit = MAX2(glthread->batch_limit / 2,
+                                   MARSHAL_MIN_BATCH_SIZE / 8);
+   }
+   glthread->batch_limit_trend = 0;
+}
+
+/**
+ * Returns the index of the batch following the next batch. The ring can
+ * only grow when it wraps around, so that the batches are always filled in
+ * the order in which they are freed.
+ */
+static unsigned
+glthread_next_batch_index(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = &ctx->GLThread;
+   unsigned index = glthread->next + 1;
+
+   if (index < glthread->num_batches)
+      return index;
+
+   if (glthread->grow_batches) {
+      unsigned num_batches = MIN2(glthread->num_batches * 2,
+                                  MARSHAL_MAX_BATCHES);
+
+      while (glthread->num_batches < num_batches &&
+             glthread_alloc_batch(ctx, glthread->num_batches))
+         glthread->num_batches++;
+
+      glthread->grow_batches = false;
+      if (index < glthread->num_batches)
+         return index;
+   }
+
+   return 0;
+}
+
 void
 _mesa_glthread_flush_batch(struct gl_context *ctx)
 {
@@ -369,6 +551,7 @@ _mesa_glthread_flush_batch(struct gl_context *ctx)
       return; /* the batch is empty */
 
    glthread_apply_thread_sched_policy(ctx, false);
+   glthread_update_batch_limit(glthread);
    glthread_finalize_batch(glthread, &glthread->stats.num_offloaded_items);
 
    struct glthread_batch *next = glthread->next_batch;
@@ -376,22 +559,36 @@ _mesa_glthread_flush_batch(struct gl_context *ctx)
    util_queue_add_job(&glthread->queue, next, &next->fence,
                       glthread_unmarshal_batch, NULL, 0);
    glthread->last = glthread->next;
-   glthread->next = (glthread->next + 1) % MARSHAL_MAX_BATCHES;
-   glthread->next_batch = &glthread->batches[glthread->next];
+   glthread->next = glthread_next_batch_index(ctx);
+   glthread->next_batch = glthread->batches[glthread->next];
+
+   /* Wait until the worker thread is done with the batch that we are going
+    * to fill next. If it happens, the ring is too small to absorb the bursts
+    * of calls, so grow it.
+    */
+   if (!util_queue_fence_is_signalled(&glthread->next_batch->fence)) {
+      int64_t start = os_time_get_nano();
+
+      util_queue_fence_wait(&glthread->next_batch->fence);
+      p_atomic_add(&glthread->stats.stall_time_us,
+                   (os_time_get_nano() - start) / 1000);
+      glthread->grow_batches = true;
+   }
 }
 
 /**
  * Waits for all pending batches have been unmarshaled.
  *
  * This can be used by the main thread to synchronize access to the context,
- * since the worker thread will be idle after this.
+ * since the worker thread will be idle after this. Returns whether it had to
+ * synchronize.
  */
-void
-_mesa_glthread_finish(struct gl_context *ctx)
+static bool
+glthread_finish(struct gl_context *ctx)
 {
    struct glthread_state *glthread = &ctx->GLThread;
    if (!glthread->enabled)
-      return;
+      return false;
 
    /* If this is called from the worker thread, then we've hit a path that
     * might be called from either the main thread or the worker (such as some
@@ -399,9 +596,9 @@ _mesa_glthread_finish(struct gl_context *ctx)
     * synchronize against ourself.
     */
    if (u_thread_is_self(glthread->queue.threads[0]))
-      return;
+      return false;
 
-   struct glthread_batch *last = &glthread->batches[glthread->last];
+   struct glthread_batch *last = glthread->batches[glthread->last];
    struct glthread_batch *next = glthread->next_batch;
    bool synced = false;
 
@@ -430,15 +627,35 @@ _mesa_glthread_finish(struct gl_context *ctx)
 
    if (synced)
       p_atomic_inc(&glthread->stats.num_syncs);
+   return synced;
+}
+
+void
+_mesa_glthread_finish(struct gl_context *ctx)
+{
+   glthread_finish(ctx);
 }
 
 void
 _mesa_glthread_finish_before(struct gl_context *ctx, const char *func)
 {
-   _mesa_glthread_finish(ctx);
+   if (glthread_finish(ctx))
+      p_atomic_inc(&ctx->GLThread.stats.num_call_syncs);
+
+   /* Set MESA_GLTHREAD_SYNC_STATS=1 to know where glthread syncs. */
+   if (ctx->GLThread.SyncStats)
+      count_sync(ctx->GLThread.SyncStats, func);
+}
+
+/* Same as _mesa_glthread_finish_before, but also counts the query. */
+void
+_mesa_glthread_finish_before_get(struct gl_context *ctx, const char *func,
+                                 GLenum pname)
+{
+   if (ctx->GLThread.GetSyncStats)
+      count_sync(ctx->GLThread.GetSyncStats, (void *)(uintptr_t)pname);
 
-   /* Uncomment this if you want to know where glthread syncs. */
-   /*printf("fallback to sync: %s\n", func);*/
+   _mesa_glthread_finish_before(ctx, func);
 }
 
 void
@@ -524,3 +741,67 @@ _mesa_glthread_PixelStorei(struct gl_context *ctx, GLenum pname, GLint param)
       break;
    }
 }
+
+void
+_mesa_glthread_BindTextures(struct gl_context *ctx, GLuint first,
+                            GLsizei count, const GLuint *textures)
+{
+   struct glthread_state *glthread = &ctx->GLThread;
+
+   if (count < 0 || first + count > ctx->Const.MaxCombinedTextureImageUnits)
+      return;
+
+   for (unsigned unit = first;
+        unit < MIN2(first + count, GLTHREAD_MAX_TEXTURE_UNITS); unit++) {
+      /* Non-zero names are bound to the target of the texture, which is
+       * unknown here.
+       */
+      if (!textures || !textures[unit - first]) {
+         memset(glthread->TextureBindings[unit], 0,
+                sizeof(glthread->TextureBindings[unit]));
+      } else {
+         glthread->TextureBindingsValid &= ~BITFIELD_BIT(unit);
+      }
+   }
+}
+
+void
+_mesa_glthread_BindTextureUnit(struct gl_context *ctx, GLuint unit,
+                               GLuint texture)
+{
+   struct glthread_state *glthread = &ctx->GLThread;
+
+   if (unit >= MIN2(ctx->Const.MaxCombinedTextureImageUnits,
+                    GLTHREAD_MAX_TEXTURE_UNITS))
+      return;
+
+   if (!texture) {
+      memset(glthread->TextureBindings[unit], 0,
+             sizeof(glthread->TextureBindings[unit]));
+   } else {
+      glthread->TextureBindingsValid &= ~BITFIELD_BIT(unit);
+   }
+}
+
+void
+_mesa_glthread_DeleteTextures(struct gl_context *ctx, GLsizei n,
+                              const GLuint *textures)
+{
+   struct glthread_state *glthread = &ctx->GLThread;
+
+   if (n < 0 || !textures)
+      return;
+
+   /* Deleted textures are unbound from all units. */
+   for (int i = 0; i < n; i++) {
+      if (!textures[i])
+         continue;
+
+      for (unsigned unit = 0; unit < GLTHREAD_MAX_TEXTURE_UNITS; unit++) {
+         for (unsigned t = 0; t < NUM_TEXTURE_TARGETS; t++) {
+            if (glthread->TextureBindings[unit][t] == textures[i])
+               glthread->TextureBindings[unit][t] = 0;
+         }
+      }
+   }
+}
@@ -24,39 +24,53 @@
 #ifndef _GLTHREAD_H
 #define _GLTHREAD_H
 
-/* The size of one batch and the maximum size of one call.
+/* The maximum size of one call. */
+#define MARSHAL_MAX_CMD_SIZE (8 * 1024 - 8)
+
+/* The capacity of one batch.
  *
- * This should be as low as possible, so that:
+ * Batches are flushed when they reach glthread_state::batch_limit, which
+ * adapts between MARSHAL_MIN_BATCH_SIZE and the capacity. Small batches are
+ * better when the worker thread is idle, so that:
  * - multiple synchronizations within a frame don't slow us down much
  * - a smaller number of calls per frame can still get decent parallelism
- * - the memory footprint of the queue is low, and with that comes a lower
- *   chance of experiencing CPU cache thrashing
- * but it should be high enough so that u_queue overhead remains negligible.
- */
-#define MARSHAL_MAX_CMD_BUFFER_SIZE (8 * 1024)
-
-/* We need to leave 1 slot at the end to insert the END marker for unmarshal
+ * while large batches are better when the worker thread is behind, so that
+ * the u_queue and per-batch overhead remains negligible.
+ *
+ * We need to leave 1 slot at the end to insert the END marker for unmarshal
  * calls that look ahead to know where the batch ends.
  */
-#define MARSHAL_MAX_CMD_SIZE (MARSHAL_MAX_CMD_BUFFER_SIZE - 8)
+#define MARSHAL_MAX_CMD_BUFFER_SIZE (16 * 1024)
+#define MARSHAL_MIN_BATCH_SIZE (2 * 1024)
 
 /* The number of batch slots in memory.
  *
  * One batch is being executed, one batch is being filled, the rest are
  * waiting batches. There must be at least 1 slot for a waiting batch,
  * so the minimum number of batches is 3.
+ *
+ * The ring starts with MARSHAL_MIN_BATCHES and grows up to
+ * MARSHAL_MAX_BATCHES when the application thread has to wait for a free
+ * batch.
  */
-#define MARSHAL_MAX_BATCHES 8
+#define MARSHAL_MIN_BATCHES 8
+#define MARSHAL_MAX_BATCHES 32
 
 /* Special value for glEnableClientState(GL_PRIMITIVE_RESTART_NV). */
 #define VERT_ATTRIB_PRIMITIVE_RESTART_NV -1
 
+/* The number of texture units whose bindings are tracked. Queries for other
+ * units synchronize.
+ */
+#define GLTHREAD_MAX_TEXTURE_UNITS 32
+
 #include <inttypes.h>
 #include <stdbool.h>
 #include "util/u_queue.h"
 #include "compiler/shader_enums.h"
 #include "main/config.h"
 #include "main/hash.h"
+#include "main/menums.h"
 #include "util/glheader.h"
 
 #ifdef __cplusplus
@@ -148,6 +162,9 @@ struct glthread_batch
    /** The worker thread will access the context with this. */
    struct gl_context *ctx;
 
+   /** The index of the batch in glthread_state::batches. */
+   unsigned index;
+
    /**
     * Number of uint64_t elements filled already.
     * This is 0 when it's being filled because glthread::used holds the real
@@ -180,8 +197,14 @@ struct glthread_attrib_node {
    bool Blend;
    bool CullFace;
    bool DepthTest;
+   bool Dither;
    bool Lighting;
+   bool PolygonOffsetFill;
    bool PolygonStipple;
+   bool ScissorTest;
+   bool StencilTest;
+   GLfloat Viewport[4];
+   bool ViewportValid;
 };
 
 typedef enum {
@@ -208,6 +231,9 @@ struct glthread_state
    bool inside_begin_end;
    bool thread_sched_enabled;
 
+   /** Whether to grow the ring of batches when it wraps around. */
+   bool grow_batches;
+
    /** Display lists. */
    GLenum16 ListMode; /**< Zero if not inside display list, else list mode. */
    unsigned ListBase;
@@ -217,8 +243,9 @@ struct glthread_state
    unsigned pin_thread_counter;
    unsigned thread_sched_state;
 
-   /** The ring of batches in memory. */
-   struct glthread_batch batches[MARSHAL_MAX_BATCHES];
+   /** The ring of batches in memory, num_batches of them are allocated. */
+   struct glthread_batch *batches[MARSHAL_MAX_BATCHES];
+   unsigned num_batches;
 
    /** Pointer to the batch currently being filled. */
    struct glthread_batch *next_batch;
@@ -232,6 +259,15 @@ struct glthread_state
    /** Number of uint64_t elements filled already. */
    unsigned used;
 
+   /** Number of uint64_t elements after which the batch is flushed. */
+   unsigned batch_limit;
+
+   /**
+    * Positive if the worker thread was busy at the last flushes, negative
+    * if it was idle. The batch limit changes when it saturates.
+    */
+   int batch_limit_trend;
+
    /** Upload buffer. */
    struct gl_buffer_object *upload_buffer;
    uint8_t *upload_ptr;
@@ -286,8 +322,26 @@ struct glthread_state
    bool DepthTest;
    bool CullFace;
    bool DebugOutputSynchronous;
+   bool Dither;
    bool Lighting;
+   bool PolygonOffsetFill;
    bool PolygonStipple;
+   bool ScissorTest;
+   bool StencilTest;
+
+   /**
+    * Viewport 0 as set by glViewport. Other ways of setting it invalidate
+    * it, and glGet synchronizes once to read it back.
+    */
+   GLfloat Viewport[4];
+   bool ViewportValid;
+
+   /**
+    * Texture names bound to each target of the first texture units, valid
+    * for the units set in TextureBindingsValid.
+    */
+   GLuint TextureBindings[GLTHREAD_MAX_TEXTURE_UNITS][NUM_TEXTURE_TARGETS];
+   uint32_t TextureBindingsValid;
 
    GLuint CurrentDrawFramebuffer;
    GLuint CurrentReadFramebuffer;
@@ -303,6 +357,13 @@ struct glthread_state
    bool LockGlobalMutexes;
 
    struct gl_pixelstore_attrib Unpack;
+
+   /**
+    * Number of syncs per function and per glGet pname for
+    * MESA_GLTHREAD_SYNC_STATS, or NULL if disabled.
+    */
+   struct hash_table *SyncStats;
+   struct hash_table *GetSyncStats;
 };
 
 void _mesa_glthread_init(struct gl_context *ctx);
@@ -330,6 +391,8 @@ void _mesa_glthread_disable(struct gl_context *ctx);
 void _mesa_glthread_flush_batch(struct gl_context *ctx);
 void _mesa_glthread_finish(struct gl_context *ctx);
 void _mesa_glthread_finish_before(struct gl_context *ctx, const char *func);
+void _mesa_glthread_finish_before_get(struct gl_context *ctx, const char *func,
+                                      GLenum pname);
 bool _mesa_glthread_invalidate_zsbuf(struct gl_context *ctx);
 void _mesa_glthread_release_upload_buffer(struct gl_context *ctx);
 void _mesa_glthread_upload(struct gl_context *ctx, const void *data,
@@ -404,6 +467,12 @@ void _mesa_glthread_UnrollDrawElements(struct gl_context *ctx,
 void _mesa_glthread_unbind_uploaded_vbos(struct gl_context *ctx);
 void _mesa_glthread_PixelStorei(struct gl_context *ctx, GLenum pname,
                                 GLint param);
+void _mesa_glthread_BindTextures(struct gl_context *ctx, GLuint first,
+                                 GLsizei count, const GLuint *textures);
+void _mesa_glthread_BindTextureUnit(struct gl_context *ctx, GLuint unit,
+                                    GLuint texture);
+void _mesa_glthread_DeleteTextures(struct gl_context *ctx, GLsizei n,
+                                   const GLuint *textures);
 
 #ifdef __cplusplus
 }
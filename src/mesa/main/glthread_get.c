@@ -24,6 +24,22 @@
 #include "main/glthread_marshal.h"
 #include "dispatch.h"
 
+uint32_t
+_mesa_unmarshal_GetBooleanv(struct gl_context *ctx,
+                            const struct marshal_cmd_GetBooleanv *restrict cmd)
+{
+   unreachable("never executed");
+   return 0;
+}
+
+uint32_t
+_mesa_unmarshal_GetFloatv(struct gl_context *ctx,
+                          const struct marshal_cmd_GetFloatv *restrict cmd)
+{
+   unreachable("never executed");
+   return 0;
+}
+
 uint32_t
 _mesa_unmarshal_GetIntegerv(struct gl_context *ctx,
                             const struct marshal_cmd_GetIntegerv *restrict cmd)
@@ -32,15 +48,29 @@ _mesa_unmarshal_GetIntegerv(struct gl_context *ctx,
    return 0;
 }
 
-void GLAPIENTRY
-_mesa_marshal_GetIntegerv(GLenum pname, GLint *p)
+static bool
+get_texture_binding(struct gl_context *ctx, GLenum target, GLint *p)
 {
-   GET_CURRENT_CONTEXT(ctx);
+   struct glthread_state *glthread = &ctx->GLThread;
+   unsigned unit = glthread->ActiveTexture;
 
-   /* This will generate GL_INVALID_OPERATION, as it should. */
-   if (ctx->GLThread.inside_begin_end)
-      goto sync;
+   /* Unsupported targets synchronize to get the error. */
+   int index = _mesa_tex_target_to_index(ctx, target);
+
+   if (index < 0 || unit >= GLTHREAD_MAX_TEXTURE_UNITS ||
+       !(glthread->TextureBindingsValid & BITFIELD_BIT(unit)))
+      return false;
+
+   *p = glthread->TextureBindings[unit][index];
+   return true;
+}
 
+/* Return whether glthread knows the value of pname, which must be a single
+ * value.
+ */
+static bool
+get_integer(struct gl_context *ctx, GLenum pname, GLint *p)
+{
    /* TODO: Use get_hash_params.py to return values for items containing:
     * - CONST(
     * - CONTEXT_[A-Z]*(Const
@@ -49,90 +79,276 @@ _mesa_marshal_GetIntegerv(GLenum pname, GLint *p)
    switch (pname) {
    case GL_ACTIVE_TEXTURE:
       *p = GL_TEXTURE0 + ctx->GLThread.ActiveTexture;
-      return;
+      return true;
    case GL_ARRAY_BUFFER_BINDING:
       *p = ctx->GLThread.CurrentArrayBufferName;
-      return;
+      return true;
    case GL_ATTRIB_STACK_DEPTH:
       *p = ctx->GLThread.AttribStackDepth;
-      return;
+      return true;
    case GL_CLIENT_ACTIVE_TEXTURE:
       *p = GL_TEXTURE0 + ctx->GLThread.ClientActiveTexture;
-      return;
+      return true;
    case GL_CLIENT_ATTRIB_STACK_DEPTH:
       *p = ctx->GLThread.ClientAttribStackTop;
-      return;
+      return true;
    case GL_CURRENT_PROGRAM:
       *p = ctx->GLThread.CurrentProgram;
-      return;
+      return true;
    case GL_DRAW_INDIRECT_BUFFER_BINDING:
       *p = ctx->GLThread.CurrentDrawIndirectBufferName;
-      return;
+      return true;
    case GL_DRAW_FRAMEBUFFER_BINDING:
       *p = ctx->GLThread.CurrentDrawFramebuffer;
-      return;
+      return true;
    case GL_READ_FRAMEBUFFER_BINDING:
       *p = ctx->GLThread.CurrentReadFramebuffer;
-      return;
+      return true;
    case GL_PIXEL_PACK_BUFFER_BINDING:
       *p = ctx->GLThread.CurrentPixelPackBufferName;
-      return;
+      return true;
    case GL_PIXEL_UNPACK_BUFFER_BINDING:
       *p = ctx->GLThread.CurrentPixelUnpackBufferName;
-      return;
+      return true;
    case GL_QUERY_BUFFER_BINDING:
       *p = ctx->GLThread.CurrentQueryBufferName;
-      return;
+      return true;
 
    case GL_MATRIX_MODE:
       *p = ctx->GLThread.MatrixMode;
-      return;
+      return true;
    case GL_CURRENT_MATRIX_STACK_DEPTH_ARB:
       *p = ctx->GLThread.MatrixStackDepth[ctx->GLThread.MatrixIndex] + 1;
-      return;
+      return true;
    case GL_MODELVIEW_STACK_DEPTH:
       *p = ctx->GLThread.MatrixStackDepth[M_MODELVIEW] + 1;
-      return;
+      return true;
    case GL_PROJECTION_STACK_DEPTH:
       *p = ctx->GLThread.MatrixStackDepth[M_PROJECTION] + 1;
-      return;
+      return true;
    case GL_TEXTURE_STACK_DEPTH:
       *p = ctx->GLThread.MatrixStackDepth[M_TEXTURE0 + ctx->GLThread.ActiveTexture] + 1;
-      return;
+      return true;
 
    case GL_VERTEX_ARRAY:
       *p = (ctx->GLThread.CurrentVAO->UserEnabled & (1 << VERT_ATTRIB_POS)) != 0;
-      return;
+      return true;
    case GL_NORMAL_ARRAY:
       *p = (ctx->GLThread.CurrentVAO->UserEnabled & (1 << VERT_ATTRIB_NORMAL)) != 0;
-      return;
+      return true;
    case GL_COLOR_ARRAY:
       *p = (ctx->GLThread.CurrentVAO->UserEnabled & (1 << VERT_ATTRIB_COLOR0)) != 0;
-      return;
+      return true;
    case GL_SECONDARY_COLOR_ARRAY:
       *p = (ctx->GLThread.CurrentVAO->UserEnabled & (1 << VERT_ATTRIB_COLOR1)) != 0;
-      return;
+      return true;
    case GL_FOG_COORD_ARRAY:
       *p = (ctx->GLThread.CurrentVAO->UserEnabled & (1 << VERT_ATTRIB_FOG)) != 0;
-      return;
+      return true;
    case GL_INDEX_ARRAY:
       *p = (ctx->GLThread.CurrentVAO->UserEnabled & (1 << VERT_ATTRIB_COLOR_INDEX)) != 0;
-      return;
+      return true;
    case GL_EDGE_FLAG_ARRAY:
       *p = (ctx->GLThread.CurrentVAO->UserEnabled & (1 << VERT_ATTRIB_EDGEFLAG)) != 0;
-      return;
+      return true;
    case GL_TEXTURE_COORD_ARRAY:
       *p = (ctx->GLThread.CurrentVAO->UserEnabled &
             (1 << (VERT_ATTRIB_TEX0 + ctx->GLThread.ClientActiveTexture))) != 0;
-      return;
+      return true;
    case GL_POINT_SIZE_ARRAY_OES:
       *p = (ctx->GLThread.CurrentVAO->UserEnabled & (1 << VERT_ATTRIB_POINT_SIZE)) != 0;
+      return true;
+
+   case GL_VERTEX_ARRAY_BINDING:
+      *p = ctx->GLThread.CurrentVAO->Name;
+      return true;
+   case GL_ELEMENT_ARRAY_BUFFER_BINDING:
+      *p = ctx->GLThread.CurrentVAO->CurrentElementBufferName;
+      return true;
+
+   case GL_BLEND:
+      *p = ctx->GLThread.Blend;
+      return true;
+   case GL_CULL_FACE:
+      *p = ctx->GLThread.CullFace;
+      return true;
+   case GL_DEPTH_TEST:
+      *p = ctx->GLThread.DepthTest;
+      return true;
+   case GL_DITHER:
+      *p = ctx->GLThread.Dither;
+      return true;
+   case GL_POLYGON_OFFSET_FILL:
+      *p = ctx->GLThread.PolygonOffsetFill;
+      return true;
+   case GL_SCISSOR_TEST:
+      *p = ctx->GLThread.ScissorTest;
+      return true;
+   case GL_STENCIL_TEST:
+      *p = ctx->GLThread.StencilTest;
+      return true;
+
+   case GL_TEXTURE_BINDING_1D:
+      return get_texture_binding(ctx, GL_TEXTURE_1D, p);
+   case GL_TEXTURE_BINDING_2D:
+      return get_texture_binding(ctx, GL_TEXTURE_2D, p);
+   case GL_TEXTURE_BINDING_3D:
+      return get_texture_binding(ctx, GL_TEXTURE_3D, p);
+   case GL_TEXTURE_BINDING_CUBE_MAP:
+      return get_texture_binding(ctx, GL_TEXTURE_CUBE_MAP, p);
+   case GL_TEXTURE_BINDING_RECTANGLE:
+      return get_texture_binding(ctx, GL_TEXTURE_RECTANGLE, p);
+   case GL_TEXTURE_BINDING_1D_ARRAY:
+      return get_texture_binding(ctx, GL_TEXTURE_1D_ARRAY, p);
+   case GL_TEXTURE_BINDING_2D_ARRAY:
+      return get_texture_binding(ctx, GL_TEXTURE_2D_ARRAY, p);
+   case GL_TEXTURE_BINDING_BUFFER:
+      return get_texture_binding(ctx, GL_TEXTURE_BUFFER, p);
+   case GL_TEXTURE_BINDING_EXTERNAL_OES:
+      return get_texture_binding(ctx, GL_TEXTURE_EXTERNAL_OES, p);
+   case GL_TEXTURE_BINDING_CUBE_MAP_ARRAY:
+      return get_texture_binding(ctx, GL_TEXTURE_CUBE_MAP_ARRAY, p);
+   case GL_TEXTURE_BINDING_2D_MULTISAMPLE:
+      return get_texture_binding(ctx, GL_TEXTURE_2D_MULTISAMPLE, p);
+   case GL_TEXTURE_BINDING_2D_MULTISAMPLE_ARRAY:
+      return get_texture_binding(ctx, GL_TEXTURE_2D_MULTISAMPLE_ARRAY, p);
+   }
+
+   return false;
+}
+
+static bool
+get_viewport(struct gl_context *ctx, GLfloat *v)
+{
+   if (!ctx->GLThread.ViewportValid)
+      return false;
+
+   memcpy(v, ctx->GLThread.Viewport, sizeof(ctx->GLThread.Viewport));
+   return true;
+}
+
+/* Read back state that glthread doesn't know after a synchronous query, so
+ * that the next query doesn't have to synchronize.
+ */
+static void
+update_shadowed_state(struct gl_context *ctx, GLenum pname)
+{
+   struct glthread_state *glthread = &ctx->GLThread;
+
+   switch (pname) {
+   case GL_VIEWPORT:
+      if (ctx->ViewportInitialized) {
+         glthread->Viewport[0] = ctx->ViewportArray[0].X;
+         glthread->Viewport[1] = ctx->ViewportArray[0].Y;
+         glthread->Viewport[2] = ctx->ViewportArray[0].Width;
+         glthread->Viewport[3] = ctx->ViewportArray[0].Height;
+         glthread->ViewportValid = true;
+      }
+      break;
+
+   case GL_TEXTURE_BINDING_1D:
+   case GL_TEXTURE_BINDING_2D:
+   case GL_TEXTURE_BINDING_3D:
+   case GL_TEXTURE_BINDING_CUBE_MAP:
+   case GL_TEXTURE_BINDING_RECTANGLE:
+   case GL_TEXTURE_BINDING_1D_ARRAY:
+   case GL_TEXTURE_BINDING_2D_ARRAY:
+   case GL_TEXTURE_BINDING_BUFFER:
+   case GL_TEXTURE_BINDING_EXTERNAL_OES:
+   case GL_TEXTURE_BINDING_CUBE_MAP_ARRAY:
+   case GL_TEXTURE_BINDING_2D_MULTISAMPLE:
+   case GL_TEXTURE_BINDING_2D_MULTISAMPLE_ARRAY: {
+      unsigned unit = ctx->Texture.CurrentUnit;
+
+      /* The unit tracked by glthread differs after invalid glActiveTexture. */
+      if (unit != glthread->ActiveTexture ||
+          unit >= GLTHREAD_MAX_TEXTURE_UNITS)
+         break;
+
+      for (unsigned t = 0; t < NUM_TEXTURE_TARGETS; t++) {
+         glthread->TextureBindings[unit][t] =
+            ctx->Texture.Unit[unit].CurrentTex[t]->Name;
+      }
+      glthread->TextureBindingsValid |= BITFIELD_BIT(unit);
+      break;
+   }
+   }
+}
+
+void GLAPIENTRY
+_mesa_marshal_GetBooleanv(GLenum pname, GLboolean *p)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   GLfloat v[4];
+   GLint i;
+
+   /* This will generate GL_INVALID_OPERATION, as it should. */
+   if (ctx->GLThread.inside_begin_end)
+      goto sync;
+
+   if (pname == GL_VIEWPORT) {
+      if (get_viewport(ctx, v)) {
+         for (unsigned j = 0; j < 4; j++)
+            p[j] = v[j] ? GL_TRUE : GL_FALSE;
+         return;
+      }
+   } else if (get_integer(ctx, pname, &i)) {
+      *p = i ? GL_TRUE : GL_FALSE;
       return;
    }
 
 sync:
-   _mesa_glthread_finish_before(ctx, "GetIntegerv");
-   CALL_GetIntegerv(ctx->Dispatch.Current, (pname, p));
+   _mesa_glthread_finish_before_get(ctx, "GetBooleanv", pname);
+   CALL_GetBooleanv(ctx->Dispatch.Current, (pname, p));
+   update_shadowed_state(ctx, pname);
+}
+
+void GLAPIENTRY
+_mesa_marshal_GetFloatv(GLenum pname, GLfloat *p)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   GLint i;
+
+   /* This will generate GL_INVALID_OPERATION, as it should. */
+   if (ctx->GLThread.inside_begin_end)
+      goto sync;
+
+   if (pname == GL_VIEWPORT) {
+      if (get_viewport(ctx, p))
+         return;
+   } else if (get_integer(ctx, pname, &i)) {
+      *p = i;
+      return;
+   }
+
+sync:
+   _mesa_glthread_finish_before_get(ctx, "GetFloatv", pname);
+   CALL_GetFloatv(ctx->Dispatch.Current, (pname, p));
+   update_shadowed_state(ctx, pname);
 }
 
-/* TODO: Implement glGetBooleanv, glGetFloatv, etc. if needed */
+void GLAPIENTRY
+_mesa_marshal_GetIntegerv(GLenum pname, GLint *p)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   GLfloat v[4];
+
+   /* This will generate GL_INVALID_OPERATION, as it should. */
+   if (ctx->GLThread.inside_begin_end)
+      goto sync;
+
+   if (pname == GL_VIEWPORT) {
+      if (get_viewport(ctx, v)) {
+         for (unsigned j = 0; j < 4; j++)
+            p[j] = lroundf(v[j]);
+         return;
+      }
+   } else if (get_integer(ctx, pname, p)) {
+      return;
+   }
+
+sync:
+   _mesa_glthread_finish_before_get(ctx, "GetIntegerv", pname);
+   CALL_GetIntegerv(ctx->Dispatch.Current, (pname, p));
+   update_shadowed_state(ctx, pname);
+}
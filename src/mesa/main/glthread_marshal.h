@@ -34,6 +34,8 @@
 #include "main/context.h"
 #include "main/macros.h"
 #include "main/matrix.h"
+#include "main/texobj.h"
+#include "main/viewport.h"
 
 /* 32-bit signed integer clamped to 0..UINT16_MAX to compress parameters
  * for glthread. All values < 0 and >= UINT16_MAX are expected to throw
@@ -98,7 +100,7 @@ _mesa_glthread_allocate_command(struct gl_context *ctx,
 
    assert (num_elements <= MARSHAL_MAX_CMD_SIZE / 8);
 
-   if (unlikely(glthread->used + num_elements > MARSHAL_MAX_CMD_SIZE / 8))
+   if (unlikely(glthread->used + num_elements > glthread->batch_limit))
       _mesa_glthread_flush_batch(ctx);
 
    struct glthread_batch *next = glthread->next_batch;
@@ -477,12 +479,24 @@ _mesa_glthread_Enable(struct gl_context *ctx, GLenum cap)
    case GL_CULL_FACE:
       ctx->GLThread.CullFace = true;
       break;
+   case GL_DITHER:
+      ctx->GLThread.Dither = true;
+      break;
    case GL_LIGHTING:
       ctx->GLThread.Lighting = true;
       break;
+   case GL_POLYGON_OFFSET_FILL:
+      ctx->GLThread.PolygonOffsetFill = true;
+      break;
    case GL_POLYGON_STIPPLE:
       ctx->GLThread.PolygonStipple = true;
       break;
+   case GL_SCISSOR_TEST:
+      ctx->GLThread.ScissorTest = true;
+      break;
+   case GL_STENCIL_TEST:
+      ctx->GLThread.StencilTest = true;
+      break;
    case GL_VERTEX_ARRAY:
    case GL_NORMAL_ARRAY:
    case GL_COLOR_ARRAY:
@@ -522,12 +536,24 @@ _mesa_glthread_Disable(struct gl_context *ctx, GLenum cap)
    case GL_DEPTH_TEST:
       ctx->GLThread.DepthTest = false;
       break;
+   case GL_DITHER:
+      ctx->GLThread.Dither = false;
+      break;
    case GL_LIGHTING:
       ctx->GLThread.Lighting = false;
       break;
+   case GL_POLYGON_OFFSET_FILL:
+      ctx->GLThread.PolygonOffsetFill = false;
+      break;
    case GL_POLYGON_STIPPLE:
       ctx->GLThread.PolygonStipple = false;
       break;
+   case GL_SCISSOR_TEST:
+      ctx->GLThread.ScissorTest = false;
+      break;
+   case GL_STENCIL_TEST:
+      ctx->GLThread.StencilTest = false;
+      break;
    case GL_VERTEX_ARRAY:
    case GL_NORMAL_ARRAY:
    case GL_COLOR_ARRAY:
@@ -543,6 +569,21 @@ _mesa_glthread_Disable(struct gl_context *ctx, GLenum cap)
    }
 }
 
+/* Only index 0 of indexed enables is visible through glIsEnabled and glGet. */
+static inline void
+_mesa_glthread_Enablei(struct gl_context *ctx, GLenum cap, GLuint index)
+{
+   if (index == 0 && (cap == GL_BLEND || cap == GL_SCISSOR_TEST))
+      _mesa_glthread_Enable(ctx, cap);
+}
+
+static inline void
+_mesa_glthread_Disablei(struct gl_context *ctx, GLenum cap, GLuint index)
+{
+   if (index == 0 && (cap == GL_BLEND || cap == GL_SCISSOR_TEST))
+      _mesa_glthread_Disable(ctx, cap);
+}
+
 static inline int
 _mesa_glthread_IsEnabled(struct gl_context *ctx, GLenum cap)
 {
@@ -559,10 +600,18 @@ _mesa_glthread_IsEnabled(struct gl_context *ctx, GLenum cap)
       return ctx->GLThread.DebugOutputSynchronous;
    case GL_DEPTH_TEST:
       return ctx->GLThread.DepthTest;
+   case GL_DITHER:
+      return ctx->GLThread.Dither;
    case GL_LIGHTING:
       return ctx->GLThread.Lighting;
+   case GL_POLYGON_OFFSET_FILL:
+      return ctx->GLThread.PolygonOffsetFill;
    case GL_POLYGON_STIPPLE:
       return ctx->GLThread.PolygonStipple;
+   case GL_SCISSOR_TEST:
+      return ctx->GLThread.ScissorTest;
+   case GL_STENCIL_TEST:
+      return ctx->GLThread.StencilTest;
    case GL_VERTEX_ARRAY:
       return !!(ctx->GLThread.CurrentVAO->UserEnabled & VERT_BIT_POS);
    case GL_NORMAL_ARRAY:
@@ -591,11 +640,14 @@ _mesa_glthread_PushAttrib(struct gl_context *ctx, GLbitfield mask)
 
    attr->Mask = mask;
 
-   if (mask & GL_ENABLE_BIT)
+   if (mask & (GL_COLOR_BUFFER_BIT | GL_ENABLE_BIT)) {
       attr->Blend = ctx->GLThread.Blend;
+      attr->Dither = ctx->GLThread.Dither;
+   }
 
    if (mask & (GL_POLYGON_BIT | GL_ENABLE_BIT)) {
       attr->CullFace = ctx->GLThread.CullFace;
+      attr->PolygonOffsetFill = ctx->GLThread.PolygonOffsetFill;
       attr->PolygonStipple = ctx->GLThread.PolygonStipple;
    }
 
@@ -605,9 +657,20 @@ _mesa_glthread_PushAttrib(struct gl_context *ctx, GLbitfield mask)
    if (mask & (GL_LIGHTING_BIT | GL_ENABLE_BIT))
       attr->Lighting = ctx->GLThread.Lighting;
 
+   if (mask & (GL_SCISSOR_BIT | GL_ENABLE_BIT))
+      attr->ScissorTest = ctx->GLThread.ScissorTest;
+
+   if (mask & (GL_STENCIL_BUFFER_BIT | GL_ENABLE_BIT))
+      attr->StencilTest = ctx->GLThread.StencilTest;
+
    if (mask & GL_TEXTURE_BIT)
       attr->ActiveTexture = ctx->GLThread.ActiveTexture;
 
+   if (mask & GL_VIEWPORT_BIT) {
+      memcpy(attr->Viewport, ctx->GLThread.Viewport, sizeof(attr->Viewport));
+      attr->ViewportValid = ctx->GLThread.ViewportValid;
+   }
+
    if (mask & GL_TRANSFORM_BIT)
       attr->MatrixMode = ctx->GLThread.MatrixMode;
 }
@@ -625,11 +688,14 @@ _mesa_glthread_PopAttrib(struct gl_context *ctx)
       &ctx->GLThread.AttribStack[--ctx->GLThread.AttribStackDepth];
    unsigned mask = attr->Mask;
 
-   if (mask & GL_ENABLE_BIT)
+   if (mask & (GL_COLOR_BUFFER_BIT | GL_ENABLE_BIT)) {
       ctx->GLThread.Blend = attr->Blend;
+      ctx->GLThread.Dither = attr->Dither;
+   }
 
    if (mask & (GL_POLYGON_BIT | GL_ENABLE_BIT)) {
       ctx->GLThread.CullFace = attr->CullFace;
+      ctx->GLThread.PolygonOffsetFill = attr->PolygonOffsetFill;
       ctx->GLThread.PolygonStipple = attr->PolygonStipple;
    }
 
@@ -639,8 +705,22 @@ _mesa_glthread_PopAttrib(struct gl_context *ctx)
    if (mask & (GL_LIGHTING_BIT | GL_ENABLE_BIT))
       ctx->GLThread.Lighting = attr->Lighting;
 
-   if (mask & GL_TEXTURE_BIT)
+   if (mask & (GL_SCISSOR_BIT | GL_ENABLE_BIT))
+      ctx->GLThread.ScissorTest = attr->ScissorTest;
+
+   if (mask & (GL_STENCIL_BUFFER_BIT | GL_ENABLE_BIT))
+      ctx->GLThread.StencilTest = attr->StencilTest;
+
+   if (mask & GL_TEXTURE_BIT) {
       ctx->GLThread.ActiveTexture = attr->ActiveTexture;
+      /* All texture bindings are restored. */
+      ctx->GLThread.TextureBindingsValid = 0;
+   }
+
+   if (mask & GL_VIEWPORT_BIT) {
+      memcpy(ctx->GLThread.Viewport, attr->Viewport, sizeof(attr->Viewport));
+      ctx->GLThread.ViewportValid = attr->ViewportValid;
+   }
 
    if (mask & GL_TRANSFORM_BIT) {
       ctx->GLThread.MatrixMode = attr->MatrixMode;
@@ -775,11 +855,29 @@ _mesa_glthread_wait_for_call(struct gl_context *ctx,
 {
    int batch = p_atomic_read(last_batch_index_where_called);
    if (batch != -1) {
-      util_queue_fence_wait(&ctx->GLThread.batches[batch].fence);
+      struct util_queue_fence *fence = &ctx->GLThread.batches[batch]->fence;
+
+      if (!util_queue_fence_is_signalled(fence)) {
+         util_queue_fence_wait(fence);
+         p_atomic_inc(&ctx->GLThread.stats.num_partial_syncs);
+      }
       assert(p_atomic_read(last_batch_index_where_called) == -1);
    }
 }
 
+/* Display lists can bind textures and set the viewport. Rather than
+ * replaying those commands, forget the shadowed values, so that the next
+ * glGet of them synchronizes once.
+ */
+static inline void
+_mesa_glthread_invalidate_list_state(struct gl_context *ctx)
+{
+   if (ctx->Shared->DisplayListsInvalidateGLThread) {
+      ctx->GLThread.ViewportValid = false;
+      ctx->GLThread.TextureBindingsValid = 0;
+   }
+}
+
 static inline void
 _mesa_glthread_CallList(struct gl_context *ctx, GLuint list)
 {
@@ -792,6 +890,11 @@ _mesa_glthread_CallList(struct gl_context *ctx, GLuint list)
     */
    _mesa_glthread_wait_for_call(ctx, &ctx->GLThread.LastDListChangeBatchIndex);
 
+   /* Before executing the list too, so that glPushAttrib in the list
+    * doesn't save the shadowed viewport as valid.
+    */
+   _mesa_glthread_invalidate_list_state(ctx);
+
    if (!ctx->Shared->DisplayListsAffectGLThread)
       return;
 
@@ -802,6 +905,9 @@ _mesa_glthread_CallList(struct gl_context *ctx, GLuint list)
    _mesa_glthread_execute_list(ctx, list);
 
    ctx->GLThread.ListMode = saved_mode;
+
+   /* glPopAttrib in the list may have restored a valid viewport. */
+   _mesa_glthread_invalidate_list_state(ctx);
 }
 
 static inline void
@@ -931,6 +1037,54 @@ _mesa_glthread_DeleteLists(struct gl_context *ctx, GLsizei range)
    _mesa_glthread_fence_call(ctx, &ctx->GLThread.LastDListChangeBatchIndex);
 }
 
+static inline void
+_mesa_glthread_Viewport(struct gl_context *ctx, GLint x, GLint y,
+                        GLsizei width, GLsizei height)
+{
+   if (ctx->GLThread.ListMode == GL_COMPILE)
+      return;
+
+   if (width < 0 || height < 0)
+      return;
+
+   GLfloat *v = ctx->GLThread.Viewport;
+
+   v[0] = x;
+   v[1] = y;
+   v[2] = width;
+   v[3] = height;
+   _mesa_clamp_viewport(ctx, &v[0], &v[1], &v[2], &v[3]);
+
+   /* The viewport is set to the drawable size when the context is first made
+    * current with a drawable, so it isn't known until then.
+    */
+   ctx->GLThread.ViewportValid = ctx->ViewportInitialized;
+}
+
+/* For glViewportArrayv and glViewportIndexedf[v]. */
+static inline void
+_mesa_glthread_ViewportIndexed(struct gl_context *ctx, GLuint first)
+{
+   if (ctx->GLThread.ListMode == GL_COMPILE)
+      return;
+
+   if (first == 0)
+      ctx->GLThread.ViewportValid = false;
+}
+
+static inline void
+_mesa_glthread_BindTexture(struct gl_context *ctx, unsigned unit,
+                           GLenum target, GLuint texture)
+{
+   if (ctx->GLThread.ListMode == GL_COMPILE)
+      return;
+
+   int index = _mesa_tex_target_to_index(ctx, target);
+
+   if (unit < GLTHREAD_MAX_TEXTURE_UNITS && index >= 0)
+      ctx->GLThread.TextureBindings[unit][index] = texture;
+}
+
 static inline void
 _mesa_glthread_BindFramebuffer(struct gl_context *ctx, GLenum target, GLuint id)
 {
@@ -106,7 +106,8 @@ _mesa_HashInsertLocked(struct _mesa_HashTable *table, GLuint key, void *data)
    if (key > table->MaxKey)
       table->MaxKey = key;
 
-   *(void**)util_sparse_array_get(&table->array, key) = data;
+   /* Lookups don't lock the mutex, publish the initialized object. */
+   p_atomic_set((void **)util_sparse_array_get(&table->array, key), data);
 
    util_idalloc_sparse_reserve(&table->id_alloc, key);
 }
@@ -140,7 +141,7 @@ void
 _mesa_HashRemoveLocked(struct _mesa_HashTable *table, GLuint key)
 {
    assert(key);
-   *(void**)util_sparse_array_get(&table->array, key) = NULL;
+   p_atomic_set((void **)util_sparse_array_get(&table->array, key), NULL);
 
    util_idalloc_sparse_free(&table->id_alloc, key);
 }
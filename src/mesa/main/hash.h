@@ -37,12 +37,18 @@
 #include "c11/threads.h"
 #include "util/simple_mtx.h"
 #include "util/sparse_array.h"
+#include "util/u_atomic.h"
 #include "util/u_idalloc.h"
 
 /**
  * The not-really-hash-table data structure. It pretends to be a hash table,
  * but it uses util_idalloc to keep track of GL object IDs and
  * util_sparse_array for storing entries. Lookups only access the array.
+ *
+ * util_sparse_array is thread-safe and entries are stored and loaded
+ * atomically, so lookups don't take the mutex. The mutex serializes
+ * insertions, removals and walks, and lets callers look up an object and
+ * reference it before another thread can remove it.
  */
 struct _mesa_HashTable {
    struct util_sparse_array array;
@@ -133,42 +139,46 @@ _mesa_HashUnlockMaybeLocked(struct _mesa_HashTable *table, bool locked)
 }
 
 /**
- * Lookup an entry in the hash table without locking the mutex.
+ * Lookup an entry in the hash table.
  *
- * The hash table mutex must be locked manually by calling
- * _mesa_HashLockMutex() before calling this function.
+ * This doesn't lock the mutex. The acquire load pairs with the release
+ * store of _mesa_HashInsertLocked, so the object is seen fully initialized.
  *
  * \return pointer to user's data or NULL if key not in table
  */
 static inline void *
-_mesa_HashLookupLocked(struct _mesa_HashTable *table, GLuint key)
+_mesa_HashLookup(struct _mesa_HashTable *table, GLuint key)
 {
    assert(key);
-   return *(void**)util_sparse_array_get(&table->array, key);
+   return p_atomic_read((void **)util_sparse_array_get(&table->array, key));
 }
 
 /**
- * Lookup an entry in the hash table.
+ * Lookup an entry in the hash table with the mutex held.
+ *
+ * This is the same as _mesa_HashLookup, the caller holds the mutex to keep
+ * the object from being removed by another thread until it's referenced.
  *
  * \return pointer to user's data or NULL if key not in table
  */
 static inline void *
-_mesa_HashLookup(struct _mesa_HashTable *table, GLuint key)
+_mesa_HashLookupLocked(struct _mesa_HashTable *table, GLuint key)
 {
-   _mesa_HashLockMutex(table);
-   void *res = _mesa_HashLookupLocked(table, key);
-   _mesa_HashUnlockMutex(table);
-   return res;
+   return _mesa_HashLookup(table, key);
 }
 
+/**
+ * Lookup an entry in the hash table, with the mutex held if \p locked.
+ *
+ * The lookup itself is the same either way.
+ */
 static inline void *
 _mesa_HashLookupMaybeLocked(struct _mesa_HashTable *table, GLuint key,
                             bool locked)
 {
    if (locked)
-      return _mesa_HashLookupLocked(table, key);
-   else
-      return _mesa_HashLookup(table, key);
+      simple_mtx_assert_locked(&table->Mutex);
+   return _mesa_HashLookup(table, key);
 }
 
 #endif
@@ -1466,6 +1466,8 @@ struct gl_buffer_object
    unsigned MinMaxCacheHitIndices;
    unsigned MinMaxCacheMissIndices;
    struct hash_table *MinMaxCache;
+   /** Min/max index of each block of the buffer, see vbo_minmax_index.c */
+   struct vbo_minmax_block_tree *MinMaxBlockTree;
    simple_mtx_t MinMaxCacheMutex;
    bool MinMaxCacheDirty:1;
 
@@ -2396,6 +2398,8 @@ struct gl_shared_state
    simple_mtx_t Mutex;		   /**< for thread safety */
    GLint RefCount;			   /**< Reference count */
    bool DisplayListsAffectGLThread;
+   /* Whether display lists change state that glthread only invalidates. */
+   bool DisplayListsInvalidateGLThread;
 
    /* Whether the next glGen returns the lowest unused GL ID. */
    bool ReuseGLNames;
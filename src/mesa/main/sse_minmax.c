@@ -25,71 +25,196 @@
  *
  */
 
+/* This file is built twice, with SSE4.1 and with AVX2 enabled. */
+
 #include "main/sse_minmax.h"
 #include "util/macros.h"
-#include <smmintrin.h>
 #include <stdint.h>
 
-void
-_mesa_uint_array_min_max(const unsigned *ui_indices, unsigned *min_index,
-                         unsigned *max_index, const unsigned count)
+#ifdef __AVX2__
+#include <immintrin.h>
+
+typedef __m256i minmax_vec;
+
+#define VEC_LOADU(p)          _mm256_loadu_si256((const __m256i *)(p))
+#define VEC_STOREU(p, v)      _mm256_storeu_si256((__m256i *)(p), v)
+#define VEC_ONES()            _mm256_set1_epi32(-1)
+#define VEC_ZERO()            _mm256_setzero_si256()
+#define VEC_OR(a, b)          _mm256_or_si256(a, b)
+#define VEC_ANDNOT(a, b)      _mm256_andnot_si256(a, b)
+#define VEC_OP(op, bits, ...) _mm256_##op##bits(__VA_ARGS__)
+
+#define MINMAX_FUNC _mesa_index_array_min_max_avx2
+#else
+#include <smmintrin.h>
+
+typedef __m128i minmax_vec;
+
+#define VEC_LOADU(p)          _mm_loadu_si128((const __m128i *)(p))
+#define VEC_STOREU(p, v)      _mm_storeu_si128((__m128i *)(p), v)
+#define VEC_ONES()            _mm_set1_epi32(-1)
+#define VEC_ZERO()            _mm_setzero_si128()
+#define VEC_OR(a, b)          _mm_or_si128(a, b)
+#define VEC_ANDNOT(a, b)      _mm_andnot_si128(a, b)
+#define VEC_OP(op, bits, ...) _mm_##op##bits(__VA_ARGS__)
+
+#define MINMAX_FUNC _mesa_index_array_min_max_sse41
+#endif
+
+static ALWAYS_INLINE minmax_vec
+vec_set1(unsigned index_size, unsigned x)
 {
-   unsigned max_ui = 0;
-   unsigned min_ui = ~0U;
-   unsigned i = 0;
-   unsigned aligned_count = count;
+   switch (index_size) {
+   case 1: return VEC_OP(set1_epi, 8, (char)x);
+   case 2: return VEC_OP(set1_epi, 16, (short)x);
+   default: return VEC_OP(set1_epi, 32, (int)x);
+   }
+}
+
+static ALWAYS_INLINE minmax_vec
+vec_cmpeq(unsigned index_size, minmax_vec a, minmax_vec b)
+{
+   switch (index_size) {
+   case 1: return VEC_OP(cmpeq_epi, 8, a, b);
+   case 2: return VEC_OP(cmpeq_epi, 16, a, b);
+   default: return VEC_OP(cmpeq_epi, 32, a, b);
+   }
+}
 
-   /* handle the first few values without SSE until the pointer is aligned */
-   while (((uintptr_t)ui_indices & 15) && aligned_count) {
-      if (*ui_indices > max_ui)
-         max_ui = *ui_indices;
-      if (*ui_indices < min_ui)
-         min_ui = *ui_indices;
+static ALWAYS_INLINE minmax_vec
+vec_min(unsigned index_size, minmax_vec a, minmax_vec b)
+{
+   switch (index_size) {
+   case 1: return VEC_OP(min_epu, 8, a, b);
+   case 2: return VEC_OP(min_epu, 16, a, b);
+   default: return VEC_OP(min_epu, 32, a, b);
+   }
+}
 
-      aligned_count--;
-      ui_indices++;
+static ALWAYS_INLINE minmax_vec
+vec_max(unsigned index_size, minmax_vec a, minmax_vec b)
+{
+   switch (index_size) {
+   case 1: return VEC_OP(max_epu, 8, a, b);
+   case 2: return VEC_OP(max_epu, 16, a, b);
+   default: return VEC_OP(max_epu, 32, a, b);
    }
+}
 
-   /* TODO: The actual threshold for SSE begin useful may be higher than 8.
-    * Some careful microbenchmarks and measurement are required to
-    * find the actual tipping point.
-    */
-   if (aligned_count >= 8) {
-      alignas(16) unsigned max_arr[4];
-      alignas(16) unsigned min_arr[4];
-      unsigned vec_count;
-      __m128i max_ui4 = _mm_setzero_si128();
-      __m128i min_ui4 = _mm_set1_epi32(~0U);
-      __m128i ui_indices4;
-      __m128i *ui_indices_ptr;
-
-      vec_count = aligned_count & ~0x3;
-      ui_indices_ptr = (__m128i *)ui_indices;
-      for (i = 0; i < vec_count / 4; i++) {
-         ui_indices4 = _mm_load_si128(&ui_indices_ptr[i]);
-         max_ui4 = _mm_max_epu32(ui_indices4, max_ui4);
-         min_ui4 = _mm_min_epu32(ui_indices4, min_ui4);
-      }
+static ALWAYS_INLINE unsigned
+get_index(unsigned index_size, const uint8_t *indices, unsigned i)
+{
+   switch (index_size) {
+   case 1: return indices[i];
+   case 2: return ((const uint16_t *)indices)[i];
+   default: return ((const uint32_t *)indices)[i];
+   }
+}
+
+/* Restart indices are replaced by all ones for the min and by zero for the
+ * max, so that they are ignored.
+ */
+static ALWAYS_INLINE void
+index_array_min_max(unsigned index_size, bool restart,
+                    const uint8_t *indices, unsigned count,
+                    unsigned restart_index,
+                    unsigned *min_index, unsigned *max_index)
+{
+   const unsigned lanes = sizeof(minmax_vec) / index_size;
+   const unsigned unroll = 4;
+   minmax_vec vmin[4], vmax[4];
+   minmax_vec vrestart = vec_set1(index_size, restart_index);
+   unsigned min = ~0u, max = 0;
+   unsigned i = 0;
+
+   for (unsigned u = 0; u < unroll; u++) {
+      vmin[u] = VEC_ONES();
+      vmax[u] = VEC_ZERO();
+   }
 
-      _mm_store_si128((__m128i *)max_arr, max_ui4);
-      _mm_store_si128((__m128i *)min_arr, min_ui4);
+   /* Unroll to hide the latency of the min/max instructions. */
+   for (; i + lanes * unroll <= count; i += lanes * unroll) {
+      for (unsigned u = 0; u < unroll; u++) {
+         minmax_vec v = VEC_LOADU(indices + (i + u * lanes) * index_size);
 
-      for (i = 0; i < 4; i++) {
-         if (max_arr[i] > max_ui)
-            max_ui = max_arr[i];
-         if (min_arr[i] < min_ui)
-            min_ui = min_arr[i];
+         if (restart) {
+            minmax_vec is_restart = vec_cmpeq(index_size, v, vrestart);
+            vmin[u] = vec_min(index_size, vmin[u], VEC_OR(v, is_restart));
+            vmax[u] = vec_max(index_size, vmax[u], VEC_ANDNOT(is_restart, v));
+         } else {
+            vmin[u] = vec_min(index_size, vmin[u], v);
+            vmax[u] = vec_max(index_size, vmax[u], v);
+         }
       }
-      i = vec_count;
    }
 
-   for (; i < aligned_count; i++) {
-      if (ui_indices[i] > max_ui)
-         max_ui = ui_indices[i];
-      if (ui_indices[i] < min_ui)
-         min_ui = ui_indices[i];
+   for (unsigned u = 1; u < unroll; u++) {
+      vmin[0] = vec_min(index_size, vmin[0], vmin[u]);
+      vmax[0] = vec_max(index_size, vmax[0], vmax[u]);
+   }
+
+   uint8_t min_lanes[sizeof(minmax_vec)], max_lanes[sizeof(minmax_vec)];
+   VEC_STOREU(min_lanes, vmin[0]);
+   VEC_STOREU(max_lanes, vmax[0]);
+
+   for (unsigned l = 0; l < lanes; l++) {
+      min = MIN2(min, get_index(index_size, min_lanes, l));
+      max = MAX2(max, get_index(index_size, max_lanes, l));
+   }
+
+   for (; i < count; i++) {
+      unsigned index = get_index(index_size, indices, i);
+
+      if (restart && index == restart_index)
+         continue;
+
+      min = MIN2(min, index);
+      max = MAX2(max, index);
+   }
+
+   /* Only restart indices, return the same as the scalar code. */
+   if (min > max) {
+      min = ~0u;
+      max = 0;
    }
 
-   *min_index = min_ui;
-   *max_index = max_ui;
+   *min_index = min;
+   *max_index = max;
+}
+
+void
+MINMAX_FUNC(const void *indices, unsigned count, unsigned index_size,
+            bool restart, unsigned restart_index,
+            unsigned *min_index, unsigned *max_index)
+{
+   /* A restart index that doesn't fit in the index size never matches. */
+   if (index_size < 4 && restart_index >> (index_size * 8))
+      restart = false;
+
+   switch (index_size) {
+   case 1:
+      if (restart)
+         index_array_min_max(1, true, indices, count, restart_index,
+                             min_index, max_index);
+      else
+         index_array_min_max(1, false, indices, count, 0,
+                             min_index, max_index);
+      break;
+   case 2:
+      if (restart)
+         index_array_min_max(2, true, indices, count, restart_index,
+                             min_index, max_index);
+      else
+         index_array_min_max(2, false, indices, count, 0,
+                             min_index, max_index);
+      break;
+   default:
+      if (restart)
+         index_array_min_max(4, true, indices, count, restart_index,
+                             min_index, max_index);
+      else
+         index_array_min_max(4, false, indices, count, 0,
+                             min_index, max_index);
+      break;
+   }
 }
@@ -28,8 +28,30 @@
 #ifndef SSE_MINMAX_H
 #define SSE_MINMAX_H
 
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Computes the min and max of an array of 1, 2 or 4 byte indices, ignoring
+ * the restart index if restart is true. Returns ~0 and 0 if there are no
+ * indices to consider, like the scalar code.
+ */
 void
-_mesa_uint_array_min_max(const unsigned *ui_indices, unsigned *min_index,
-                         unsigned *max_index, const unsigned count);
+_mesa_index_array_min_max_sse41(const void *indices, unsigned count,
+                                unsigned index_size, bool restart,
+                                unsigned restart_index,
+                                unsigned *min_index, unsigned *max_index);
+
+void
+_mesa_index_array_min_max_avx2(const void *indices, unsigned count,
+                               unsigned index_size, bool restart,
+                               unsigned restart_index,
+                               unsigned *min_index, unsigned *max_index);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif /* SSE_MINMAX_H */
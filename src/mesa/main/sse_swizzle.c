@@ -0,0 +1,239 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/* This file is built twice, with SSE4.1 and with AVX2 enabled. */
+
+#include "main/formats.h"
+#include "main/sse_swizzle.h"
+#include "util/macros.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+
+#define PIXELS_PER_VEC 8
+
+#define SWIZZLE_UBYTE_FUNC   _mesa_swizzle_ubyte_avx2
+#define FLOAT_TO_UNORM8_FUNC _mesa_float_to_unorm8_avx2
+#define UNORM8_TO_FLOAT_FUNC _mesa_unorm8_to_float_avx2
+#else
+#include <smmintrin.h>
+
+#define PIXELS_PER_VEC 4
+
+#define SWIZZLE_UBYTE_FUNC   _mesa_swizzle_ubyte_sse41
+#define FLOAT_TO_UNORM8_FUNC _mesa_float_to_unorm8_sse41
+#define UNORM8_TO_FLOAT_FUNC _mesa_unorm8_to_float_sse41
+#endif
+
+struct swizzle_ctrl {
+   __m128i shuffle;
+   __m128i ones;
+};
+
+/* Returns the controls moving 4 pixels of src_channels bytes packed at the
+ * start of a 16-byte vector to 4 pixels of 4 bytes, then ORing in the bytes
+ * set to one. Channels that aren't in the source are set to zero.
+ */
+static struct swizzle_ctrl
+get_swizzle_ctrl(unsigned src_channels, const uint8_t swizzle[4], uint8_t one)
+{
+   uint8_t shuffle[16], ones[16];
+
+   for (unsigned p = 0; p < 4; p++) {
+      for (unsigned c = 0; c < 4; c++) {
+         shuffle[p * 4 + c] = swizzle[c] < src_channels ?
+                              p * src_channels + swizzle[c] : 0x80;
+         ones[p * 4 + c] = swizzle[c] == MESA_FORMAT_SWIZZLE_ONE ? one : 0;
+      }
+   }
+
+   return (struct swizzle_ctrl) {
+      _mm_loadu_si128((const __m128i *)shuffle),
+      _mm_loadu_si128((const __m128i *)ones),
+   };
+}
+
+#ifdef __AVX2__
+typedef __m256i swizzle_vec;
+
+/* pshufb works within 128-bit lanes, each lane holds 4 pixels. */
+static ALWAYS_INLINE __m256i
+apply_swizzle(__m256i v, struct swizzle_ctrl ctrl)
+{
+   return _mm256_or_si256(
+      _mm256_shuffle_epi8(v, _mm256_broadcastsi128_si256(ctrl.shuffle)),
+      _mm256_broadcastsi128_si256(ctrl.ones));
+}
+#else
+typedef __m128i swizzle_vec;
+
+static ALWAYS_INLINE __m128i
+apply_swizzle(__m128i v, struct swizzle_ctrl ctrl)
+{
+   return _mm_or_si128(_mm_shuffle_epi8(v, ctrl.shuffle), ctrl.ones);
+}
+#endif
+
+/* Loads PIXELS_PER_VEC pixels of src_channels bytes, 4 pixels per 128-bit
+ * lane. 3-channel pixels are loaded 16 bytes at a time, so the caller must
+ * ensure that 4 more bytes than the pixels can be read.
+ */
+static ALWAYS_INLINE swizzle_vec
+load_ubyte_pixels(const uint8_t *src, unsigned src_channels)
+{
+#ifdef __AVX2__
+   if (src_channels == 3) {
+      __m128i lo = _mm_loadu_si128((const __m128i *)src);
+      __m128i hi = _mm_loadu_si128((const __m128i *)(src + 12));
+      return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+   }
+   return _mm256_loadu_si256((const __m256i *)src);
+#else
+   return _mm_loadu_si128((const __m128i *)src);
+#endif
+}
+
+static ALWAYS_INLINE void
+store_pixels(uint8_t *dst, swizzle_vec v)
+{
+#ifdef __AVX2__
+   _mm256_storeu_si256((__m256i *)dst, v);
+#else
+   _mm_storeu_si128((__m128i *)dst, v);
+#endif
+}
+
+static ALWAYS_INLINE int
+swizzle_ubyte(uint8_t *dst, const uint8_t *src, unsigned src_channels,
+              struct swizzle_ctrl ctrl, int count)
+{
+   const size_t slack = src_channels == 3 ? 4 : 0;
+   int i = 0;
+
+   for (; ((size_t)i + PIXELS_PER_VEC) * src_channels + slack <=
+          (size_t)count * src_channels; i += PIXELS_PER_VEC) {
+      swizzle_vec v = load_ubyte_pixels(src + (size_t)i * src_channels,
+                                        src_channels);
+      store_pixels(dst + (size_t)i * 4, apply_swizzle(v, ctrl));
+   }
+   return i;
+}
+
+int
+SWIZZLE_UBYTE_FUNC(uint8_t *dst, const uint8_t *src, unsigned src_channels,
+                   const uint8_t swizzle[4], uint8_t one, int count)
+{
+   struct swizzle_ctrl ctrl = get_swizzle_ctrl(src_channels, swizzle, one);
+
+   if (src_channels == 3)
+      return swizzle_ubyte(dst, src, 3, ctrl, count);
+   else
+      return swizzle_ubyte(dst, src, 4, ctrl, count);
+}
+
+int
+FLOAT_TO_UNORM8_FUNC(uint8_t *dst, const float *src,
+                     const uint8_t swizzle[4], int count)
+{
+   struct swizzle_ctrl ctrl = get_swizzle_ctrl(4, swizzle, UINT8_MAX);
+   int i = 0;
+
+   /* min/max return the second operand for NaN, so NaN becomes 0 as with
+    * _mesa_float_to_unorm. cvtps rounds to nearest even like
+    * _mesa_i64roundevenf.
+    */
+#ifdef __AVX2__
+   const __m256 zero = _mm256_setzero_ps();
+   const __m256 one = _mm256_set1_ps(1.0f);
+   const __m256 scale = _mm256_set1_ps(255.0f);
+   /* packs/packus interleave the lanes, put the pixels back in order. */
+   const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+   for (; i + PIXELS_PER_VEC <= count; i += PIXELS_PER_VEC) {
+      __m256i v[4];
+
+      for (unsigned k = 0; k < 4; k++) {
+         __m256 f = _mm256_loadu_ps(src + (size_t)(i + k * 2) * 4);
+         f = _mm256_min_ps(_mm256_max_ps(f, zero), one);
+         v[k] = _mm256_cvtps_epi32(_mm256_mul_ps(f, scale));
+      }
+
+      __m256i b = _mm256_packus_epi16(_mm256_packs_epi32(v[0], v[1]),
+                                      _mm256_packs_epi32(v[2], v[3]));
+      b = _mm256_permutevar8x32_epi32(b, order);
+      store_pixels(dst + (size_t)i * 4, apply_swizzle(b, ctrl));
+   }
+#else
+   const __m128 zero = _mm_setzero_ps();
+   const __m128 one = _mm_set1_ps(1.0f);
+   const __m128 scale = _mm_set1_ps(255.0f);
+
+   for (; i + PIXELS_PER_VEC <= count; i += PIXELS_PER_VEC) {
+      __m128i v[4];
+
+      for (unsigned k = 0; k < 4; k++) {
+         __m128 f = _mm_loadu_ps(src + (size_t)(i + k) * 4);
+         f = _mm_min_ps(_mm_max_ps(f, zero), one);
+         v[k] = _mm_cvtps_epi32(_mm_mul_ps(f, scale));
+      }
+
+      __m128i b = _mm_packus_epi16(_mm_packs_epi32(v[0], v[1]),
+                                   _mm_packs_epi32(v[2], v[3]));
+      store_pixels(dst + (size_t)i * 4, apply_swizzle(b, ctrl));
+   }
+#endif
+   return i;
+}
+
+int
+UNORM8_TO_FLOAT_FUNC(float *dst, const uint8_t *src,
+                     const uint8_t swizzle[4], int count)
+{
+   /* One becomes 255, which converts to exactly 1.0. */
+   struct swizzle_ctrl ctrl = get_swizzle_ctrl(4, swizzle, UINT8_MAX);
+   int i = 0;
+
+   /* The same constant as _mesa_unorm_to_float, to get the same results. */
+#ifdef __AVX2__
+   const __m256 scale = _mm256_set1_ps(1.0f / 255.0f);
+
+   for (; i + PIXELS_PER_VEC <= count; i += PIXELS_PER_VEC) {
+      __m256i v = apply_swizzle(load_ubyte_pixels(src + (size_t)i * 4, 4),
+                                ctrl);
+      __m128i half[2] = {
+         _mm256_castsi256_si128(v),
+         _mm256_extracti128_si256(v, 1),
+      };
+      float *d = dst + (size_t)i * 4;
+
+      for (unsigned h = 0; h < 2; h++) {
+         __m256i lo = _mm256_cvtepu8_epi32(half[h]);
+         __m256i hi = _mm256_cvtepu8_epi32(_mm_srli_si128(half[h], 8));
+         _mm256_storeu_ps(d + h * 16,
+                          _mm256_mul_ps(_mm256_cvtepi32_ps(lo), scale));
+         _mm256_storeu_ps(d + h * 16 + 8,
+                          _mm256_mul_ps(_mm256_cvtepi32_ps(hi), scale));
+      }
+   }
+#else
+   const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+
+   for (; i + PIXELS_PER_VEC <= count; i += PIXELS_PER_VEC) {
+      __m128i v = apply_swizzle(load_ubyte_pixels(src + (size_t)i * 4, 4),
+                                ctrl);
+      __m128i p[4] = {
+         _mm_cvtepu8_epi32(v),
+         _mm_cvtepu8_epi32(_mm_srli_si128(v, 4)),
+         _mm_cvtepu8_epi32(_mm_srli_si128(v, 8)),
+         _mm_cvtepu8_epi32(_mm_srli_si128(v, 12)),
+      };
+      float *d = dst + (size_t)i * 4;
+
+      for (unsigned k = 0; k < 4; k++)
+         _mm_storeu_ps(d + k * 4, _mm_mul_ps(_mm_cvtepi32_ps(p[k]), scale));
+   }
+#endif
+   return i;
+}
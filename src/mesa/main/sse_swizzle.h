@@ -0,0 +1,46 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef SSE_SWIZZLE_H
+#define SSE_SWIZZLE_H
+
+#include <stdint.h>
+
+/* Vectorized cases of _mesa_swizzle_and_convert, all writing 4 channels
+ * per pixel. swizzle[] is interpreted as by _mesa_swizzle_and_convert.
+ * They only convert whole vectors of pixels and return how many they
+ * converted; the caller converts the remaining ones.
+ */
+
+/* 8-bit to 8-bit, from 3 or 4 source channels. */
+int
+_mesa_swizzle_ubyte_sse41(uint8_t *dst, const uint8_t *src,
+                          unsigned src_channels, const uint8_t swizzle[4],
+                          uint8_t one, int count);
+
+int
+_mesa_swizzle_ubyte_avx2(uint8_t *dst, const uint8_t *src,
+                         unsigned src_channels, const uint8_t swizzle[4],
+                         uint8_t one, int count);
+
+/* 4-channel float to unorm8, with the rounding of _mesa_float_to_unorm. */
+int
+_mesa_float_to_unorm8_sse41(uint8_t *dst, const float *src,
+                            const uint8_t swizzle[4], int count);
+
+int
+_mesa_float_to_unorm8_avx2(uint8_t *dst, const float *src,
+                           const uint8_t swizzle[4], int count);
+
+/* 4-channel unorm8 to float. */
+int
+_mesa_unorm8_to_float_sse41(float *dst, const uint8_t *src,
+                            const uint8_t swizzle[4], int count);
+
+int
+_mesa_unorm8_to_float_avx2(float *dst, const uint8_t *src,
+                           const uint8_t swizzle[4], int count);
+
+#endif /* SSE_SWIZZLE_H */
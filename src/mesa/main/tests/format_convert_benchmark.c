@@ -0,0 +1,94 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Measures _mesa_format_convert on the conversions done by glTexImage,
+ * glReadPixels and glGetTexImage with common formats and types.
+ *
+ * The image width and height can be given as the first argument. Run with
+ * GALLIUM_OVERRIDE_CPU_CAPS=nosse to measure the scalar conversions, and
+ * with MESA_PIXEL_TRANSFER_THREADS=1 to measure a single thread.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "main/format_utils.h"
+#include "main/glformats.h"
+#include "util/os_time.h"
+
+#define ITERATIONS 10
+
+struct conversion {
+   const char *name;
+   GLenum format, type;
+   mesa_format tex_format;
+   bool upload;
+};
+
+static const struct conversion conversions[] = {
+   { "RGBA/UNSIGNED_BYTE -> BGRA8",  GL_RGBA, GL_UNSIGNED_BYTE,
+     MESA_FORMAT_B8G8R8A8_UNORM, true },
+   { "BGRA/UNSIGNED_BYTE -> RGBA8",  GL_BGRA, GL_UNSIGNED_BYTE,
+     MESA_FORMAT_R8G8B8A8_UNORM, true },
+   { "RGB/UNSIGNED_BYTE -> RGBA8",   GL_RGB, GL_UNSIGNED_BYTE,
+     MESA_FORMAT_R8G8B8A8_UNORM, true },
+   { "RGB/UNSIGNED_BYTE -> BGRX8",   GL_RGB, GL_UNSIGNED_BYTE,
+     MESA_FORMAT_B8G8R8X8_UNORM, true },
+   { "RGBA/FLOAT -> RGBA8",          GL_RGBA, GL_FLOAT,
+     MESA_FORMAT_R8G8B8A8_UNORM, true },
+   { "RGBA/FLOAT -> RGBA16F",        GL_RGBA, GL_FLOAT,
+     MESA_FORMAT_RGBA_FLOAT16, true },
+   { "BGRA8 -> RGBA/UNSIGNED_BYTE",  GL_RGBA, GL_UNSIGNED_BYTE,
+     MESA_FORMAT_B8G8R8A8_UNORM, false },
+   { "RGBA8 -> RGBA/FLOAT",          GL_RGBA, GL_FLOAT,
+     MESA_FORMAT_R8G8B8A8_UNORM, false },
+   { "RGB565 -> RGBA/UNSIGNED_BYTE", GL_RGBA, GL_UNSIGNED_BYTE,
+     MESA_FORMAT_B5G6R5_UNORM, false },
+};
+
+int
+main(int argc, char **argv)
+{
+   size_t size = argc > 1 ? MAX2(strtoul(argv[1], NULL, 0), 1) : 2048;
+   size_t num_pixels = size * size;
+
+   /* Large enough for RGBA float pixels. */
+   uint8_t *src = malloc(num_pixels * 16);
+   uint8_t *dst = malloc(num_pixels * 16);
+   if (!src || !dst)
+      return 1;
+
+   for (size_t i = 0; i < num_pixels * 4; i++)
+      ((float *)src)[i] = (i % 256) / 255.0f;
+
+   for (unsigned c = 0; c < ARRAY_SIZE(conversions); c++) {
+      const struct conversion *conv = &conversions[c];
+      uint32_t gl_format =
+         _mesa_format_from_format_and_type(conv->format, conv->type);
+      uint32_t src_format = conv->upload ? gl_format : conv->tex_format;
+      uint32_t dst_format = conv->upload ? conv->tex_format : gl_format;
+      size_t gl_stride = _mesa_bytes_per_pixel(conv->format, conv->type) * size;
+      size_t tex_stride = _mesa_get_format_bytes(conv->tex_format) * size;
+      size_t src_stride = conv->upload ? gl_stride : tex_stride;
+      size_t dst_stride = conv->upload ? tex_stride : gl_stride;
+
+      int64_t start = os_time_get_nano();
+      for (unsigned i = 0; i < ITERATIONS; i++) {
+         _mesa_format_convert(dst, dst_format, dst_stride,
+                              src, src_format, src_stride,
+                              size, size, NULL);
+      }
+      int64_t ns = os_time_get_nano() - start;
+
+      printf("%-30s %6.2f ns/pixel\n", conv->name,
+             (double)ns / (num_pixels * ITERATIONS));
+   }
+
+   free(src);
+   free(dst);
+   return 0;
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Measures GL object name management from several threads sharing objects,
+ * like multiple contexts uploading buffers and textures: each thread creates
+ * objects as glGen* and glCreate* do, looks them up many times as binds and
+ * draws do, and deletes them. Each object also gets a buffer ID, as drivers
+ * using the threaded context allocate them.
+ *
+ * The maximum number of threads can be given as the first argument.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "c11/threads.h"
+#include "main/hash.h"
+#include "util/os_time.h"
+#include "util/u_idalloc.h"
+
+#define OBJECTS_PER_ROUND 64
+#define LOOKUPS_PER_OBJECT 16
+#define ROUNDS 2000
+
+struct object {
+   GLuint name;
+   unsigned buffer_id;
+};
+
+static struct _mesa_HashTable objects;
+static struct util_idalloc_mt buffer_ids;
+static unsigned num_errors;
+
+static int
+run_thread(void *data)
+{
+   struct object obj[OBJECTS_PER_ROUND];
+   GLuint names[OBJECTS_PER_ROUND];
+   uint32_t rand_state = (uintptr_t)data + 1;
+
+   for (unsigned round = 0; round < ROUNDS; round++) {
+      /* glGenBuffers + glBindBuffer */
+      _mesa_HashLockMutex(&objects);
+      _mesa_HashFindFreeKeys(&objects, names, OBJECTS_PER_ROUND);
+      for (unsigned i = 0; i < OBJECTS_PER_ROUND; i++) {
+         obj[i].name = names[i];
+         obj[i].buffer_id = util_idalloc_mt_alloc(&buffer_ids);
+         _mesa_HashInsertLocked(&objects, names[i], &obj[i]);
+      }
+      _mesa_HashUnlockMutex(&objects);
+
+      for (unsigned i = 0; i < OBJECTS_PER_ROUND * LOOKUPS_PER_OBJECT; i++) {
+         /* xorshift32 */
+         rand_state ^= rand_state << 13;
+         rand_state ^= rand_state >> 17;
+         rand_state ^= rand_state << 5;
+
+         GLuint name = names[rand_state % OBJECTS_PER_ROUND];
+         struct object *o = _mesa_HashLookup(&objects, name);
+         if (!o || o->name != name)
+            p_atomic_inc(&num_errors);
+      }
+
+      /* glDeleteBuffers */
+      for (unsigned i = 0; i < OBJECTS_PER_ROUND; i++) {
+         _mesa_HashRemove(&objects, names[i]);
+         util_idalloc_mt_free(&buffer_ids, obj[i].buffer_id);
+      }
+   }
+
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned max_threads = argc > 1 ? MAX2(strtoul(argv[1], NULL, 0), 1) : 8;
+   thrd_t *threads = calloc(max_threads, sizeof(*threads));
+
+   for (unsigned num_threads = 1; num_threads <= max_threads;
+        num_threads *= 2) {
+      _mesa_InitHashTable(&objects, true);
+      util_idalloc_mt_init_tc(&buffer_ids);
+
+      int64_t start = os_time_get_nano();
+      for (uintptr_t i = 0; i < num_threads; i++)
+         thrd_create(&threads[i], run_thread, (void *)i);
+      for (unsigned i = 0; i < num_threads; i++)
+         thrd_join(threads[i], NULL);
+      int64_t ns = os_time_get_nano() - start;
+
+      /* Wall time per object, including its lookups. */
+      uint64_t num_objects = (uint64_t)num_threads * ROUNDS * OBJECTS_PER_ROUND;
+      printf("%u threads: %.1f ns/object (create, %u lookups, delete)\n",
+             num_threads, (double)ns / num_objects, LOOKUPS_PER_OBJECT);
+
+      util_idalloc_mt_fini(&buffer_ids);
+      _mesa_DeinitHashTable(&objects, NULL, NULL);
+   }
+
+   free(threads);
+
+   if (num_errors) {
+      fprintf(stderr, "%u lookups failed\n", num_errors);
+      return 1;
+   }
+   return 0;
+}
@@ -29,12 +29,15 @@
  *
  */
 
+#include <cmath>
+#include <vector>
 #include <gtest/gtest.h>
 
 #include "main/formats.h"
 #include "main/glformats.h"
 #include "main/format_unpack.h"
 #include "main/format_pack.h"
+#include "main/format_utils.h"
 
 // Test fixture for Format tests.
 class MesaFormatsTest : public ::testing::Test {
@@ -283,3 +286,73 @@ TEST_F(MesaFormatsTest, PackUbyteRGBARounding)
       EXPECT_EQ(result, (i * 31 + 127) / 255);
    }
 }
+
+/* The vectorized conversions must match the pack and unpack functions,
+ * including for the pixels left over after the last full vector.
+ */
+TEST_F(MesaFormatsTest, FormatConvertFloatToUnorm8)
+{
+   const float values[] = {
+      0.0f, 1.0f, -1.0f, 2.0f, 0.5f, 0.25f, NAN, 1.5f / 255.0f,
+      2.5f / 255.0f, 0.999f, 0.001f, -0.0f, 0.75f, 0.1f, 0.2f, 0.3f,
+   };
+   const unsigned width = 37;
+   float src[width][4];
+   uint32_t result[width], expected[width];
+
+   for (unsigned i = 0; i < width * 4; i++)
+      src[i / 4][i % 4] = values[(i * 7) % ARRAY_SIZE(values)];
+
+   _mesa_pack_float_rgba_row(MESA_FORMAT_B8G8R8A8_UNORM, width, src,
+                             expected);
+   _mesa_format_convert(result, MESA_FORMAT_B8G8R8A8_UNORM, sizeof(result),
+                        src, RGBA32_FLOAT, sizeof(src), width, 1, NULL);
+   for (unsigned i = 0; i < width; i++)
+      EXPECT_EQ(result[i], expected[i]) << "pixel " << i;
+}
+
+TEST_F(MesaFormatsTest, FormatConvertUnorm8ToFloat)
+{
+   const unsigned width = 37;
+   uint32_t src[width];
+   float result[width][4], expected[width][4];
+
+   for (unsigned i = 0; i < width; i++)
+      src[i] = i * 0x01020304u * 7;
+
+   _mesa_unpack_rgba_row(MESA_FORMAT_B8G8R8X8_UNORM, width, src, expected);
+   _mesa_format_convert(result, RGBA32_FLOAT, sizeof(result),
+                        src, MESA_FORMAT_B8G8R8X8_UNORM, sizeof(src),
+                        width, 1, NULL);
+   for (unsigned i = 0; i < width; i++) {
+      for (unsigned c = 0; c < 4; c++)
+         EXPECT_EQ(result[i][c], expected[i][c]) << "pixel " << i;
+   }
+}
+
+/* Large enough to be converted in stripes on several threads. */
+TEST_F(MesaFormatsTest, FormatConvertRGB8Image)
+{
+   const unsigned width = 1001, height = 600, src_stride = width * 3 + 5;
+   const uint32_t src_format =
+      _mesa_format_from_format_and_type(GL_RGB, GL_UNSIGNED_BYTE);
+   std::vector<uint8_t> src(src_stride * height), result(width * height * 4);
+
+   for (unsigned i = 0; i < src.size(); i++)
+      src[i] = i * 13;
+
+   _mesa_format_convert(result.data(), MESA_FORMAT_RGBA_UNORM8, width * 4,
+                        src.data(), src_format, src_stride,
+                        width, height, NULL);
+   for (unsigned y = 0; y < height; y++) {
+      for (unsigned x = 0; x < width; x++) {
+         const uint8_t *s = &src[y * src_stride + x * 3];
+         const uint8_t *d = &result[(y * width + x) * 4];
+
+         if (memcmp(d, s, 3) || d[3] != 0xff) {
+            ADD_FAILURE() << "pixel " << x << ", " << y;
+            return;
+         }
+      }
+   }
+}
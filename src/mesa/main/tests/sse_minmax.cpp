@@ -0,0 +1,141 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/**
+ * \name sse_minmax.cpp
+ *
+ * Verify that the vectorized index min/max kernels match a scalar scan,
+ * for every index size, for counts that leave any number of indices after
+ * the last full vector, and with primitive restart.
+ */
+
+#include <cstring>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "main/sse_minmax.h"
+#include "util/macros.h"
+#include "util/u_cpu_detect.h"
+
+typedef void (*minmax_func)(const void *indices, unsigned count,
+                            unsigned index_size, bool restart,
+                            unsigned restart_index,
+                            unsigned *min_index, unsigned *max_index);
+
+static void
+scalar_min_max(const std::vector<uint32_t> &values, unsigned index_size,
+               bool restart, unsigned restart_index,
+               unsigned *min_index, unsigned *max_index)
+{
+   unsigned min = ~0u, max = 0;
+
+   for (uint32_t v : values) {
+      if (restart && v == restart_index)
+         continue;
+      min = MIN2(min, v);
+      max = MAX2(max, v);
+   }
+
+   *min_index = min;
+   *max_index = max;
+}
+
+/* Stores the values in an index buffer of index_size bytes per index. */
+static std::vector<uint8_t>
+make_indices(const std::vector<uint32_t> &values, unsigned index_size)
+{
+   std::vector<uint8_t> indices(values.size() * index_size + 1);
+
+   for (unsigned i = 0; i < values.size(); i++)
+      memcpy(&indices[i * index_size], &values[i], index_size);
+
+   return indices;
+}
+
+static void
+check_min_max(minmax_func func, const std::vector<uint32_t> &values,
+              unsigned index_size, bool restart, unsigned restart_index)
+{
+   std::vector<uint8_t> indices = make_indices(values, index_size);
+   unsigned min, max, expected_min, expected_max;
+
+   scalar_min_max(values, index_size, restart, restart_index,
+                  &expected_min, &expected_max);
+   func(indices.data(), values.size(), index_size, restart, restart_index,
+        &min, &max);
+
+   EXPECT_EQ(min, expected_min) << "index size " << index_size
+                                << ", count " << values.size()
+                                << ", restart " << restart;
+   EXPECT_EQ(max, expected_max) << "index size " << index_size
+                                << ", count " << values.size()
+                                << ", restart " << restart;
+}
+
+static void
+test_kernel(minmax_func func)
+{
+   for (unsigned index_size = 1; index_size <= 4; index_size *= 2) {
+      const unsigned mask = index_size == 4 ? ~0u : (1u << (index_size * 8)) - 1;
+      const unsigned restart_index = mask;
+
+      /* Up to 4 unrolled AVX2 vectors of bytes, and then some. */
+      for (unsigned count = 0; count <= 300; count++) {
+         std::vector<uint32_t> values(count);
+
+         for (unsigned i = 0; i < count; i++)
+            values[i] = ((i * 2654435761u) >> 7) & mask;
+
+         /* The extremes and the restart index, at an offset that moves
+          * between the vectors and the tail.
+          */
+         if (count) {
+            values[count * 3 / 4] = 0;
+            values[count / 3] = mask;
+            values[count / 2] = restart_index;
+         }
+
+         check_min_max(func, values, index_size, false, 0);
+         check_min_max(func, values, index_size, true, restart_index);
+         check_min_max(func, values, index_size, true, 0);
+
+         /* Only restart indices. */
+         std::vector<uint32_t> restarts(count, restart_index);
+         check_min_max(func, restarts, index_size, true, restart_index);
+      }
+
+      /* A restart index that doesn't fit in the index size is ignored. */
+      if (index_size < 4) {
+         std::vector<uint32_t> values = { 0, 1, mask, 3 };
+         std::vector<uint8_t> indices = make_indices(values, index_size);
+         unsigned min, max;
+
+         func(indices.data(), values.size(), index_size, true, ~0u,
+              &min, &max);
+         EXPECT_EQ(min, 0u);
+         EXPECT_EQ(max, mask);
+      }
+   }
+}
+
+#ifdef USE_SSE41
+TEST(SseMinMax, SSE41)
+{
+   if (!util_get_cpu_caps()->has_sse4_1)
+      GTEST_SKIP() << "SSE4.1 not supported";
+
+   test_kernel(_mesa_index_array_min_max_sse41);
+}
+#endif
+
+#ifdef USE_AVX2
+TEST(SseMinMax, AVX2)
+{
+   if (!util_get_cpu_caps()->has_avx2)
+      GTEST_SKIP() << "AVX2 not supported";
+
+   test_kernel(_mesa_index_array_min_max_avx2);
+}
+#endif
@@ -39,9 +39,9 @@
 #include "state_tracker/st_manager.h"
 #include "state_tracker/st_context.h"
 
-static void
-clamp_viewport(struct gl_context *ctx, GLfloat *x, GLfloat *y,
-               GLfloat *width, GLfloat *height)
+void
+_mesa_clamp_viewport(const struct gl_context *ctx, GLfloat *x, GLfloat *y,
+                     GLfloat *width, GLfloat *height)
 {
    /* clamp width and height to the implementation dependent range */
    *width  = MIN2(*width, (GLfloat) ctx->Const.MaxViewportWidth);
@@ -100,7 +100,7 @@ viewport(struct gl_context *ctx, GLint x, GLint y, GLsizei width,
    struct gl_viewport_inputs input = { x, y, width, height };
 
    /* Clamp the viewport to the implementation dependent values. */
-   clamp_viewport(ctx, &input.X, &input.Y, &input.Width, &input.Height);
+   _mesa_clamp_viewport(ctx, &input.X, &input.Y, &input.Width, &input.Height);
 
    /* The GL_ARB_viewport_array spec says:
     *
@@ -166,7 +166,7 @@ void
 _mesa_set_viewport(struct gl_context *ctx, unsigned idx, GLfloat x, GLfloat y,
                     GLfloat width, GLfloat height)
 {
-   clamp_viewport(ctx, &x, &y, &width, &height);
+   _mesa_clamp_viewport(ctx, &x, &y, &width, &height);
    set_viewport_no_notify(ctx, idx, x, y, width, height);
 
    if (ctx->invalidate_on_gl_viewport)
@@ -178,8 +178,8 @@ viewport_array(struct gl_context *ctx, GLuint first, GLsizei count,
                struct gl_viewport_inputs *inputs)
 {
    for (GLsizei i = 0; i < count; i++) {
-      clamp_viewport(ctx, &inputs[i].X, &inputs[i].Y,
-                     &inputs[i].Width, &inputs[i].Height);
+      _mesa_clamp_viewport(ctx, &inputs[i].X, &inputs[i].Y,
+                           &inputs[i].Width, &inputs[i].Height);
 
       set_viewport_no_notify(ctx, i + first, inputs[i].X, inputs[i].Y,
                              inputs[i].Width, inputs[i].Height);
@@ -35,6 +35,10 @@ extern void
 _mesa_set_viewport(struct gl_context *ctx, unsigned idx, GLfloat x, GLfloat y,
                    GLfloat width, GLfloat height);
 
+extern void
+_mesa_clamp_viewport(const struct gl_context *ctx, GLfloat *x, GLfloat *y,
+                     GLfloat *width, GLfloat *height);
+
 extern void
 _mesa_set_depth_range(struct gl_context *ctx, unsigned idx,
                       GLclampd nearval, GLclampd farval);
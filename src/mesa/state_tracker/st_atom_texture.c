@@ -306,10 +306,23 @@ update_textures(struct st_context *st,
    unsigned old_num_textures = st->state.num_sampler_views[shader_stage];
    unsigned num_unbind = old_num_textures > num_textures ?
                             old_num_textures - num_textures : 0;
+   struct pipe_sampler_view **bound = st->state.sampler_views[shader_stage];
 
-   pipe->set_sampler_views(pipe, shader_stage, 0, num_textures, num_unbind,
-                           sampler_views);
+   unsigned stage_bit = BITFIELD_BIT(shader_stage);
+   unsigned first, last;
+
+   st_changed_sampler_views(sampler_views, num_textures, bound,
+                            old_num_textures,
+                            st->state.sampler_views_invalid_mask & stage_bit,
+                            &first, &last);
+
+   if (first < last || num_unbind) {
+      pipe->set_sampler_views(pipe, shader_stage, first, last - first,
+                              num_unbind, sampler_views + first);
+   }
+   memcpy(bound, sampler_views, num_textures * sizeof(*bound));
    st->state.num_sampler_views[shader_stage] = num_textures;
+   st->state.sampler_views_invalid_mask &= ~stage_bit;
 
    /* release YUV views back to driver */
    if (pipe->sampler_view_release) {
@@ -319,6 +332,17 @@ update_textures(struct st_context *st,
    }
 }
 
+/**
+ * Called by paths that set sampler views with pipe->set_sampler_views
+ * directly, so that the next update_textures sets all slots of the stage.
+ */
+void
+st_invalidate_sampler_views(struct st_context *st,
+                            enum pipe_shader_type shader_stage)
+{
+   st->state.sampler_views_invalid_mask |= BITFIELD_BIT(shader_stage);
+}
+
 void
 st_update_vertex_textures(struct st_context *st)
 {
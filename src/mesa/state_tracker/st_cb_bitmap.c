@@ -253,6 +253,7 @@ setup_render_state(struct gl_context *ctx,
       pipe->set_sampler_views(pipe, PIPE_SHADER_FRAGMENT, 0, num_views, 0,
                               sampler_views);
       st->state.num_sampler_views[PIPE_SHADER_FRAGMENT] = num_views;
+      st_invalidate_sampler_views(st, PIPE_SHADER_FRAGMENT);
 
       for (unsigned i = 0; i < num_views; i++)
          pipe->sampler_view_release(pipe, sampler_views[i]);
@@ -862,6 +862,7 @@ draw_textured_quad(struct gl_context *ctx, GLint x, GLint y, GLfloat z,
       pipe->set_sampler_views(pipe, PIPE_SHADER_FRAGMENT, 0, num_views, 0,
                               sampler_views);
       st->state.num_sampler_views[PIPE_SHADER_FRAGMENT] = num_views;
+      st_invalidate_sampler_views(st, PIPE_SHADER_FRAGMENT);
 
       /* release YUV views back to driver */
       unsigned base_idx = num_views - num_owned_views;
@@ -873,6 +874,7 @@ draw_textured_quad(struct gl_context *ctx, GLint x, GLint y, GLfloat z,
                               0, sv);
       st->state.num_sampler_views[PIPE_SHADER_FRAGMENT] =
          MAX2(st->state.num_sampler_views[PIPE_SHADER_FRAGMENT], num_sampler_view);
+      st_invalidate_sampler_views(st, PIPE_SHADER_FRAGMENT);
    }
 
    /* viewport state: viewport matching window dims */
@@ -192,6 +192,7 @@ try_pbo_readpixels(struct st_context *st, struct gl_renderbuffer *rb,
                               &sampler_view);
       st->state.num_sampler_views[PIPE_SHADER_FRAGMENT] =
          MAX2(st->state.num_sampler_views[PIPE_SHADER_FRAGMENT], 1);
+      st_invalidate_sampler_views(st, PIPE_SHADER_FRAGMENT);
 
       pipe_sampler_view_release(sampler_view);
 
@@ -437,7 +438,9 @@ st_ReadPixels(struct gl_context *ctx, GLint x, GLint y,
    if (rb->TexImage && st->force_compute_based_texture_transfer)
       goto fallback;
 
-   if (!st->prefer_blit_based_texture_transfer) {
+   if (!st->prefer_blit_based_texture_transfer &&
+       !st_pbo_use_for_transfer(st, pack, rb->Format, format, type,
+                                width, height, 1)) {
       goto fallback;
    }
 
@@ -496,6 +499,10 @@ st_ReadPixels(struct gl_context *ctx, GLint x, GLint y,
          return;
    }
 
+   if (!st->prefer_blit_based_texture_transfer) {
+      goto fallback;
+   }
+
    if (needs_integer_signed_unsigned_conversion(ctx, format, type)) {
       goto fallback;
    }
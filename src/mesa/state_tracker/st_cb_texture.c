@@ -1773,6 +1773,7 @@ try_pbo_upload_common(struct gl_context *ctx,
                               &sampler_view);
       st->state.num_sampler_views[PIPE_SHADER_FRAGMENT] =
          MAX2(st->state.num_sampler_views[PIPE_SHADER_FRAGMENT], 1);
+      st_invalidate_sampler_views(st, PIPE_SHADER_FRAGMENT);
 
       pipe_sampler_view_release(sampler_view);
    }
@@ -2043,6 +2044,9 @@ try_pbo_download(struct st_context *st,
          goto fail;
 
       pipe->set_sampler_views(pipe, PIPE_SHADER_FRAGMENT, 0, 1, 0, &sampler_view);
+      st->state.num_sampler_views[PIPE_SHADER_FRAGMENT] =
+         MAX2(st->state.num_sampler_views[PIPE_SHADER_FRAGMENT], 1);
+      st_invalidate_sampler_views(st, PIPE_SHADER_FRAGMENT);
       pipe->sampler_view_release(pipe, sampler_view);
 
       cso_set_samplers(cso, PIPE_SHADER_FRAGMENT, 1, samplers);
@@ -2195,7 +2199,9 @@ st_TexSubImage(struct gl_context *ctx, GLuint dims,
       return;
    }
 
-   if (!st->prefer_blit_based_texture_transfer) {
+   if (!st->prefer_blit_based_texture_transfer &&
+       !st_pbo_use_for_transfer(st, unpack, texImage->TexFormat, format, type,
+                                width, height, depth)) {
       goto fallback;
    }
 
@@ -2238,6 +2244,10 @@ st_TexSubImage(struct gl_context *ctx, GLuint dims,
          return;
    }
 
+   if (!st->prefer_blit_based_texture_transfer) {
+      goto fallback;
+   }
+
    /* See if the texture format already matches the format and type,
     * in which case the memcpy-based fast path will likely be used and
     * we don't have to blit. */
@@ -2678,6 +2688,8 @@ st_GetTexSubImage(struct gl_context * ctx,
    pipe_target = gl_target_to_pipe(gl_target);
 
    if (!st->prefer_blit_based_texture_transfer &&
+       !st_pbo_use_for_transfer(st, &ctx->Pack, texImage->TexFormat, format,
+                                type, width, height, depth) &&
        !_mesa_is_format_compressed(texImage->TexFormat)) {
       /* Try to avoid the non_blit_transfer if we're doing texture decompression here */
       goto non_blit_transfer;
@@ -2727,6 +2739,10 @@ st_GetTexSubImage(struct gl_context * ctx,
          return;
    }
 
+   if (!st->prefer_blit_based_texture_transfer &&
+       !_mesa_is_format_compressed(texImage->TexFormat))
+      goto non_blit_transfer;
+
    /* See if the texture format already matches the format and type,
     * in which case the memcpy-based fast path will be used. */
    if (_mesa_format_matches_format_and_type(texImage->TexFormat, format,
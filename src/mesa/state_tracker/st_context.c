@@ -357,6 +357,11 @@ st_destroy_context_priv(struct st_context *st, bool destroy_pipe)
    if (st->pipe && destroy_pipe)
       st->pipe->destroy(st->pipe);
 
+   if (st->atom_stats) {
+      st_print_atom_stats(st);
+      FREE(st->atom_stats);
+   }
+
    st->ctx->st = NULL;
    FREE(st);
 }
@@ -478,10 +483,14 @@ st_create_context_priv(struct gl_context *ctx, struct pipe_context *pipe,
 #include "st_atom_list.h"
 #undef ST_STATE
 
+   if (ST_DEBUG & DEBUG_ATOMS)
+      st->atom_stats = CALLOC(ST_NUM_ATOMS, sizeof(*st->atom_stats));
+
    st_init_clear(st);
    {
       enum pipe_texture_transfer_mode val = screen->caps.texture_transfer_modes;
       st->prefer_blit_based_texture_transfer = (val & PIPE_TEXTURE_TRANSFER_BLIT) != 0;
+      st->prefer_pbo_based_texture_transfer = (val & PIPE_TEXTURE_TRANSFER_PBO) != 0;
       st->allow_compute_based_texture_transfer = (val & PIPE_TEXTURE_TRANSFER_COMPUTE) != 0;
    }
    st_init_pbo_helpers(st);
@@ -133,6 +133,12 @@ struct st_context
    /* The list of state update functions. */
    st_update_func_t update_functions[ST_NUM_ATOMS];
 
+   /* Per-atom call counts and CPU time, only allocated with ST_DEBUG=atoms. */
+   struct st_atom_stats {
+      uint64_t calls;
+      uint64_t time_ns;
+   } *atom_stats;
+
    struct pipe_frontend_screen *frontend_screen; /* e.g. dri_screen */
    void *frontend_context; /* e.g. dri_context */
 
@@ -159,6 +165,7 @@ struct st_context
    bool has_latc;
    bool has_bptc;
    bool prefer_blit_based_texture_transfer;
+   bool prefer_pbo_based_texture_transfer;
    bool allow_compute_based_texture_transfer;
    bool force_compute_based_texture_transfer;
    bool force_specialized_compute_transfer;
@@ -228,6 +235,15 @@ struct st_context
       GLuint num_vert_samplers;
       GLuint num_frag_samplers;
       GLuint num_sampler_views[PIPE_SHADER_TYPES];
+      /* The views bound by update_textures in slots below
+       * num_sampler_views, not referenced. The driver keeps bound views
+       * alive, so a pointer match means the slot is unchanged.
+       */
+      struct pipe_sampler_view *sampler_views[PIPE_SHADER_TYPES][PIPE_MAX_SAMPLERS];
+      /* Stages whose views were bound behind update_textures' back (meta
+       * ops), so sampler_views above can't be trusted for them.
+       */
+      unsigned sampler_views_invalid_mask;
       unsigned num_images[PIPE_SHADER_TYPES];
       struct pipe_clip_state clip;
       unsigned constbuf0_enabled_shader_mask;
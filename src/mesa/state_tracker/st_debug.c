@@ -35,6 +35,9 @@
 
 #include "cso_cache/cso_cache.h"
 
+#include "util/os_time.h"
+#include "util/u_qsort.h"
+
 #include "st_context.h"
 #include "st_debug.h"
 #include "st_program.h"
@@ -53,6 +56,7 @@ static const struct debug_named_value st_debug_flags[] = {
    { "gremedy",  DEBUG_GREMEDY, "Enable GREMEDY debug extensions" },
    { "noreadpixcache", DEBUG_NOREADPIXCACHE, NULL },
    { "xfb",      DEBUG_PRINT_XFB, NULL },
+   { "atoms",    DEBUG_ATOMS, "Print the number of calls and CPU time of each state atom at context destruction" },
    DEBUG_NAMED_VALUE_END
 };
 
@@ -64,3 +68,68 @@ st_debug_init(void)
 {
    ST_DEBUG = debug_get_option_st_debug();
 }
+
+
+/**
+ * Like the update loop of st_validate_state, but also counts the calls and
+ * CPU time of each atom.
+ */
+void
+st_validate_state_profiled(struct st_context *st, uint64_t dirty)
+{
+   while (dirty) {
+      unsigned i = u_bit_scan64(&dirty);
+      int64_t start = os_time_get_nano();
+
+      st->update_functions[i](st);
+
+      st->atom_stats[i].time_ns += os_time_get_nano() - start;
+      st->atom_stats[i].calls++;
+   }
+}
+
+
+static const char *st_atom_names[] = {
+#define ST_STATE(FLAG, st_update) #st_update,
+#include "st_atom_list.h"
+#undef ST_STATE
+};
+
+static int
+compare_atom_time(const void *a, const void *b, void *data)
+{
+   const struct st_atom_stats *stats = data;
+   uint64_t time_a = stats[*(const unsigned *)a].time_ns;
+   uint64_t time_b = stats[*(const unsigned *)b].time_ns;
+
+   return time_a < time_b ? 1 : time_a > time_b ? -1 : 0;
+}
+
+/**
+ * Print the atoms that ran, the most expensive first.
+ */
+void
+st_print_atom_stats(struct st_context *st)
+{
+   unsigned order[ST_NUM_ATOMS];
+   uint64_t total_ns = 0;
+
+   for (unsigned i = 0; i < ST_NUM_ATOMS; i++) {
+      order[i] = i;
+      total_ns += st->atom_stats[i].time_ns;
+   }
+   util_qsort_r(order, ST_NUM_ATOMS, sizeof(order[0]), compare_atom_time,
+                st->atom_stats);
+
+   debug_printf("Mesa: state atoms, total %.3f ms:\n", total_ns / 1e6);
+   for (unsigned i = 0; i < ST_NUM_ATOMS; i++) {
+      const struct st_atom_stats *stats = &st->atom_stats[order[i]];
+
+      if (!stats->calls)
+         continue;
+
+      debug_printf("  %-32s %10"PRIu64" calls %10.3f ms %8.0f ns/call\n",
+                   st_atom_names[order[i]], stats->calls, stats->time_ns / 1e6,
+                   (double)stats->time_ns / stats->calls);
+   }
+}
@@ -42,11 +42,16 @@ struct st_context;
 #define DEBUG_GREMEDY         BITFIELD_BIT(5)
 #define DEBUG_NOREADPIXCACHE  BITFIELD_BIT(6)
 #define DEBUG_PRINT_XFB       BITFIELD_BIT(7)
+#define DEBUG_ATOMS           BITFIELD_BIT(8)
 
 extern int ST_DEBUG;
 
 void st_debug_init( void );
 
+void st_validate_state_profiled(struct st_context *st, uint64_t dirty);
+
+void st_print_atom_stats(struct st_context *st);
+
 static inline void
 ST_DBG( unsigned flag, const char *fmt, ... )
 {
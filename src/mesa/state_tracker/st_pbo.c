@@ -159,6 +159,22 @@ st_pbo_addresses_pixelstore(struct st_context *st,
    return true;
 }
 
+/* Whether a transfer between a texture and the pixel buffer object bound
+ * to packing should use the PBO paths on a driver that only prefers them for
+ * PBOs. Transfers that don't need a conversion are a memcpy on the CPU.
+ */
+bool
+st_pbo_use_for_transfer(const struct st_context *st,
+                        const struct gl_pixelstore_attrib *packing,
+                        mesa_format tex_format, GLenum format, GLenum type,
+                        unsigned width, unsigned height, unsigned depth)
+{
+   return st->prefer_pbo_based_texture_transfer && packing->BufferObj &&
+          (uint64_t)width * height * depth >= ST_PBO_TRANSFER_MIN_PIXELS &&
+          !_mesa_format_matches_format_and_type(tex_format, format, type,
+                                                packing->SwapBytes, NULL);
+}
+
 /* For download from a framebuffer, we may have to invert the Y axis. The
  * setup is as follows:
  * - set viewport to inverted, so that the position sysval is correct for
@@ -72,6 +72,19 @@ enum st_pbo_conversion {
 const struct glsl_type *
 st_pbo_sampler_type_for_target(enum pipe_texture_target target,
                                enum st_pbo_conversion conv);
+
+/* Smallest transfer that PIPE_TEXTURE_TRANSFER_PBO moves with a draw. That
+ * is one 64x64 llvmpipe tile: below it the draw is rasterized by a single
+ * thread, so it only adds setup and scene flush overhead to the CPU path.
+ */
+#define ST_PBO_TRANSFER_MIN_PIXELS (64 * 64)
+
+bool
+st_pbo_use_for_transfer(const struct st_context *st,
+                        const struct gl_pixelstore_attrib *packing,
+                        mesa_format tex_format, GLenum format, GLenum type,
+                        unsigned width, unsigned height, unsigned depth);
+
 bool
 st_pbo_addresses_setup(struct st_context *st,
                        struct pipe_resource *buf, intptr_t buf_offset,
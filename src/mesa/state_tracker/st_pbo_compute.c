@@ -1115,6 +1115,7 @@ download_texture_compute(struct st_context *st,
                               &sampler_view);
       st->state.num_sampler_views[PIPE_SHADER_COMPUTE] =
          MAX2(st->state.num_sampler_views[PIPE_SHADER_COMPUTE], 1);
+      st_invalidate_sampler_views(st, PIPE_SHADER_COMPUTE);
 
       cso_set_samplers(cso, PIPE_SHADER_COMPUTE, 1, samplers);
    }
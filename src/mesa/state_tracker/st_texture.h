@@ -259,6 +259,35 @@ st_get_sampler_views(struct st_context *st,
                      struct pipe_sampler_view **sampler_views,
                      unsigned *num_owned_views);
 
+/**
+ * Compute the range [first, last) of slots that have to be set to bind
+ * views[0..num) over the bound[0..num_bound) views. Trailing slots are
+ * unbound after the last slot that is set, so all slots are set when
+ * num < num_bound, and also when bound can't be trusted.
+ */
+static inline void
+st_changed_sampler_views(struct pipe_sampler_view **views, unsigned num,
+                         struct pipe_sampler_view **bound, unsigned num_bound,
+                         bool bound_invalid,
+                         unsigned *first, unsigned *last)
+{
+   *first = 0;
+   *last = num;
+
+   if (num < num_bound || bound_invalid)
+      return;
+
+   while (*first < num_bound && views[*first] == bound[*first])
+      (*first)++;
+   while (*last > *first && *last <= num_bound &&
+          views[*last - 1] == bound[*last - 1])
+      (*last)--;
+}
+
+void
+st_invalidate_sampler_views(struct st_context *st,
+                            enum pipe_shader_type shader_stage);
+
 void
 st_make_bound_samplers_resident(struct st_context *st,
                                 struct gl_program *prog);
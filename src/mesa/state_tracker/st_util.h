@@ -36,6 +36,7 @@
 
 
 #include "state_tracker/st_context.h"
+#include "state_tracker/st_debug.h"
 #include "main/context.h"
 
 
@@ -118,6 +119,11 @@ st_validate_state(struct st_context *st, uint64_t pipeline_state_mask)
    if (dirty) {
       ctx->NewDriverState &= ~dirty;
 
+      if (unlikely(st->atom_stats)) {
+         st_validate_state_profiled(st, dirty);
+         return;
+      }
+
       /* Execute functions that set states that have been changed since
        * the last draw.
        *
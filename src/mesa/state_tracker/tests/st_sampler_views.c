@@ -0,0 +1,66 @@
+/*
+ * Copyright © 2026 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Checks which slots update_textures rebinds, including after a meta op
+ * (glDrawPixels, glBitmap, PBO or compute paths) bound its own views.
+ */
+
+#include <stdio.h>
+
+#include "pipe/p_state.h"
+#include "state_tracker/st_texture.h"
+
+static struct pipe_sampler_view views[4];
+#define A (&views[0])
+#define B (&views[1])
+#define C (&views[2])
+#define META (&views[3])
+
+static int
+check(const char *name, struct pipe_sampler_view **new_views, unsigned num,
+      struct pipe_sampler_view **bound, unsigned num_bound, bool invalid,
+      unsigned expected_first, unsigned expected_last)
+{
+   unsigned first, last;
+
+   st_changed_sampler_views(new_views, num, bound, num_bound, invalid,
+                            &first, &last);
+   if (first != expected_first || last != expected_last) {
+      fprintf(stderr, "%s: got [%u, %u), expected [%u, %u)\n", name,
+              first, last, expected_first, expected_last);
+      return 1;
+   }
+   return 0;
+}
+
+int main(int argc, char **argv)
+{
+   struct pipe_sampler_view *bound[] = { A, B, C };
+   int fail = 0;
+
+   fail |= check("unchanged", (struct pipe_sampler_view *[]){ A, B, C }, 3,
+                 bound, 3, false, 3, 3);
+   fail |= check("middle changed", (struct pipe_sampler_view *[]){ A, C, C }, 3,
+                 bound, 3, false, 1, 2);
+   fail |= check("grown", (struct pipe_sampler_view *[]){ A, B, C, A }, 4,
+                 bound, 3, false, 3, 4);
+   fail |= check("shrunk", (struct pipe_sampler_view *[]){ A, B }, 2,
+                 bound, 3, false, 0, 2);
+   fail |= check("unbound slot", (struct pipe_sampler_view *[]){ A, NULL, C }, 3,
+                 bound, 3, false, 1, 2);
+
+   /* A meta op bound META in slot 0 and then unbound all slots without
+    * going through update_textures. The next textured draw binds the same
+    * views as before, which must not be skipped.
+    */
+   fail |= check("after meta op", (struct pipe_sampler_view *[]){ A, B, C }, 3,
+                 bound, 3, true, 0, 3);
+   fail |= check("after meta op, unbound slot",
+                 (struct pipe_sampler_view *[]){ A, NULL, C }, 3,
+                 bound, 3, true, 0, 3);
+
+   return fail;
+}
@@ -32,6 +32,7 @@
 #include "main/varray.h"
 #include "main/macros.h"
 #include "main/sse_minmax.h"
+#include "util/bitset.h"
 #include "util/hash_table.h"
 #include "util/u_memory.h"
 #include "pipe/p_state.h"
@@ -40,6 +41,34 @@ struct minmax_cache_key {
    GLintptr offset;
    GLuint count;
    unsigned index_size;
+   unsigned restart_index;
+   bool restart;
+};
+
+/* Size of the blocks of the index buffer summarized by the block tree. */
+#define MINMAX_BLOCK_SIZE 4096
+
+/**
+ * Min/max summary of the blocks of an index buffer for one index size and
+ * restart index, used to answer queries that miss the exact cache without
+ * rescanning whole ranges.
+ *
+ * It's a segment tree over the blocks of the buffer, node 1 being the root
+ * and the leaves being the blocks. Nodes are computed lazily when queries
+ * go through them.
+ */
+struct vbo_minmax_block_tree {
+   unsigned index_size;
+   unsigned restart_index;
+   bool restart;
+
+   unsigned num_blocks;
+   unsigned num_leaves;    /* num_blocks rounded up to a power of two */
+   BITSET_WORD *valid;
+   struct {
+      GLuint min;
+      GLuint max;
+   } *nodes;
 };
 
 
@@ -53,7 +82,15 @@ struct minmax_cache_entry {
 static uint32_t
 vbo_minmax_cache_hash(const struct minmax_cache_key *key)
 {
-   return _mesa_hash_data(key, sizeof(*key));
+   uint32_t hash = _mesa_hash_data(&key->offset, sizeof(key->offset));
+   hash = _mesa_hash_data_with_seed(&key->count, sizeof(key->count), hash);
+   hash = _mesa_hash_data_with_seed(&key->index_size, sizeof(key->index_size),
+                                    hash);
+   if (key->restart) {
+      hash = _mesa_hash_data_with_seed(&key->restart_index,
+                                       sizeof(key->restart_index), hash);
+   }
+   return hash;
 }
 
 
@@ -62,7 +99,8 @@ vbo_minmax_cache_key_equal(const struct minmax_cache_key *a,
                            const struct minmax_cache_key *b)
 {
    return (a->offset == b->offset) && (a->count == b->count) &&
-          (a->index_size == b->index_size);
+          (a->index_size == b->index_size) && (a->restart == b->restart) &&
+          (!a->restart || a->restart_index == b->restart_index);
 }
 
 
@@ -93,17 +131,101 @@ vbo_use_minmax_cache(struct gl_buffer_object *bufferObj)
 }
 
 
+static void
+vbo_minmax_block_tree_destroy(struct vbo_minmax_block_tree *tree)
+{
+   if (tree) {
+      free(tree->valid);
+      free(tree->nodes);
+      free(tree);
+   }
+}
+
+
 void
 vbo_delete_minmax_cache(struct gl_buffer_object *bufferObj)
 {
    _mesa_hash_table_destroy(bufferObj->MinMaxCache, vbo_minmax_cache_delete_entry);
    bufferObj->MinMaxCache = NULL;
+   vbo_minmax_block_tree_destroy(bufferObj->MinMaxBlockTree);
+   bufferObj->MinMaxBlockTree = NULL;
+}
+
+
+/**
+ * Invalidates the caches if the buffer was modified. Returns false if the
+ * caches were disabled.
+ *
+ * Called with the MinMaxCacheMutex held.
+ */
+static bool
+vbo_minmax_cache_validate(struct gl_buffer_object *bufferObj)
+{
+   if (!bufferObj->MinMaxCacheDirty)
+      return true;
+
+   /* Disable the cache permanently for this BO if the number of hits
+    * is asymptotically less than the number of misses. This happens when
+    * applications use the BO for streaming.
+    *
+    * However, some initial optimism allows applications that interleave
+    * draw calls with glBufferSubData during warmup.
+    */
+   unsigned optimism = bufferObj->Size;
+   if (bufferObj->MinMaxCacheMissIndices > optimism &&
+       bufferObj->MinMaxCacheHitIndices < bufferObj->MinMaxCacheMissIndices - optimism) {
+      bufferObj->UsageHistory |= USAGE_DISABLE_MINMAX_CACHE;
+      vbo_delete_minmax_cache(bufferObj);
+      return false;
+   }
+
+   if (bufferObj->MinMaxCache)
+      _mesa_hash_table_clear(bufferObj->MinMaxCache, vbo_minmax_cache_delete_entry);
+
+   struct vbo_minmax_block_tree *tree = bufferObj->MinMaxBlockTree;
+   if (tree)
+      memset(tree->valid, 0, BITSET_WORDS(tree->num_leaves * 2) * sizeof(BITSET_WORD));
+
+   bufferObj->MinMaxCacheDirty = false;
+   return true;
+}
+
+
+static void
+vbo_minmax_cache_count(struct gl_buffer_object *bufferObj,
+                       unsigned hit_count, unsigned miss_count)
+{
+   /* The hit counter saturates so that we don't accidently disable the
+    * cache in a long-running program.
+    */
+   unsigned new_hit_count = bufferObj->MinMaxCacheHitIndices + hit_count;
+
+   if (new_hit_count >= bufferObj->MinMaxCacheHitIndices)
+      bufferObj->MinMaxCacheHitIndices = new_hit_count;
+   else
+      bufferObj->MinMaxCacheHitIndices = ~(unsigned)0;
+
+   bufferObj->MinMaxCacheMissIndices += miss_count;
+}
+
+
+static void
+vbo_minmax_cache_init_key(struct minmax_cache_key *key, unsigned index_size,
+                          GLintptr offset, GLuint count, bool restart,
+                          unsigned restart_index)
+{
+   key->offset = offset;
+   key->count = count;
+   key->index_size = index_size;
+   key->restart = restart;
+   key->restart_index = restart ? restart_index : 0;
 }
 
 
 static GLboolean
 vbo_get_minmax_cached(struct gl_buffer_object *bufferObj,
                       unsigned index_size, GLintptr offset, GLuint count,
+                      bool restart, unsigned restart_index,
                       GLuint *min_index, GLuint *max_index)
 {
    GLboolean found = GL_FALSE;
@@ -119,29 +241,13 @@ vbo_get_minmax_cached(struct gl_buffer_object *bufferObj,
    simple_mtx_lock(&bufferObj->MinMaxCacheMutex);
 
    if (bufferObj->MinMaxCacheDirty) {
-      /* Disable the cache permanently for this BO if the number of hits
-       * is asymptotically less than the number of misses. This happens when
-       * applications use the BO for streaming.
-       *
-       * However, some initial optimism allows applications that interleave
-       * draw calls with glBufferSubData during warmup.
-       */
-      unsigned optimism = bufferObj->Size;
-      if (bufferObj->MinMaxCacheMissIndices > optimism &&
-          bufferObj->MinMaxCacheHitIndices < bufferObj->MinMaxCacheMissIndices - optimism) {
-         bufferObj->UsageHistory |= USAGE_DISABLE_MINMAX_CACHE;
-         vbo_delete_minmax_cache(bufferObj);
-         goto out_disable;
-      }
-
-      _mesa_hash_table_clear(bufferObj->MinMaxCache, vbo_minmax_cache_delete_entry);
-      bufferObj->MinMaxCacheDirty = false;
-      goto out_invalidate;
+      /* The misses are counted when the indices are scanned. */
+      vbo_minmax_cache_validate(bufferObj);
+      goto out;
    }
 
-   key.index_size = index_size;
-   key.offset = offset;
-   key.count = count;
+   vbo_minmax_cache_init_key(&key, index_size, offset, count, restart,
+                             restart_index);
    hash = vbo_minmax_cache_hash(&key);
    result = _mesa_hash_table_search_pre_hashed(bufferObj->MinMaxCache, hash, &key);
    if (result) {
@@ -149,24 +255,10 @@ vbo_get_minmax_cached(struct gl_buffer_object *bufferObj,
       *min_index = entry->min;
       *max_index = entry->max;
       found = GL_TRUE;
+      vbo_minmax_cache_count(bufferObj, count, 0);
    }
 
-out_invalidate:
-   if (found) {
-      /* The hit counter saturates so that we don't accidently disable the
-       * cache in a long-running program.
-       */
-      unsigned new_hit_count = bufferObj->MinMaxCacheHitIndices + count;
-
-      if (new_hit_count >= bufferObj->MinMaxCacheHitIndices)
-         bufferObj->MinMaxCacheHitIndices = new_hit_count;
-      else
-         bufferObj->MinMaxCacheHitIndices = ~(unsigned)0;
-   } else {
-      bufferObj->MinMaxCacheMissIndices += count;
-   }
-
-out_disable:
+out:
    simple_mtx_unlock(&bufferObj->MinMaxCacheMutex);
    return found;
 }
@@ -176,6 +268,7 @@ static void
 vbo_minmax_cache_store(struct gl_context *ctx,
                        struct gl_buffer_object *bufferObj,
                        unsigned index_size, GLintptr offset, GLuint count,
+                       bool restart, unsigned restart_index,
                        GLuint min, GLuint max)
 {
    struct minmax_cache_entry *entry;
@@ -200,9 +293,8 @@ vbo_minmax_cache_store(struct gl_context *ctx,
    if (!entry)
       goto out;
 
-   entry->key.offset = offset;
-   entry->key.count = count;
-   entry->key.index_size = index_size;
+   vbo_minmax_cache_init_key(&entry->key, index_size, offset, count, restart,
+                             restart_index);
    entry->min = min;
    entry->max = max;
    hash = vbo_minmax_cache_hash(&entry->key);
@@ -234,6 +326,21 @@ vbo_get_minmax_index_mapped(unsigned count, unsigned index_size,
                             const void *indices,
                             unsigned *min_index, unsigned *max_index)
 {
+#if defined(USE_AVX2)
+   if (util_get_cpu_caps()->has_avx2) {
+      _mesa_index_array_min_max_avx2(indices, count, index_size, restart,
+                                     restartIndex, min_index, max_index);
+      return;
+   }
+#endif
+#if defined(USE_SSE41)
+   if (util_get_cpu_caps()->has_sse4_1) {
+      _mesa_index_array_min_max_sse41(indices, count, index_size, restart,
+                                      restartIndex, min_index, max_index);
+      return;
+   }
+#endif
+
    switch (index_size) {
    case 4: {
       const GLuint *ui_indices = (const GLuint *)indices;
@@ -248,16 +355,10 @@ vbo_get_minmax_index_mapped(unsigned count, unsigned index_size,
          }
       }
       else {
-#if defined(USE_SSE41)
-         if (util_get_cpu_caps()->has_sse4_1) {
-            _mesa_uint_array_min_max(ui_indices, &min_ui, &max_ui, count);
+         for (unsigned i = 0; i < count; i++) {
+            if (ui_indices[i] > max_ui) max_ui = ui_indices[i];
+            if (ui_indices[i] < min_ui) min_ui = ui_indices[i];
          }
-         else
-#endif
-            for (unsigned i = 0; i < count; i++) {
-               if (ui_indices[i] > max_ui) max_ui = ui_indices[i];
-               if (ui_indices[i] < min_ui) min_ui = ui_indices[i];
-            }
       }
       *min_index = min_ui;
       *max_index = max_ui;
@@ -313,6 +414,187 @@ vbo_get_minmax_index_mapped(unsigned count, unsigned index_size,
 }
 
 
+static struct vbo_minmax_block_tree *
+vbo_get_minmax_block_tree(struct gl_buffer_object *bufferObj,
+                          unsigned index_size, bool restart,
+                          unsigned restart_index)
+{
+   struct vbo_minmax_block_tree *tree = bufferObj->MinMaxBlockTree;
+   unsigned num_blocks = bufferObj->Size / MINMAX_BLOCK_SIZE;
+
+   restart_index = restart ? restart_index : 0;
+
+   if (tree && tree->index_size == index_size && tree->restart == restart &&
+       tree->restart_index == restart_index && tree->num_blocks == num_blocks)
+      return tree;
+
+   /* Only one index size and restart index is summarized at a time. */
+   vbo_minmax_block_tree_destroy(tree);
+   bufferObj->MinMaxBlockTree = NULL;
+
+   tree = CALLOC_STRUCT(vbo_minmax_block_tree);
+   if (!tree)
+      return NULL;
+
+   tree->index_size = index_size;
+   tree->restart = restart;
+   tree->restart_index = restart_index;
+   tree->num_blocks = num_blocks;
+   tree->num_leaves = util_next_power_of_two(num_blocks);
+   tree->valid = calloc(BITSET_WORDS(tree->num_leaves * 2), sizeof(BITSET_WORD));
+   tree->nodes = malloc(tree->num_leaves * 2 * sizeof(*tree->nodes));
+   if (!tree->valid || !tree->nodes) {
+      vbo_minmax_block_tree_destroy(tree);
+      return NULL;
+   }
+
+   bufferObj->MinMaxBlockTree = tree;
+   return tree;
+}
+
+
+/**
+ * Returns the min/max of the blocks [lo, hi) of the tree node, computing
+ * it if needed. The blocks must be inside of the mapped range.
+ */
+static void
+vbo_minmax_block_tree_get(struct vbo_minmax_block_tree *tree,
+                          const char *indices, GLintptr offset,
+                          unsigned node, unsigned lo, unsigned hi,
+                          GLuint *min_index, GLuint *max_index,
+                          unsigned *scanned)
+{
+   if (!BITSET_TEST(tree->valid, node)) {
+      GLuint min, max;
+
+      if (hi - lo == 1) {
+         unsigned count = MINMAX_BLOCK_SIZE / tree->index_size;
+
+         vbo_get_minmax_index_mapped(count, tree->index_size,
+                                     tree->restart_index, tree->restart,
+                                     indices + (GLintptr)lo * MINMAX_BLOCK_SIZE - offset,
+                                     &min, &max);
+         *scanned += count;
+      } else {
+         unsigned mid = (lo + hi) / 2;
+         GLuint min2, max2;
+
+         vbo_minmax_block_tree_get(tree, indices, offset, node * 2, lo, mid,
+                                   &min, &max, scanned);
+         vbo_minmax_block_tree_get(tree, indices, offset, node * 2 + 1, mid,
+                                   hi, &min2, &max2, scanned);
+         min = MIN2(min, min2);
+         max = MAX2(max, max2);
+      }
+
+      tree->nodes[node].min = min;
+      tree->nodes[node].max = max;
+      BITSET_SET(tree->valid, node);
+   }
+
+   *min_index = tree->nodes[node].min;
+   *max_index = tree->nodes[node].max;
+}
+
+
+/**
+ * Accumulates the min/max of the blocks [qlo, qhi) into min_index and
+ * max_index, node covering the blocks [lo, hi).
+ */
+static void
+vbo_minmax_block_tree_query(struct vbo_minmax_block_tree *tree,
+                            const char *indices, GLintptr offset,
+                            unsigned node, unsigned lo, unsigned hi,
+                            unsigned qlo, unsigned qhi,
+                            GLuint *min_index, GLuint *max_index,
+                            unsigned *scanned)
+{
+   if (qhi <= lo || hi <= qlo)
+      return;
+
+   if (qlo <= lo && hi <= qhi) {
+      GLuint min, max;
+
+      vbo_minmax_block_tree_get(tree, indices, offset, node, lo, hi,
+                                &min, &max, scanned);
+      *min_index = MIN2(*min_index, min);
+      *max_index = MAX2(*max_index, max);
+      return;
+   }
+
+   unsigned mid = (lo + hi) / 2;
+   vbo_minmax_block_tree_query(tree, indices, offset, node * 2, lo, mid,
+                               qlo, qhi, min_index, max_index, scanned);
+   vbo_minmax_block_tree_query(tree, indices, offset, node * 2 + 1, mid, hi,
+                               qlo, qhi, min_index, max_index, scanned);
+}
+
+
+/**
+ * Computes the min/max of the mapped indices of a buffer object. The parts
+ * of the range covering whole blocks are answered by the block tree, only
+ * the parts of blocks at both ends and the blocks that were never computed
+ * are scanned.
+ */
+static void
+vbo_get_minmax_index_blocks(struct gl_buffer_object *obj,
+                            const char *indices, GLintptr offset,
+                            unsigned count, unsigned index_size,
+                            bool restart, unsigned restart_index,
+                            GLuint *min_index, GLuint *max_index)
+{
+   uint64_t end = offset + (uint64_t)count * index_size;
+   uint64_t first_block = DIV_ROUND_UP(offset, MINMAX_BLOCK_SIZE);
+   uint64_t last_block = end / MINMAX_BLOCK_SIZE;
+   struct vbo_minmax_block_tree *tree;
+
+   if (first_block >= last_block || offset % index_size ||
+       end > obj->Size || !vbo_use_minmax_cache(obj))
+      goto scan;
+
+   simple_mtx_lock(&obj->MinMaxCacheMutex);
+
+   if (!vbo_minmax_cache_validate(obj) ||
+       !(tree = vbo_get_minmax_block_tree(obj, index_size, restart,
+                                          restart_index))) {
+      simple_mtx_unlock(&obj->MinMaxCacheMutex);
+      goto scan;
+   }
+
+   unsigned head = (first_block * MINMAX_BLOCK_SIZE - offset) / index_size;
+   unsigned tail = (last_block * MINMAX_BLOCK_SIZE - offset) / index_size;
+   unsigned scanned = head + (count - tail);
+   GLuint min, max;
+
+   vbo_get_minmax_index_mapped(head, index_size, restart_index, restart,
+                               indices, min_index, max_index);
+
+   vbo_minmax_block_tree_query(tree, indices, offset, 1, 0, tree->num_leaves,
+                               first_block, last_block, min_index, max_index,
+                               &scanned);
+
+   vbo_get_minmax_index_mapped(count - tail, index_size, restart_index,
+                               restart, indices + tail * index_size,
+                               &min, &max);
+   *min_index = MIN2(*min_index, min);
+   *max_index = MAX2(*max_index, max);
+
+   vbo_minmax_cache_count(obj, count - MIN2(scanned, count), scanned);
+   simple_mtx_unlock(&obj->MinMaxCacheMutex);
+   return;
+
+scan:
+   vbo_get_minmax_index_mapped(count, index_size, restart_index, restart,
+                               indices, min_index, max_index);
+
+   if (vbo_use_minmax_cache(obj)) {
+      simple_mtx_lock(&obj->MinMaxCacheMutex);
+      vbo_minmax_cache_count(obj, 0, count);
+      simple_mtx_unlock(&obj->MinMaxCacheMutex);
+   }
+}
+
+
 /**
  * Compute min and max elements by scanning the index buffer for
  * glDraw[Range]Elements() calls.
@@ -333,23 +615,27 @@ vbo_get_minmax_index(struct gl_context *ctx, struct gl_buffer_object *obj,
    } else {
       GLsizeiptr size = MIN2((GLsizeiptr)count * index_size, obj->Size);
 
-      if (vbo_get_minmax_cached(obj, index_size, offset, count, min_index,
-                                max_index))
+      if (vbo_get_minmax_cached(obj, index_size, offset, count,
+                                primitive_restart, restart_index,
+                                min_index, max_index))
          return;
 
       indices = _mesa_bufferobj_map_range(ctx, offset, size, GL_MAP_READ_BIT,
                                           obj, MAP_INTERNAL);
+
+      vbo_get_minmax_index_blocks(obj, indices, offset, count, index_size,
+                                  primitive_restart, restart_index,
+                                  min_index, max_index);
+      vbo_minmax_cache_store(ctx, obj, index_size, offset, count,
+                             primitive_restart, restart_index,
+                             *min_index, *max_index);
+      _mesa_bufferobj_unmap(ctx, obj, MAP_INTERNAL);
+      return;
    }
 
    vbo_get_minmax_index_mapped(count, index_size, restart_index,
                                primitive_restart, indices,
                                min_index, max_index);
-
-   if (obj) {
-      vbo_minmax_cache_store(ctx, obj, index_size, offset, count, *min_index,
-                             *max_index);
-      _mesa_bufferobj_unmap(ctx, obj, MAP_INTERNAL);
-   }
 }
 
 /**
@@ -65,6 +65,11 @@ struct vbo_save_vertex_list {
    };
    uint8_t mode;
    bool draw_begins;
+   /* Number of consecutive vertex lists starting with this one that have
+    * the same enabled attribs, so that state is validated only once for all
+    * of them. 0 if this doesn't start such a run.
+    */
+   uint8_t run_length;
 
    int16_t private_refcount[VP_MODE_MAX];
    struct gl_context *ctx;
@@ -119,6 +124,11 @@ _vbo_save_get_stride(const struct vbo_save_vertex_list *node)
 #define VBO_SAVE_BUFFER_SIZE (1024 * 1024)
 #define VBO_SAVE_PRIM_MODE_MASK 0x3f
 
+/* The maximum number of vertex lists drawn by one call of
+ * vbo_save_playback_vertex_lists.
+ */
+#define VBO_SAVE_MAX_RUN_LENGTH 16
+
 struct vbo_save_vertex_store {
    fi_type *buffer_in_ram;
    GLuint buffer_in_ram_size;
@@ -146,6 +156,11 @@ void _vbo_loopback_vertex_list(struct gl_context *ctx,
 void
 vbo_save_playback_vertex_list(struct gl_context *ctx, void *data, bool copy_to_current);
 
+void
+vbo_save_playback_vertex_lists(struct gl_context *ctx,
+                               const struct vbo_save_vertex_list **nodes,
+                               unsigned num_nodes, bool copy_to_current);
+
 void
 vbo_save_playback_vertex_list_loopback(struct gl_context *ctx, void *data);
 
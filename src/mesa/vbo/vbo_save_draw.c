@@ -192,48 +192,11 @@ enum vbo_save_status {
    USE_SLOW_PATH,
 };
 
-static enum vbo_save_status
-vbo_save_playback_vertex_list_gallium(struct gl_context *ctx,
-                                      const struct vbo_save_vertex_list *node,
-                                      bool copy_to_current)
+static void
+draw_vertex_state(struct gl_context *ctx,
+                  const struct vbo_save_vertex_list *node,
+                  gl_vertex_processing_mode mode, uint32_t velem_mask)
 {
-   /* Don't use this if selection or feedback mode is enabled. st/mesa can't
-    * handle it.
-    */
-   if (!ctx->Const.HasDrawVertexState || ctx->RenderMode != GL_RENDER)
-      return USE_SLOW_PATH;
-
-   const gl_vertex_processing_mode mode = ctx->VertexProgram._VPMode;
-
-   /* This sets which vertex arrays are enabled, which determines
-    * which attribs have stride = 0 and whether edge flags are enabled.
-    */
-   const GLbitfield enabled = node->enabled_attribs[mode];
-   _mesa_set_varying_vp_inputs(ctx, enabled);
-
-   if (ctx->NewState)
-      _mesa_update_state(ctx);
-
-   /* Return precomputed GL errors such as invalid shaders. */
-   if (!ctx->ValidPrimMask) {
-      _mesa_error(ctx, ctx->DrawGLError, "glCallList");
-      return DONE;
-   }
-
-   /* Use the slow path when there are vertex inputs without vertex
-    * elements. This happens with zero-stride attribs and non-fixed-func
-    * shaders.
-    *
-    * Dual-slot inputs are also unsupported because the higher slot is
-    * always missing in vertex elements.
-    *
-    * TODO: Add support for zero-stride attribs.
-    */
-   struct gl_program *vp = ctx->VertexProgram._Current;
-
-   if (vp->info.inputs_read & ~enabled || vp->DualSlotInputs)
-      return USE_SLOW_PATH;
-
    struct pipe_vertex_state *state = node->state[mode];
    struct pipe_draw_vertex_state_info info;
 
@@ -278,13 +241,7 @@ vbo_save_playback_vertex_list_gallium(struct gl_context *ctx,
       info.take_vertex_state_ownership = true;
    }
 
-   /* Set edge flags. */
-   _mesa_update_edgeflag_state_explicit(ctx, enabled & VERT_BIT_EDGEFLAG);
-
-   st_prepare_draw(ctx, ST_PIPELINE_RENDER_STATE_MASK_NO_VARRAYS);
-
    struct pipe_context *pipe = ctx->pipe;
-   uint32_t velem_mask = ctx->VertexProgram._Current->info.inputs_read;
 
    /* Fast path using a pre-built gallium vertex buffer state. */
    if (node->modes || node->num_draws > 1) {
@@ -317,12 +274,71 @@ vbo_save_playback_vertex_list_gallium(struct gl_context *ctx,
       pipe->draw_vertex_state(pipe, state, velem_mask, info,
                               &node->start_count, 1);
    }
+}
+
+/* Draw vertex lists that have the same enabled attribs, validating state
+ * only once.
+ */
+static enum vbo_save_status
+vbo_save_playback_vertex_list_gallium(struct gl_context *ctx,
+                                      const struct vbo_save_vertex_list **nodes,
+                                      unsigned num_nodes,
+                                      bool copy_to_current)
+{
+   /* Don't use this if selection or feedback mode is enabled. st/mesa can't
+    * handle it.
+    */
+   if (!ctx->Const.HasDrawVertexState || ctx->RenderMode != GL_RENDER)
+      return USE_SLOW_PATH;
+
+   const gl_vertex_processing_mode mode = ctx->VertexProgram._VPMode;
+
+   /* This sets which vertex arrays are enabled, which determines
+    * which attribs have stride = 0 and whether edge flags are enabled.
+    */
+   const GLbitfield enabled = nodes[0]->enabled_attribs[mode];
+   _mesa_set_varying_vp_inputs(ctx, enabled);
+
+   if (ctx->NewState)
+      _mesa_update_state(ctx);
+
+   /* Return precomputed GL errors such as invalid shaders. */
+   if (!ctx->ValidPrimMask) {
+      _mesa_error(ctx, ctx->DrawGLError, "glCallList");
+      return DONE;
+   }
+
+   /* Use the slow path when there are vertex inputs without vertex
+    * elements. This happens with zero-stride attribs and non-fixed-func
+    * shaders.
+    *
+    * Dual-slot inputs are also unsupported because the higher slot is
+    * always missing in vertex elements.
+    *
+    * TODO: Add support for zero-stride attribs.
+    */
+   struct gl_program *vp = ctx->VertexProgram._Current;
+
+   if (vp->info.inputs_read & ~enabled || vp->DualSlotInputs)
+      return USE_SLOW_PATH;
+
+   /* Set edge flags. */
+   _mesa_update_edgeflag_state_explicit(ctx, enabled & VERT_BIT_EDGEFLAG);
+
+   st_prepare_draw(ctx, ST_PIPELINE_RENDER_STATE_MASK_NO_VARRAYS);
+
+   uint32_t velem_mask = ctx->VertexProgram._Current->info.inputs_read;
+
+   for (unsigned i = 0; i < num_nodes; i++) {
+      assert(nodes[i]->enabled_attribs[mode] == enabled);
+      draw_vertex_state(ctx, nodes[i], mode, velem_mask);
+   }
 
    /* Restore edge flag state and ctx->VertexProgram._VaryingInputs. */
    _mesa_update_edgeflag_state_vao(ctx);
 
    if (copy_to_current)
-      playback_copy_to_current(ctx, node);
+      playback_copy_to_current(ctx, nodes[num_nodes - 1]);
    return DONE;
 }
 
@@ -348,7 +364,8 @@ vbo_save_playback_vertex_list(struct gl_context *ctx, void *data, bool copy_to_c
       return;
    }
 
-   if (vbo_save_playback_vertex_list_gallium(ctx, node, copy_to_current) == DONE)
+   if (vbo_save_playback_vertex_list_gallium(ctx, &node, 1,
+                                             copy_to_current) == DONE)
       return;
 
    /* Save the Draw VAO before we override it. */
@@ -396,3 +413,28 @@ vbo_save_playback_vertex_list(struct gl_context *ctx, void *data, bool copy_to_c
    if (copy_to_current)
       playback_copy_to_current(ctx, node);
 }
+
+
+/**
+ * Execute consecutive vertex lists from the same display list that have
+ * the same enabled attribs. If "copy_to_current" is true, the last one
+ * updates the current attribs.
+ */
+void
+vbo_save_playback_vertex_lists(struct gl_context *ctx,
+                               const struct vbo_save_vertex_list **nodes,
+                               unsigned num_nodes, bool copy_to_current)
+{
+   FLUSH_FOR_DRAW(ctx);
+
+   /* Let the slow path report errors. */
+   if (!_mesa_inside_begin_end(ctx) &&
+       vbo_save_playback_vertex_list_gallium(ctx, nodes, num_nodes,
+                                             copy_to_current) == DONE)
+      return;
+
+   for (unsigned i = 0; i < num_nodes; i++) {
+      vbo_save_playback_vertex_list(ctx, (void *)nodes[i],
+                                    copy_to_current && i == num_nodes - 1);
+   }
+}
@@ -36,8 +36,12 @@
 
 #ifdef HAVE_ZSTD
 #include "zstd.h"
+#include "zdict.h"
 #endif
 
+#include <stdlib.h>
+
+#include "c11/threads.h"
 #include "util/compress.h"
 #include "util/perf/cpu_trace.h"
 #include "macros.h"
@@ -45,6 +49,102 @@
 /* 3 is the recomended level, with 22 as the absolute maximum */
 #define ZSTD_COMPRESSION_LEVEL 3
 
+#ifdef HAVE_ZSTD
+struct util_compress_dict {
+   ZSTD_CDict *cdict;
+   ZSTD_DDict *ddict;
+   uint32_t id;
+};
+
+/* Creating a zstd context allocates a few hundred KB of tables, so the
+ * dictionary helpers keep one of each kind per thread instead of setting
+ * them up for every entry. They are freed when the thread exits.
+ */
+static tss_t zstd_cctx_key;
+static tss_t zstd_dctx_key;
+static once_flag zstd_ctx_once = ONCE_FLAG_INIT;
+static bool zstd_ctx_keys_valid;
+
+static void
+free_zstd_cctx(void *cctx)
+{
+   ZSTD_freeCCtx(cctx);
+}
+
+static void
+free_zstd_dctx(void *dctx)
+{
+   ZSTD_freeDCtx(dctx);
+}
+
+/* Runs at exit() or when the library is unloaded, so that threads exiting
+ * later don't call free_zstd_cctx/dctx. Their contexts are leaked, and
+ * later calls use a context of their own.
+ */
+static void
+zstd_ctx_keys_fini(void)
+{
+   zstd_ctx_keys_valid = false;
+   tss_delete(zstd_cctx_key);
+   tss_delete(zstd_dctx_key);
+}
+
+static void
+zstd_ctx_keys_init(void)
+{
+   if (tss_create(&zstd_cctx_key, free_zstd_cctx) != thrd_success)
+      return;
+
+   if (tss_create(&zstd_dctx_key, free_zstd_dctx) != thrd_success) {
+      tss_delete(zstd_cctx_key);
+      return;
+   }
+
+   zstd_ctx_keys_valid = true;
+   atexit(zstd_ctx_keys_fini);
+}
+
+/* Returns the compression context of the thread, or NULL if there is none
+ * and the caller has to create one.
+ */
+static ZSTD_CCtx *
+get_thread_zstd_cctx(void)
+{
+   call_once(&zstd_ctx_once, zstd_ctx_keys_init);
+   if (!zstd_ctx_keys_valid)
+      return NULL;
+
+   ZSTD_CCtx *cctx = tss_get(zstd_cctx_key);
+   if (!cctx) {
+      cctx = ZSTD_createCCtx();
+      if (cctx && tss_set(zstd_cctx_key, cctx) != thrd_success) {
+         ZSTD_freeCCtx(cctx);
+         return NULL;
+      }
+   }
+   return cctx;
+}
+
+/* Same as get_thread_zstd_cctx() for decompression. */
+static ZSTD_DCtx *
+get_thread_zstd_dctx(void)
+{
+   call_once(&zstd_ctx_once, zstd_ctx_keys_init);
+   if (!zstd_ctx_keys_valid)
+      return NULL;
+
+   ZSTD_DCtx *dctx = tss_get(zstd_dctx_key);
+   if (!dctx) {
+      dctx = ZSTD_createDCtx();
+      if (dctx && tss_set(zstd_dctx_key, dctx) != thrd_success) {
+         ZSTD_freeDCtx(dctx);
+         return NULL;
+      }
+   }
+   return dctx;
+}
+#endif
+
 size_t
 util_compress_max_compressed_len(size_t in_data_size)
 {
@@ -166,4 +266,165 @@ util_compress_inflate(const uint8_t *in_data, size_t in_data_size,
 #endif
 }
 
+/**
+ * Trains a dictionary from num_samples inputs stored back to back in
+ * samples. Returns the size of the dictionary written to dict_data, or 0 if
+ * there wasn't enough data to train one.
+ */
+size_t
+util_compress_dict_train(uint8_t *dict_data, size_t dict_capacity,
+                         const uint8_t *samples, const size_t *sample_sizes,
+                         unsigned num_samples)
+{
+   MESA_TRACE_FUNC();
+#ifdef HAVE_ZSTD
+   size_t ret = ZDICT_trainFromBuffer(dict_data, dict_capacity, samples,
+                                      sample_sizes, num_samples);
+   if (ZDICT_isError(ret))
+      return 0;
+
+   return ret;
+#else
+   return 0;
+#endif
+}
+
+struct util_compress_dict *
+util_compress_dict_create(const uint8_t *dict_data, size_t dict_size)
+{
+#ifdef HAVE_ZSTD
+   /* Only accept trained dictionaries, raw content dictionaries have no id
+    * to tell which entries were compressed with them.
+    */
+   uint32_t id = ZDICT_getDictID(dict_data, dict_size);
+   if (!id)
+      return NULL;
+
+   struct util_compress_dict *dict = calloc(1, sizeof(*dict));
+   if (!dict)
+      return NULL;
+
+   dict->id = id;
+   dict->cdict = ZSTD_createCDict(dict_data, dict_size,
+                                  ZSTD_COMPRESSION_LEVEL);
+   dict->ddict = ZSTD_createDDict(dict_data, dict_size);
+   if (!dict->cdict || !dict->ddict) {
+      util_compress_dict_destroy(dict);
+      return NULL;
+   }
+
+   return dict;
+#else
+   return NULL;
+#endif
+}
+
+void
+util_compress_dict_destroy(struct util_compress_dict *dict)
+{
+#ifdef HAVE_ZSTD
+   if (!dict)
+      return;
+
+   ZSTD_freeCDict(dict->cdict);
+   ZSTD_freeDDict(dict->ddict);
+   free(dict);
+#endif
+}
+
+uint32_t
+util_compress_dict_id(const struct util_compress_dict *dict)
+{
+#ifdef HAVE_ZSTD
+   return dict ? dict->id : 0;
+#else
+   return 0;
+#endif
+}
+
+/**
+ * Returns the id of the dictionary the data was compressed with, or 0 if it
+ * was compressed without one.
+ */
+uint32_t
+util_compress_get_dict_id(const uint8_t *in_data, size_t in_data_size)
+{
+#ifdef HAVE_ZSTD
+   return ZSTD_getDictID_fromFrame(in_data, in_data_size);
+#else
+   return 0;
+#endif
+}
+
+/* Compress data against dict and return the size of the compressed data */
+size_t
+util_compress_deflate_dict(const struct util_compress_dict *dict,
+                           const uint8_t *in_data, size_t in_data_size,
+                           uint8_t *out_data, size_t out_buff_size)
+{
+#ifdef HAVE_ZSTD
+   if (!dict)
+      return util_compress_deflate(in_data, in_data_size, out_data,
+                                   out_buff_size);
+
+   MESA_TRACE_FUNC();
+   ZSTD_CCtx *own_cctx = NULL;
+   ZSTD_CCtx *cctx = get_thread_zstd_cctx();
+   if (!cctx)
+      cctx = own_cctx = ZSTD_createCCtx();
+   if (!cctx)
+      return 0;
+
+   size_t ret = ZSTD_compress_usingCDict(cctx, out_data, out_buff_size,
+                                         in_data, in_data_size, dict->cdict);
+   ZSTD_freeCCtx(own_cctx);
+   if (ZSTD_isError(ret))
+      return 0;
+
+   return ret;
+#else
+   assert(!dict);
+   return util_compress_deflate(in_data, in_data_size, out_data,
+                                out_buff_size);
+#endif
+}
+
+/**
+ * Decompresses data that may have been compressed against dict, returns true
+ * if successful.
+ */
+bool
+util_compress_inflate_dict(const struct util_compress_dict *dict,
+                           const uint8_t *in_data, size_t in_data_size,
+                           uint8_t *out_data, size_t out_data_size)
+{
+#ifdef HAVE_ZSTD
+   uint32_t id = util_compress_get_dict_id(in_data, in_data_size);
+   if (!id)
+      return util_compress_inflate(in_data, in_data_size, out_data,
+                                   out_data_size);
+
+   if (!dict || dict->id != id)
+      return false;
+
+   MESA_TRACE_FUNC();
+   ZSTD_DCtx *own_dctx = NULL;
+   ZSTD_DCtx *dctx = get_thread_zstd_dctx();
+   if (!dctx)
+      dctx = own_dctx = ZSTD_createDCtx();
+   if (!dctx)
+      return false;
+
+   size_t ret = ZSTD_decompress_usingDDict(dctx, out_data, out_data_size,
+                                           in_data, in_data_size,
+                                           dict->ddict);
+   ZSTD_freeDCtx(own_dctx);
+   return !ZSTD_isError(ret);
+#else
+   assert(!dict);
+   return util_compress_inflate(in_data, in_data_size, out_data,
+                                out_data_size);
+#endif
+}
+
 #endif
@@ -37,4 +37,37 @@ size_t
 util_compress_deflate(const uint8_t *in_data, size_t in_data_size,
                       uint8_t *out_data, size_t out_buff_size);
 
+/* Dictionaries trained from a set of sample inputs, these are only
+ * supported with zstd. Without it training fails and no dictionary can be
+ * created, the *_dict() functions then behave like their plain versions.
+ */
+struct util_compress_dict;
+
+size_t
+util_compress_dict_train(uint8_t *dict_data, size_t dict_capacity,
+                         const uint8_t *samples, const size_t *sample_sizes,
+                         unsigned num_samples);
+
+struct util_compress_dict *
+util_compress_dict_create(const uint8_t *dict_data, size_t dict_size);
+
+void
+util_compress_dict_destroy(struct util_compress_dict *dict);
+
+uint32_t
+util_compress_dict_id(const struct util_compress_dict *dict);
+
+uint32_t
+util_compress_get_dict_id(const uint8_t *in_data, size_t in_data_size);
+
+bool
+util_compress_inflate_dict(const struct util_compress_dict *dict,
+                           const uint8_t *in_data, size_t in_data_size,
+                           uint8_t *out_data, size_t out_data_size);
+
+size_t
+util_compress_deflate_dict(const struct util_compress_dict *dict,
+                           const uint8_t *in_data, size_t in_data_size,
+                           uint8_t *out_data, size_t out_buff_size);
+
 #endif
@@ -39,10 +39,12 @@
 
 #include "util/compress.h"
 #include "util/crc32.h"
+#include "util/hash_table.h"
 #include "util/u_debug.h"
 #include "util/rand_xor.h"
 #include "util/u_atomic.h"
 #include "util/mesa-sha1.h"
+#include "util/os_time.h"
 #include "util/perf/cpu_trace.h"
 #include "util/ralloc.h"
 #include "util/compiler.h"
@@ -76,20 +78,195 @@ disk_cache_init_queue(struct disk_cache *cache)
    if (util_queue_is_initialized(&cache->cache_queue))
       return true;
 
-   /* 4 threads were chosen below because just about all modern CPUs currently
-    * available that run Mesa have *at least* 4 cores. For these CPUs allowing
-    * more threads can result in the queue being processed faster, thus
-    * avoiding excessive memory use due to a backlog of cache entrys building
-    * up in the queue. Since we set the UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY
-    * flag this should have little negative impact on low core systems.
-    *
-    * The queue will resize automatically when it's full, so adding new jobs
-    * doesn't stall.
+   /* Use the process-wide shared threads, so that every cache (usually one
+    * per screen) doesn't start its own threads. They have the minimum
+    * priority, so they should have little negative impact on low core
+    * systems, and their queue resizes automatically when it's full, so adding
+    * new jobs doesn't stall.
     */
-   return util_queue_init(&cache->cache_queue, "disk$", 32, 4,
-                          UTIL_QUEUE_INIT_RESIZE_IF_FULL |
-                          UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY |
-                          UTIL_QUEUE_INIT_SET_FULL_THREAD_AFFINITY, NULL);
+   unsigned flags = UTIL_QUEUE_INIT_USE_SHARED_THREADS;
+   if (unlikely(cache->stats.enabled))
+      flags |= UTIL_QUEUE_INIT_COLLECT_STATS;
+
+   return util_queue_init(&cache->cache_queue, "disk$", 32, 4, flags, NULL);
+}
+
+/* Parse a size in gigabytes, or with a K or M suffix in kilo or megabytes. */
+static uint64_t
+parse_cache_size(const char *str)
+{
+   char *end;
+   uint64_t size = strtoul(str, &end, 10);
+   if (end == str)
+      return 0;
+
+   switch (*end) {
+   case 'K':
+   case 'k':
+      return size * 1024;
+   case 'M':
+   case 'm':
+      return size * 1024*1024;
+   case '\0':
+   case 'G':
+   case 'g':
+   default:
+      return size * 1024*1024*1024;
+   }
+}
+
+struct disk_cache_mem_entry {
+   struct list_head link;
+   cache_key key;
+   void *data;
+   size_t size;
+};
+
+static uint32_t
+mem_cache_key_hash(const void *key)
+{
+   /* Keys are SHA-1 hashes already. */
+   uint32_t hash;
+   memcpy(&hash, key, sizeof(hash));
+   return hash;
+}
+
+static bool
+mem_cache_key_equal(const void *a, const void *b)
+{
+   return memcmp(a, b, CACHE_KEY_SIZE) == 0;
+}
+
+static void
+mem_cache_init(struct disk_cache *cache)
+{
+   simple_mtx_init(&cache->mem.mtx, mtx_plain);
+   list_inithead(&cache->mem.lru);
+   cache->mem.entries = _mesa_hash_table_create(cache, mem_cache_key_hash,
+                                                mem_cache_key_equal);
+}
+
+static void
+mem_cache_remove_entry(struct disk_cache *cache,
+                       struct disk_cache_mem_entry *entry)
+{
+   _mesa_hash_table_remove_key(cache->mem.entries, entry->key);
+   list_del(&entry->link);
+   cache->mem.size -= entry->size;
+   free(entry->data);
+   free(entry);
+}
+
+static void
+mem_cache_finish(struct disk_cache *cache)
+{
+   list_for_each_entry_safe(struct disk_cache_mem_entry, entry,
+                            &cache->mem.lru, link) {
+      free(entry->data);
+      free(entry);
+   }
+   simple_mtx_destroy(&cache->mem.mtx);
+}
+
+/* Add an item to the memory cache, taking ownership of data. */
+static void
+mem_cache_insert(struct disk_cache *cache, const cache_key key,
+                 void *data, size_t size)
+{
+   /* Don't let a few big items push out everything else. */
+   if (size > cache->mem.max_size / 4) {
+      free(data);
+      return;
+   }
+
+   struct disk_cache_mem_entry *entry = malloc(sizeof(*entry));
+   if (!entry) {
+      free(data);
+      return;
+   }
+
+   memcpy(entry->key, key, CACHE_KEY_SIZE);
+   entry->data = data;
+   entry->size = size;
+
+   simple_mtx_lock(&cache->mem.mtx);
+
+   struct hash_entry *he = _mesa_hash_table_search(cache->mem.entries, key);
+   if (he)
+      mem_cache_remove_entry(cache, he->data);
+
+   while (cache->mem.size + size > cache->mem.max_size) {
+      mem_cache_remove_entry(cache,
+                             list_last_entry(&cache->mem.lru,
+                                             struct disk_cache_mem_entry,
+                                             link));
+   }
+
+   _mesa_hash_table_insert(cache->mem.entries, entry->key, entry);
+   list_add(&entry->link, &cache->mem.lru);
+   cache->mem.size += size;
+
+   simple_mtx_unlock(&cache->mem.mtx);
+}
+
+static void
+mem_cache_insert_copy(struct disk_cache *cache, const cache_key key,
+                      const void *data, size_t size)
+{
+   void *copy = malloc(size);
+   if (!copy)
+      return;
+
+   memcpy(copy, data, size);
+   mem_cache_insert(cache, key, copy, size);
+}
+
+static void
+mem_cache_remove(struct disk_cache *cache, const cache_key key)
+{
+   simple_mtx_lock(&cache->mem.mtx);
+
+   struct hash_entry *he = _mesa_hash_table_search(cache->mem.entries, key);
+   if (he)
+      mem_cache_remove_entry(cache, he->data);
+
+   simple_mtx_unlock(&cache->mem.mtx);
+}
+
+static bool
+mem_cache_contains(struct disk_cache *cache, const cache_key key)
+{
+   simple_mtx_lock(&cache->mem.mtx);
+   bool found = _mesa_hash_table_search(cache->mem.entries, key) != NULL;
+   simple_mtx_unlock(&cache->mem.mtx);
+
+   return found;
+}
+
+/* Return a copy of the item, like the on-disk caches do. */
+static void *
+mem_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
+{
+   void *data = NULL;
+
+   simple_mtx_lock(&cache->mem.mtx);
+
+   struct hash_entry *he = _mesa_hash_table_search(cache->mem.entries, key);
+   if (he) {
+      struct disk_cache_mem_entry *entry = he->data;
+
+      data = malloc(entry->size);
+      if (data) {
+         memcpy(data, entry->data, entry->size);
+         *size = entry->size;
+         list_del(&entry->link);
+         list_add(&entry->link, &cache->mem.lru);
+      }
+   }
+
+   simple_mtx_unlock(&cache->mem.mtx);
+
+   return data;
 }
 
 static struct disk_cache *
@@ -119,6 +296,9 @@ disk_cache_type_create(const char *gpu_name,
    cache->path_init_failed = true;
    cache->type = DISK_CACHE_NONE;
 
+   mem_cache_init(cache);
+   simple_mtx_init(&cache->dict.mtx, mtx_plain);
+
    if (!disk_cache_enabled())
       goto path_fail;
 
@@ -159,6 +339,10 @@ disk_cache_type_create(const char *gpu_name,
 
    cache->max_size = max_size;
 
+   const char *mem_max_size_str =
+      debug_get_option("MESA_SHADER_CACHE_MEMORY_MAX_SIZE", "16M");
+   cache->mem.max_size = MIN2(parse_cache_size(mem_max_size_str), max_size);
+
    if (cache->type == DISK_CACHE_DATABASE)
       mesa_cache_db_multipart_set_size_limit(&cache->cache_db, cache->max_size);
 
@@ -199,6 +383,9 @@ disk_cache_type_create(const char *gpu_name,
    DRV_KEY_CPY(drv_key_blob, &ptr_size, ptr_size_size)
    DRV_KEY_CPY(drv_key_blob, &driver_flags, driver_flags_size)
 
+   if (!cache->path_init_failed)
+      disk_cache_init_dict(cache);
+
    /* Seed our rand function */
    s_rand_xorshift128plus(cache->seed_xorshift128plus, true);
 
@@ -252,30 +439,8 @@ disk_cache_create(const char *gpu_name, const char *driver_id,
    }
 #endif
 
-   if (max_size_str) {
-      char *end;
-      max_size = strtoul(max_size_str, &end, 10);
-      if (end == max_size_str) {
-         max_size = 0;
-      } else {
-         switch (*end) {
-         case 'K':
-         case 'k':
-            max_size *= 1024;
-            break;
-         case 'M':
-         case 'm':
-            max_size *= 1024*1024;
-            break;
-         case '\0':
-         case 'G':
-         case 'g':
-         default:
-            max_size *= 1024*1024*1024;
-            break;
-         }
-      }
-   }
+   if (max_size_str)
+      max_size = parse_cache_size(max_size_str);
 
    /* Default to 1GB for maximum cache size. */
    if (max_size == 0) {
@@ -322,13 +487,30 @@ void
 disk_cache_destroy(struct disk_cache *cache)
 {
    if (unlikely(cache && cache->stats.enabled)) {
-      printf("disk shader cache:  hits = %u, misses = %u\n",
+      printf("disk shader cache:  hits = %u (%u from memory), misses = %u\n",
              cache->stats.hits,
+             cache->stats.memory_hits,
              cache->stats.misses);
+      printf("disk shader cache:  average hit latency = %.1f us\n",
+             cache->stats.hits ?
+             cache->stats.hit_time_ns / 1000.0 / cache->stats.hits : 0.0);
+      printf("disk shader cache:  written %" PRIu64 " bytes, "
+             "compressed to %" PRIu64 " bytes, dictionary %s\n",
+             cache->stats.uncompressed_size, cache->stats.compressed_size,
+             cache->dict.dict ? "used" : "not used");
    }
 
    if (cache && util_queue_is_initialized(&cache->cache_queue)) {
       util_queue_finish(&cache->cache_queue);
+
+      if (unlikely(cache->stats.enabled)) {
+         struct util_queue_stats queue_stats;
+
+         util_queue_get_stats(&cache->cache_queue, &queue_stats);
+         printf("disk shader cache:  %" PRIu64 " jobs, busy for %.1f ms\n",
+                queue_stats.num_jobs, queue_stats.busy_time_ns / 1000000.0);
+      }
+
       util_queue_destroy(&cache->cache_queue);
 
       if (cache->foz_ro_cache)
@@ -343,6 +525,12 @@ disk_cache_destroy(struct disk_cache *cache)
       disk_cache_destroy_mmap(cache);
    }
 
+   if (cache) {
+      mem_cache_finish(cache);
+      disk_cache_finish_dict(cache);
+      simple_mtx_destroy(&cache->dict.mtx);
+   }
+
    ralloc_free(cache);
 }
 
@@ -355,6 +543,9 @@ disk_cache_wait_for_idle(struct disk_cache *cache)
 void
 disk_cache_remove(struct disk_cache *cache, const cache_key key)
 {
+   if (cache->mem.max_size)
+      mem_cache_remove(cache, key);
+
    if (cache->type == DISK_CACHE_DATABASE) {
       mesa_cache_db_multipart_entry_remove(&cache->cache_db, key);
       return;
@@ -440,6 +631,29 @@ static void
 blob_put_compressed(struct disk_cache *cache, const cache_key key,
          const void *data, size_t size);
 
+static void
+cache_db_compact(void *job, void *gdata, int thread_index)
+{
+   struct disk_cache *cache = (struct disk_cache *) job;
+
+   mesa_cache_db_multipart_compact(&cache->cache_db);
+}
+
+/* Compact the DB in a separate low priority job, puts keep going
+ * meanwhile. This is done when queueing a put rather than from a put job
+ * because jobs can't add more jobs while util_queue_finish() is waiting for
+ * the queue.
+ */
+static void
+disk_cache_queue_db_compaction(struct disk_cache *cache)
+{
+   if (cache->type == DISK_CACHE_DATABASE &&
+       mesa_cache_db_multipart_should_compact(&cache->cache_db))
+      util_queue_add_job_with_priority(&cache->cache_queue, cache, NULL,
+                                       cache_db_compact, NULL, 0,
+                                       UTIL_QUEUE_PRIORITY_LOW);
+}
+
 static void
 cache_put(void *job, void *gdata, int thread_index)
 {
@@ -565,6 +779,9 @@ disk_cache_put(struct disk_cache *cache, const cache_key key,
    if (!util_queue_is_initialized(&cache->cache_queue))
       return;
 
+   if (cache->mem.max_size)
+      mem_cache_insert_copy(cache, key, data, size);
+
    struct disk_cache_put_job *dc_job =
       create_put_job(cache, key, (void*)data, size, cache_item_metadata, false);
 
@@ -573,6 +790,8 @@ disk_cache_put(struct disk_cache *cache, const cache_key key,
       util_queue_add_job(&cache->cache_queue, dc_job, &dc_job->fence,
                          cache_put, destroy_put_job, dc_job->size);
    }
+
+   disk_cache_queue_db_compaction(cache);
 }
 
 void
@@ -585,6 +804,9 @@ disk_cache_put_nocopy(struct disk_cache *cache, const cache_key key,
       return;
    }
 
+   if (cache->mem.max_size)
+      mem_cache_insert_copy(cache, key, data, size);
+
    struct disk_cache_put_job *dc_job =
       create_put_job(cache, key, data, size, cache_item_metadata, true);
 
@@ -593,16 +815,15 @@ disk_cache_put_nocopy(struct disk_cache *cache, const cache_key key,
       util_queue_add_job(&cache->cache_queue, dc_job, &dc_job->fence,
                          cache_put, destroy_put_job_nocopy, dc_job->size);
    }
+
+   disk_cache_queue_db_compaction(cache);
 }
 
-void *
-disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
+static void *
+disk_cache_load(struct disk_cache *cache, const cache_key key, size_t *size)
 {
    void *buf = NULL;
 
-   if (size)
-      *size = 0;
-
    if (cache->foz_ro_cache)
       buf = disk_cache_load_item_foz(cache->foz_ro_cache, key, size);
 
@@ -620,16 +841,109 @@ disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
       }
    }
 
+   return buf;
+}
+
+void *
+disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
+{
+   void *buf = NULL;
+   size_t buf_size = 0;
+   int64_t start_ns = 0;
+
+   if (unlikely(cache->stats.enabled))
+      start_ns = os_time_get_nano();
+
+   if (cache->mem.max_size) {
+      buf = mem_cache_get(cache, key, &buf_size);
+
+      if (unlikely(buf && cache->stats.enabled))
+         p_atomic_inc(&cache->stats.memory_hits);
+   }
+
+   if (!buf) {
+      buf = disk_cache_load(cache, key, &buf_size);
+
+      if (buf && cache->mem.max_size)
+         mem_cache_insert_copy(cache, key, buf, buf_size);
+   }
+
+   if (size)
+      *size = buf_size;
+
    if (unlikely(cache->stats.enabled)) {
-      if (buf)
+      if (buf) {
          p_atomic_inc(&cache->stats.hits);
-      else
+         p_atomic_add(&cache->stats.hit_time_ns,
+                      os_time_get_nano() - start_ns);
+      } else
          p_atomic_inc(&cache->stats.misses);
    }
 
    return buf;
 }
 
+/* Number of keys loaded by a single prefetch job. */
+#define PREFETCH_JOB_KEYS 16
+
+struct disk_cache_prefetch_job {
+   struct disk_cache *cache;
+   unsigned num_keys;
+   cache_key keys[PREFETCH_JOB_KEYS];
+};
+
+static void
+cache_prefetch(void *job, void *gdata, int thread_index)
+{
+   struct disk_cache_prefetch_job *pf_job =
+      (struct disk_cache_prefetch_job *) job;
+   struct disk_cache *cache = pf_job->cache;
+
+   for (unsigned i = 0; i < pf_job->num_keys; i++) {
+      if (mem_cache_contains(cache, pf_job->keys[i]))
+         continue;
+
+      size_t size = 0;
+      void *data = disk_cache_load(cache, pf_job->keys[i], &size);
+      if (data)
+         mem_cache_insert(cache, pf_job->keys[i], data, size);
+   }
+}
+
+static void
+destroy_prefetch_job(void *job, void *gdata, int thread_index)
+{
+   free(job);
+}
+
+void
+disk_cache_prefetch(struct disk_cache *cache, const cache_key *keys,
+                    unsigned num_keys)
+{
+   if (!cache->mem.max_size ||
+       !util_queue_is_initialized(&cache->cache_queue))
+      return;
+
+   /* Split the keys into small jobs so they get loaded by all threads of
+    * the queue in parallel. They go ahead of pending writes, the items are
+    * about to be needed.
+    */
+   for (unsigned i = 0; i < num_keys; i += PREFETCH_JOB_KEYS) {
+      struct disk_cache_prefetch_job *pf_job = (struct disk_cache_prefetch_job *)
+         malloc(sizeof(struct disk_cache_prefetch_job));
+      if (!pf_job)
+         return;
+
+      pf_job->cache = cache;
+      pf_job->num_keys = MIN2(num_keys - i, PREFETCH_JOB_KEYS);
+      memcpy(pf_job->keys, keys + i, pf_job->num_keys * sizeof(cache_key));
+
+      util_queue_add_job_with_priority(&cache->cache_queue, pf_job, NULL,
+                                       cache_prefetch, destroy_prefetch_job,
+                                       0, UTIL_QUEUE_PRIORITY_HIGH);
+   }
+}
+
 void
 disk_cache_put_key(struct disk_cache *cache, const cache_key key)
 {
@@ -103,6 +103,7 @@ disk_cache_get_function_identifier(void *ptr, struct mesa_sha1 *ctx)
 #include "util/u_debug.h"
 #include "util/ralloc.h"
 #include "util/rand_xor.h"
+#include "util/u_atomic.h"
 
 /* Check if directory exists or if mkdir_if_needed param is set create a
  * directory named 'path' if it does not already exist.
@@ -481,6 +482,274 @@ write_all(int fd, const void *buf, size_t count)
    return done;
 }
 
+/* The dictionary is trained once DICT_TRAINING_SIZE bytes of entries were
+ * written, taking at most DICT_SAMPLE_MAX_SIZE bytes from each entry. Around
+ * a hundred times the dictionary size is what zstd suggests to train on.
+ */
+#define DICT_MAX_SIZE (16 * 1024)
+#define DICT_SAMPLE_MAX_SIZE (16 * 1024)
+#define DICT_TRAINING_SIZE (1024 * 1024)
+#define DICT_MAX_SAMPLES 4096
+
+/* Percentage by which the dictionary has to shrink entries to be used. */
+#define DICT_MIN_SAVINGS 5
+
+static struct util_compress_dict *
+load_dict(const char *filename)
+{
+   struct util_compress_dict *dict = NULL;
+   uint8_t *data = NULL;
+
+   int fd = open(filename, O_RDONLY | O_CLOEXEC);
+   if (fd == -1)
+      return NULL;
+
+   struct stat sb;
+   if (fstat(fd, &sb) == -1 || sb.st_size <= sizeof(uint32_t) ||
+       sb.st_size > DICT_MAX_SIZE + sizeof(uint32_t))
+      goto out;
+
+   data = malloc(sb.st_size);
+   if (!data || read_all(fd, data, sb.st_size) == -1)
+      goto out;
+
+   /* The dictionary is followed by its CRC. */
+   size_t dict_size = sb.st_size - sizeof(uint32_t);
+   uint32_t crc32;
+   memcpy(&crc32, data + dict_size, sizeof(crc32));
+   if (crc32 != util_hash_crc32(data, dict_size))
+      goto out;
+
+   dict = util_compress_dict_create(data, dict_size);
+
+ out:
+   free(data);
+   close(fd);
+
+   return dict;
+}
+
+/* Write the dictionary unless another process already did. Entries can only
+ * be compressed against the dictionary in the file, whichever one that is.
+ */
+static void
+store_dict(const char *filename, const uint8_t *dict_data, size_t dict_size)
+{
+   char *filename_tmp = NULL;
+   if (asprintf(&filename_tmp, "%s.%d.tmp", filename, (int)getpid()) == -1)
+      return;
+
+   int fd = open(filename_tmp, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+   if (fd == -1)
+      goto out;
+
+   uint32_t crc32 = util_hash_crc32(dict_data, dict_size);
+   bool written = write_all(fd, dict_data, dict_size) != -1 &&
+                  write_all(fd, &crc32, sizeof(crc32)) != -1;
+   close(fd);
+
+   /* Unlike rename(), link() fails if the file already exists. */
+   if (written)
+      (void) link(filename_tmp, filename);
+
+   unlink(filename_tmp);
+
+ out:
+   free(filename_tmp);
+}
+
+/* Return how much smaller the samples compress with dict than without, in
+ * percent.
+ */
+static int
+dict_savings(const struct util_compress_dict *dict, const uint8_t *samples,
+             const size_t *sample_sizes, unsigned num_samples)
+{
+   size_t plain_size = 0, dict_size = 0;
+
+   size_t max_buf = util_compress_max_compressed_len(DICT_SAMPLE_MAX_SIZE);
+   uint8_t *out = malloc(max_buf);
+   if (!out)
+      return 0;
+
+   for (unsigned i = 0; i < num_samples; i++) {
+      plain_size += util_compress_deflate(samples, sample_sizes[i], out,
+                                          max_buf);
+      dict_size += util_compress_deflate_dict(dict, samples, sample_sizes[i],
+                                              out, max_buf);
+      samples += sample_sizes[i];
+   }
+
+   free(out);
+
+   if (!plain_size || !dict_size)
+      return 0;
+
+   return 100 - (int)(dict_size * 100 / plain_size);
+}
+
+static void
+train_dict(struct disk_cache *cache, uint8_t *samples, size_t *sample_sizes,
+           unsigned num_samples)
+{
+   uint8_t *dict_data = malloc(DICT_MAX_SIZE);
+   if (!dict_data)
+      return;
+
+   /* Hold back a quarter of the samples to check that the dictionary
+    * actually helps with entries it wasn't trained from. For entries that
+    * have little in common it can make things worse.
+    */
+   unsigned num_train_samples = num_samples - num_samples / 4;
+   size_t train_size = 0;
+   for (unsigned i = 0; i < num_train_samples; i++)
+      train_size += sample_sizes[i];
+
+   size_t dict_size = util_compress_dict_train(dict_data, DICT_MAX_SIZE,
+                                               samples, sample_sizes,
+                                               num_train_samples);
+   struct util_compress_dict *dict =
+      dict_size ? util_compress_dict_create(dict_data, dict_size) : NULL;
+
+   if (dict && dict_savings(dict, samples + train_size,
+                            sample_sizes + num_train_samples,
+                            num_samples - num_train_samples) >=
+               DICT_MIN_SAVINGS)
+      store_dict(cache->dict.filename, dict_data, dict_size);
+
+   util_compress_dict_destroy(dict);
+   free(dict_data);
+
+   dict = load_dict(cache->dict.filename);
+
+   simple_mtx_lock(&cache->dict.mtx);
+   if (!cache->dict.dict)
+      p_atomic_set(&cache->dict.dict, dict);
+   else
+      util_compress_dict_destroy(dict);
+   simple_mtx_unlock(&cache->dict.mtx);
+}
+
+/* Keep the start of an entry written without dictionary to train one from,
+ * training happens on the calling thread once there are enough samples.
+ */
+static void
+add_dict_sample(struct disk_cache *cache, const void *data, size_t size)
+{
+   size = MIN2(size, DICT_SAMPLE_MAX_SIZE);
+
+   simple_mtx_lock(&cache->dict.mtx);
+   if (cache->dict.training_done) {
+      simple_mtx_unlock(&cache->dict.mtx);
+      return;
+   }
+
+   if (!cache->dict.samples) {
+      cache->dict.samples = malloc(DICT_TRAINING_SIZE);
+      cache->dict.sample_sizes =
+         malloc(DICT_MAX_SAMPLES * sizeof(*cache->dict.sample_sizes));
+      if (!cache->dict.samples || !cache->dict.sample_sizes) {
+         cache->dict.training_done = true;
+         simple_mtx_unlock(&cache->dict.mtx);
+         return;
+      }
+   }
+
+   size = MIN2(size, DICT_TRAINING_SIZE - cache->dict.samples_size);
+   memcpy(cache->dict.samples + cache->dict.samples_size, data, size);
+   cache->dict.sample_sizes[cache->dict.num_samples++] = size;
+   cache->dict.samples_size += size;
+
+   if (cache->dict.samples_size < DICT_TRAINING_SIZE &&
+       cache->dict.num_samples < DICT_MAX_SAMPLES) {
+      simple_mtx_unlock(&cache->dict.mtx);
+      return;
+   }
+
+   uint8_t *samples = cache->dict.samples;
+   size_t *sample_sizes = cache->dict.sample_sizes;
+   unsigned num_samples = cache->dict.num_samples;
+
+   cache->dict.samples = NULL;
+   cache->dict.sample_sizes = NULL;
+   cache->dict.training_done = true;
+   simple_mtx_unlock(&cache->dict.mtx);
+
+   train_dict(cache, samples, sample_sizes, num_samples);
+
+   free(samples);
+   free(sample_sizes);
+}
+
+/* Return the dictionary to decompress an entry with, loading it if the entry
+ * was written by another process after this cache was created.
+ */
+static const struct util_compress_dict *
+get_dict_for_entry(struct disk_cache *cache, const uint8_t *data, size_t size)
+{
+   struct util_compress_dict *dict = p_atomic_read(&cache->dict.dict);
+   if (dict || !cache->dict.filename ||
+       !util_compress_get_dict_id(data, size))
+      return dict;
+
+   simple_mtx_lock(&cache->dict.mtx);
+   if (!cache->dict.dict) {
+      dict = load_dict(cache->dict.filename);
+      if (dict) {
+         p_atomic_set(&cache->dict.dict, dict);
+         cache->dict.training_done = true;
+      }
+   }
+   dict = cache->dict.dict;
+   simple_mtx_unlock(&cache->dict.mtx);
+
+   return dict;
+}
+
+void
+disk_cache_init_dict(struct disk_cache *cache)
+{
+   uint8_t hash[SHA1_DIGEST_LENGTH];
+   char buf[SHA1_DIGEST_STRING_LENGTH];
+
+   if (cache->compression_disabled ||
+       !debug_get_bool_option("MESA_SHADER_CACHE_COMPRESSION_DICT", true))
+      return;
+
+   /* The dictionary is a file in the cache directory, so only use it with
+    * the backends that keep their entries in that same directory. Fossilize
+    * databases are also copied on their own and loaded read-only from
+    * elsewhere, see MESA_DISK_CACHE_READ_ONLY_FOZ_DBS. Entries that were
+    * compressed against a missing dictionary are read back as misses.
+    */
+   if (cache->type != DISK_CACHE_MULTI_FILE &&
+       cache->type != DISK_CACHE_DATABASE)
+      return;
+
+   /* Entries are only ever read back by the driver that wrote them, so each
+    * driver gets a dictionary trained from its own entries.
+    */
+   _mesa_sha1_compute(cache->driver_keys_blob, cache->driver_keys_blob_size,
+                      hash);
+   _mesa_sha1_format(buf, hash);
+   cache->dict.filename = ralloc_asprintf(cache, "%s/dict_%.16s",
+                                          cache->path, buf);
+   if (!cache->dict.filename)
+      return;
+
+   cache->dict.dict = load_dict(cache->dict.filename);
+   if (cache->dict.dict)
+      cache->dict.training_done = true;
+}
+
+void
+disk_cache_finish_dict(struct disk_cache *cache)
+{
+   util_compress_dict_destroy(cache->dict.dict);
+   free(cache->dict.samples);
+   free(cache->dict.sample_sizes);
+}
+
 /* Evict least recently used cache item */
 void
 disk_cache_evict_lru_item(struct disk_cache *cache)
@@ -613,8 +882,11 @@ parse_and_validate_cache_item(struct disk_cache *cache, void *cache_item,
 
       memcpy(uncompressed_data, data, cache_data_size);
    } else {
-      if (!util_compress_inflate(data, cache_data_size, uncompressed_data,
-                                 cf_data->uncompressed_size))
+      const struct util_compress_dict *dict =
+         get_dict_for_entry(cache, data, cache_data_size);
+      if (!util_compress_inflate_dict(dict, data, cache_data_size,
+                                      uncompressed_data,
+                                      cf_data->uncompressed_size))
          goto fail;
    }
 
@@ -709,14 +981,26 @@ create_cache_item_header_and_blob(struct disk_cache_put_job *dc_job,
       compressed_size = dc_job->size;
       compressed_data = dc_job->data;
    } else {
+      struct disk_cache *cache = dc_job->cache;
+      const struct util_compress_dict *dict = p_atomic_read(&cache->dict.dict);
+
       compressed_data = malloc(max_buf);
       if (compressed_data == NULL)
          return false;
       compressed_size =
-         util_compress_deflate(dc_job->data, dc_job->size,
-                              compressed_data, max_buf);
+         util_compress_deflate_dict(dict, dc_job->data, dc_job->size,
+                                    compressed_data, max_buf);
       if (compressed_size == 0)
          goto fail;
+
+      if (!dict && cache->dict.filename &&
+          !p_atomic_read_relaxed(&cache->dict.training_done))
+         add_dict_sample(cache, dc_job->data, dc_job->size);
+
+      if (unlikely(cache->stats.enabled)) {
+         p_atomic_add(&cache->stats.uncompressed_size, dc_job->size);
+         p_atomic_add(&cache->stats.compressed_size, compressed_size);
+      }
    }
 
    /* Copy the driver_keys_blob, this can be used find information about the
@@ -33,8 +33,10 @@
 #else
 
 #include "util/fossilize_db.h"
+#include "util/list.h"
 #include "util/mesa_cache_db.h"
 #include "util/mesa_cache_db_multipart.h"
+#include "util/simple_mtx.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -96,10 +98,41 @@ struct disk_cache {
    /* Don't compress cached data. This is for testing purposes only. */
    bool compression_disabled;
 
+   /* Uncompressed items recently written or read by this process, most
+    * recently used first, so that getting them again doesn't need to go to
+    * the disk.
+    */
+   struct {
+      simple_mtx_t mtx;
+      struct hash_table *entries;
+      struct list_head lru;
+      uint64_t size;
+      uint64_t max_size;
+   } mem;
+
+   /* Compression dictionary shared by all processes using this driver's
+    * entries. Until one exists, the first entries written are kept as
+    * samples to train it from.
+    */
+   struct {
+      simple_mtx_t mtx;
+      struct util_compress_dict *dict;
+      char *filename;
+      uint8_t *samples;
+      size_t *sample_sizes;
+      unsigned num_samples;
+      size_t samples_size;
+      bool training_done;
+   } dict;
+
    struct {
       bool enabled;
       unsigned hits;
       unsigned misses;
+      unsigned memory_hits;
+      uint64_t hit_time_ns;
+      uint64_t uncompressed_size;
+      uint64_t compressed_size;
    } stats;
 
    /* Internal RO FOZ cache for combined use of RO and RW caches. */
@@ -186,6 +219,12 @@ disk_cache_db_load_cache_index(void *mem_ctx, struct disk_cache *cache);
 void
 disk_cache_delete_old_cache(void);
 
+void
+disk_cache_init_dict(struct disk_cache *cache);
+
+void
+disk_cache_finish_dict(struct disk_cache *cache);
+
 #ifdef __cplusplus
 }
 #endif
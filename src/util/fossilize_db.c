@@ -37,6 +37,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/file.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -205,8 +206,19 @@ static int lock_file_with_timeout(FILE *f, int64_t timeout)
 }
 
 static bool
-load_foz_dbs(struct foz_db *foz_db, FILE *db_idx, uint8_t file_idx,
-             bool read_only)
+check_magic_and_version(const uint8_t magic[FOZ_REF_MAGIC_SIZE])
+{
+   if (memcmp(magic, stream_reference_magic_and_version,
+              FOZ_REF_MAGIC_SIZE - 1))
+      return false;
+
+   int version = magic[FOZ_REF_MAGIC_SIZE - 1];
+   return version <= FOSSILIZE_FORMAT_VERSION &&
+          version >= FOSSILIZE_FORMAT_MIN_COMPAT_VERSION;
+}
+
+static bool
+load_foz_dbs(struct foz_db *foz_db, FILE *db_idx, uint8_t file_idx)
 {
    /* Scan through the archive and get the list of cache entries. */
    fseek(db_idx, 0, SEEK_END);
@@ -232,13 +244,7 @@ load_foz_dbs(struct foz_db *foz_db, FILE *db_idx, uint8_t file_idx,
       if (fread(magic, 1, FOZ_REF_MAGIC_SIZE, db_idx) != FOZ_REF_MAGIC_SIZE)
          goto fail;
 
-      if (memcmp(magic, stream_reference_magic_and_version,
-                 FOZ_REF_MAGIC_SIZE - 1))
-         goto fail;
-
-      int version = magic[FOZ_REF_MAGIC_SIZE - 1];
-      if (version > FOSSILIZE_FORMAT_VERSION ||
-          version < FOSSILIZE_FORMAT_MIN_COMPAT_VERSION)
+      if (!check_magic_and_version(magic))
          goto fail;
 
    } else {
@@ -259,16 +265,7 @@ load_foz_dbs(struct foz_db *foz_db, FILE *db_idx, uint8_t file_idx,
 
    flock(fileno(foz_db->file[file_idx]), LOCK_UN);
 
-   if (foz_db->updater.thrd) {
-   /* If MESA_DISK_CACHE_READ_ONLY_FOZ_DBS_DYNAMIC_LIST is enabled, access to
-    * the foz_db hash table requires locking to prevent racing between this
-    * updated thread loading DBs at runtime and cache entry read/writes. */
-      simple_mtx_lock(&foz_db->mtx);
-      update_foz_index(foz_db, db_idx, file_idx);
-      simple_mtx_unlock(&foz_db->mtx);
-   } else {
-      update_foz_index(foz_db, db_idx, file_idx);
-   }
+   update_foz_index(foz_db, db_idx, file_idx);
 
    foz_db->alive = true;
    return true;
@@ -278,6 +275,164 @@ fail:
    return false;
 }
 
+/* Parses the index of a read only foz db. Read only dbs don't change, so the
+ * whole index is mapped at once and its entries are allocated in one go.
+ */
+static void
+load_foz_ro_index(void *data, void *gdata, int thread_index)
+{
+   struct foz_ro_index *index = data;
+   const size_t record_size = FOSSILIZE_BLOB_HASH_LENGTH +
+                              sizeof(struct foz_payload_header) +
+                              sizeof(uint64_t);
+   int fd = fileno(index->idx_file);
+   struct stat st;
+
+   if (fstat(fd, &st) == -1 || st.st_size <= FOZ_REF_MAGIC_SIZE)
+      goto out;
+
+   size_t len = st.st_size;
+   const uint8_t *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+   if (map == MAP_FAILED)
+      goto out;
+
+   posix_madvise((void *)map, len, POSIX_MADV_SEQUENTIAL);
+
+   struct foz_db_entry *entries =
+      ralloc_array(index->mem_ctx, struct foz_db_entry,
+                   (len - FOZ_REF_MAGIC_SIZE) / record_size);
+   if (!entries) {
+      munmap((void *)map, len);
+      goto out;
+   }
+
+   struct foz_db_entry *entry = entries;
+   for (size_t offset = FOZ_REF_MAGIC_SIZE; offset + record_size <= len;
+        offset += record_size) {
+      const uint8_t *record = map + offset;
+
+      memcpy(&entry->header, record + FOSSILIZE_BLOB_HASH_LENGTH,
+             sizeof(entry->header));
+
+      /* Corrupt entry. The db was copied before all data was written. */
+      if (entry->header.payload_size != sizeof(uint64_t))
+         break;
+
+      char hash_str[FOSSILIZE_BLOB_HASH_LENGTH + 1];
+      memcpy(hash_str, record, FOSSILIZE_BLOB_HASH_LENGTH);
+      hash_str[FOSSILIZE_BLOB_HASH_LENGTH] = '\0';
+      _mesa_sha1_hex_to_sha1(entry->key, hash_str);
+
+      memcpy(&entry->offset, record + record_size - sizeof(uint64_t),
+             sizeof(entry->offset));
+      entry->file_idx = index->file_idx;
+
+      _mesa_hash_table_u64_insert(index->entries,
+                                  truncate_hash_to_64bits(entry->key), entry);
+      entry++;
+   }
+
+   munmap((void *)map, len);
+
+out:
+   fclose(index->idx_file);
+   index->idx_file = NULL;
+}
+
+/* Checks the header of a read only foz db index and starts loading the
+ * index, in the background if possible. Takes ownership of db_idx.
+ */
+static bool
+load_foz_db_ro(struct foz_db *foz_db, FILE *db_idx, uint8_t file_idx)
+{
+   struct foz_ro_index *index = &foz_db->ro_index[file_idx];
+   uint8_t magic[FOZ_REF_MAGIC_SIZE];
+
+   if (fread(magic, 1, FOZ_REF_MAGIC_SIZE, db_idx) != FOZ_REF_MAGIC_SIZE ||
+       !check_magic_and_version(magic)) {
+      fclose(db_idx);
+      return false;
+   }
+
+   void *mem_ctx = ralloc_context(NULL);
+   struct hash_table_u64 *entries = _mesa_hash_table_u64_create(mem_ctx);
+   if (!entries) {
+      ralloc_free(mem_ctx);
+      fclose(db_idx);
+      return false;
+   }
+
+   /* Lookups from other threads only look at the index once entries is
+    * set, and then wait for it to be loaded. The loader fills entries, so
+    * it has to be set before the load starts.
+    */
+   simple_mtx_lock(&foz_db->mtx);
+   index->mem_ctx = mem_ctx;
+   index->entries = entries;
+   index->idx_file = db_idx;
+   index->file_idx = file_idx;
+   util_queue_fence_init(&index->ready);
+
+   if (util_queue_is_initialized(&foz_db->index_queue)) {
+      util_queue_add_job_with_priority(&foz_db->index_queue, index,
+                                       &index->ready, load_foz_ro_index,
+                                       NULL, 0, UTIL_QUEUE_PRIORITY_HIGH);
+   } else {
+      load_foz_ro_index(index, NULL, 0);
+   }
+
+   foz_db->alive = true;
+   simple_mtx_unlock(&foz_db->mtx);
+
+   return true;
+}
+
+/* Waits for the read only foz db indices that are being loaded. Must be
+ * called without any lock held: the loads take a while, and must not wait
+ * for a writer that holds the locks. The indices live as long as foz_db,
+ * so their fences can be waited on after dropping the mutex.
+ */
+static void
+wait_foz_dbs_ro(struct foz_db *foz_db)
+{
+   struct util_queue_fence *pending[FOZ_MAX_DBS];
+   unsigned num_pending = 0;
+
+   simple_mtx_lock(&foz_db->mtx);
+   for (unsigned i = 1; i < FOZ_MAX_DBS; i++) {
+      struct foz_ro_index *index = &foz_db->ro_index[i];
+
+      if (index->entries && !util_queue_fence_is_signalled(&index->ready))
+         pending[num_pending++] = &index->ready;
+   }
+   simple_mtx_unlock(&foz_db->mtx);
+
+   for (unsigned i = 0; i < num_pending; i++)
+      util_queue_fence_wait(pending[i]);
+}
+
+/* Looks a hash up in the read only foz dbs, in order. Dbs whose index is
+ * still loading are skipped, callers wait for them with wait_foz_dbs_ro()
+ * first. Must be called with foz_db->mtx held.
+ */
+static struct foz_db_entry *
+search_foz_dbs_ro(struct foz_db *foz_db, uint64_t hash)
+{
+   for (unsigned i = 1; i < FOZ_MAX_DBS; i++) {
+      struct foz_ro_index *index = &foz_db->ro_index[i];
+
+      if (!index->entries || !util_queue_fence_is_signalled(&index->ready))
+         continue;
+
+      struct foz_db_entry *entry =
+         _mesa_hash_table_u64_search(index->entries, hash);
+      if (entry)
+         return entry;
+   }
+
+   return NULL;
+}
+
 static void
 load_foz_dbs_ro(struct foz_db *foz_db, char *foz_dbs_ro)
 {
@@ -312,15 +467,13 @@ load_foz_dbs_ro(struct foz_db *foz_db, char *foz_dbs_ro)
          continue; /* Ignore invalid user provided filename and continue */
       }
 
-      if (!load_foz_dbs(foz_db, db_idx, file_idx, true)) {
-         fclose(db_idx);
+      if (!load_foz_db_ro(foz_db, db_idx, file_idx)) {
          fclose(foz_db->file[file_idx]);
          foz_db->file[file_idx] = NULL;
 
          continue; /* Ignore invalid user provided foz db */
       }
 
-      fclose(db_idx);
       file_idx++;
 
       if (file_idx >= FOZ_MAX_DBS)
@@ -400,18 +553,15 @@ load_from_list_file(struct foz_db *foz_db, const char *foz_dbs_list_filename)
          continue;
       }
 
-      /* Must be set before calling load_foz_dbs() */
       foz_db->file[file_idx] = db_file;
 
-      if (!load_foz_dbs(foz_db, idx_file, file_idx, true)) {
+      if (!load_foz_db_ro(foz_db, idx_file, file_idx)) {
          fclose(db_file);
-         fclose(idx_file);
          foz_db->file[file_idx] = NULL;
 
          continue;
       }
 
-      fclose(idx_file);
       file_idx++;
 
       if (file_idx >= FOZ_MAX_DBS)
@@ -522,17 +672,32 @@ foz_prepare(struct foz_db *foz_db, char *cache_path)
       if (foz_db->file[0] == NULL || foz_db->db_idx == NULL)
          goto fail;
 
-      if (!load_foz_dbs(foz_db, foz_db->db_idx, 0, false))
+      if (!load_foz_dbs(foz_db, foz_db->db_idx, 0))
          goto fail;
    }
 
    char *foz_dbs_ro = getenv("MESA_DISK_CACHE_READ_ONLY_FOZ_DBS");
+#ifdef FOZ_DB_UTIL_DYNAMIC_LIST
+   char *foz_dbs_list =
+      getenv("MESA_DISK_CACHE_READ_ONLY_FOZ_DBS_DYNAMIC_LIST");
+#else
+   char *foz_dbs_list = NULL;
+#endif
+
+   /* Large read only dbs can take a while to index, load them in parallel
+    * rather than blocking startup. If the queue can't be created, they are
+    * loaded synchronously. The queue has its own thread: lookups from
+    * disk_cache jobs wait for the loads, so they can't share their threads.
+    */
+   if (foz_dbs_ro || foz_dbs_list) {
+      util_queue_init(&foz_db->index_queue, "foz_idx", FOZ_MAX_DBS, 1, 0,
+                      NULL);
+   }
+
    if (foz_dbs_ro)
       load_foz_dbs_ro(foz_db, foz_dbs_ro);
 
 #ifdef FOZ_DB_UTIL_DYNAMIC_LIST
-   char *foz_dbs_list =
-      getenv("MESA_DISK_CACHE_READ_ONLY_FOZ_DBS_DYNAMIC_LIST");
    if (foz_dbs_list)
       foz_dbs_list_updater_init(foz_db, foz_dbs_list);
 #endif
@@ -560,11 +725,19 @@ foz_destroy(struct foz_db *foz_db)
    }
 #endif
 
+   if (util_queue_is_initialized(&foz_db->index_queue))
+      util_queue_destroy(&foz_db->index_queue);
+
    if (foz_db->db_idx)
       fclose(foz_db->db_idx);
    for (unsigned i = 0; i < FOZ_MAX_DBS; i++) {
       if (foz_db->file[i])
          fclose(foz_db->file[i]);
+
+      if (foz_db->ro_index[i].entries) {
+         util_queue_fence_destroy(&foz_db->ro_index[i].ready);
+         ralloc_free(foz_db->ro_index[i].mem_ctx);
+      }
    }
 
    if (foz_db->mem_ctx) {
@@ -591,6 +764,8 @@ foz_read_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
    if (!foz_db->alive)
       return NULL;
 
+   wait_foz_dbs_ro(foz_db);
+
    simple_mtx_lock(&foz_db->mtx);
 
    struct foz_db_entry *entry =
@@ -599,6 +774,8 @@ foz_read_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
       update_foz_index(foz_db, foz_db->db_idx, 0);
       entry = _mesa_hash_table_u64_search(foz_db->index_db, hash);
    }
+   if (!entry)
+      entry = search_foz_dbs_ro(foz_db, hash);
    if (!entry) {
       simple_mtx_unlock(&foz_db->mtx);
       return NULL;
@@ -659,6 +836,8 @@ foz_write_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
    if (!foz_db->alive || !foz_db->file[0])
       return false;
 
+   wait_foz_dbs_ro(foz_db);
+
    /* The flock is per-fd, not per thread, we do it outside of the main mutex to avoid having to
     * wait in the mutex potentially blocking reads. We use the secondary flock_mtx to stop race
     * conditions between the write threads sharing the same file descriptor. */
@@ -676,6 +855,8 @@ foz_write_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
 
    struct foz_db_entry *entry =
       _mesa_hash_table_u64_search(foz_db->index_db, hash);
+   if (!entry)
+      entry = search_foz_dbs_ro(foz_db, hash);
    if (entry) {
       simple_mtx_unlock(&foz_db->mtx);
       flock(fileno(foz_db->file[0]), LOCK_UN);
@@ -46,6 +46,7 @@
 #include <stdio.h>
 
 #include "simple_mtx.h"
+#include "u_queue.h"
 
 /* Max number of DBs our implementation can read from at once */
 #define FOZ_MAX_DBS 9 /* Default DB + 8 Read only DBs */
@@ -83,13 +84,26 @@ struct foz_dbs_list_updater {
    thrd_t thrd;
 };
 
+/* The index of a read only foz db. Indices are loaded in the background,
+ * lookups only wait for the indices of the dbs they search.
+ */
+struct foz_ro_index {
+   void *mem_ctx;
+   struct hash_table_u64 *entries;   /* NULL if the db isn't loaded */
+   FILE *idx_file;                   /* Closed once the index is loaded */
+   uint8_t file_idx;
+   struct util_queue_fence ready;
+};
+
 struct foz_db {
    FILE *file[FOZ_MAX_DBS];          /* An array of all foz dbs */
    FILE *db_idx;                     /* The default writable foz db idx */
    simple_mtx_t mtx;                 /* Mutex for file/hash table read/writes */
    simple_mtx_t flock_mtx;           /* Mutex for flocking the file for writes */
    void *mem_ctx;
-   struct hash_table_u64 *index_db;  /* Hash table of all foz db entries */
+   struct hash_table_u64 *index_db;  /* Hash table of the default foz db entries */
+   struct foz_ro_index ro_index[FOZ_MAX_DBS]; /* Read only foz dbs, from 1 */
+   struct util_queue index_queue;    /* Loads the read only foz db indices */
    bool alive;
    const char *cache_path;
    struct foz_dbs_list_updater updater;
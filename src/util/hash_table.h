@@ -37,6 +37,13 @@
 extern "C" {
 #endif
 
+/* Control byte values of entries that don't hold a key, see
+ * hash_table_group.h. Shared with struct set.
+ */
+#define HASH_CTRL_EMPTY    0x80
+#define HASH_CTRL_DELETED  0xfe
+#define HASH_CTRL_PAD      0xff
+
 struct hash_entry {
    uint32_t hash;
    const void *key;
@@ -45,13 +52,11 @@ struct hash_entry {
 
 struct hash_table {
    struct hash_entry *table;
+   uint8_t *ctrl; /* one control byte per entry, see hash_table_group.h */
    uint32_t (*key_hash_function)(const void *key);
    bool (*key_equals_function)(const void *a, const void *b);
    const void *deleted_key;
    uint32_t size;
-   uint32_t rehash;
-   uint64_t size_magic;
-   uint64_t rehash_magic;
    uint32_t max_entries;
    uint32_t size_index;
    uint32_t entries;
@@ -158,6 +163,7 @@ _mesa_hash_table_reserve(struct hash_table *ht, unsigned size);
    for (struct hash_entry *entry = _mesa_hash_table_next_entry_unsafe(ht, NULL);  \
         (ht)->entries;                                                     \
         entry->hash = 0, entry->key = (void*)NULL, entry->data = NULL,      \
+        (ht)->ctrl[entry - (ht)->table] = HASH_CTRL_EMPTY,                 \
         (ht)->entries--, entry = _mesa_hash_table_next_entry_unsafe(ht, entry))
 
 static inline void
@@ -0,0 +1,199 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Control bytes shared by the hash_table and set implementations.
+ *
+ * Next to its entries, a table keeps one control byte per entry, telling
+ * whether the entry is empty, deleted or full, and for full entries 7 bits
+ * of the hash of the key. Lookups compare the control bytes of a whole group
+ * of entries at once with SSE2 or NEON, and only look at entries whose 7 bits
+ * match, so most probes only touch the densely packed control bytes instead
+ * of the entries themselves.
+ *
+ * The control bytes of tables smaller than a group are padded to a full
+ * group with HASH_CTRL_PAD, which never matches.
+ */
+
+#ifndef HASH_TABLE_GROUP_H
+#define HASH_TABLE_GROUP_H
+
+#include <string.h>
+
+#include "bitscan.h"
+#include "hash_table.h"
+#include "u_endian.h"
+#include "u_math.h"
+
+#if defined(__SSE2__) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)) || (defined(_M_X64) && !defined(_M_ARM64EC))
+#include <emmintrin.h>
+#define HASH_GROUP_SSE2 1
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && UTIL_ARCH_LITTLE_ENDIAN
+#include <arm_neon.h>
+#define HASH_GROUP_NEON 1
+#endif
+
+/* The HASH_CTRL_* values of entries without a key are in hash_table.h, for
+ * hash_table_foreach_remove and set_foreach_remove. Full entries store 7
+ * bits of the hash, with the top bit clear.
+ */
+
+#ifdef HASH_GROUP_SSE2
+#define HASH_GROUP_WIDTH   16
+/* One bit per control byte in a group mask. */
+#define HASH_GROUP_SHIFT   0
+#else
+#define HASH_GROUP_WIDTH   8
+/* The top bit of each control byte in a group mask. */
+#define HASH_GROUP_SHIFT   3
+#endif
+
+#define HASH_MIN_SIZE_INDEX 2
+
+/* Returns the number of control bytes allocated for a table of the given
+ * size.
+ */
+static inline uint32_t
+hash_ctrl_size(uint32_t size)
+{
+   return MAX2(size, HASH_GROUP_WIDTH);
+}
+
+static inline void
+hash_ctrl_init(uint8_t *ctrl, uint32_t size)
+{
+   memset(ctrl, HASH_CTRL_EMPTY, size);
+   memset(ctrl + size, HASH_CTRL_PAD, hash_ctrl_size(size) - size);
+}
+
+/* The maximum number of entries, deleted or not, in a table of size
+ * 1 << size_index. Groups need some empty entries to terminate probing.
+ */
+static inline uint32_t
+hash_max_entries(unsigned size_index)
+{
+   return (uint32_t)((7ull << size_index) / 8);
+}
+
+/* Probing state. The position of the first group and the 7 bits stored in
+ * the control bytes both come from a multiplicative hash, so that weak
+ * hashes like _mesa_hash_pointer don't cluster in power of two tables.
+ */
+struct hash_probe {
+   uint32_t pos;
+   uint32_t mask;
+   uint32_t stride;
+   uint8_t h2;
+};
+
+static inline struct hash_probe
+hash_probe_start(uint32_t hash, unsigned size_index)
+{
+   uint64_t h = hash * 0x9e3779b97f4a7c15ull;
+   uint32_t mask = (1u << size_index) - 1;
+
+   return (struct hash_probe) {
+      .pos = (uint32_t)(h >> (57 - size_index)) & mask & ~(HASH_GROUP_WIDTH - 1),
+      .mask = mask,
+      .stride = 0,
+      .h2 = (uint8_t)(h >> 57),
+   };
+}
+
+/* Moves to the next group. Triangular probing visits every group exactly
+ * once in a power of two table.
+ */
+static inline void
+hash_probe_next(struct hash_probe *probe)
+{
+   probe->stride += HASH_GROUP_WIDTH;
+   probe->pos = (probe->pos + probe->stride) & probe->mask;
+}
+
+static inline uint32_t
+hash_num_groups(unsigned size_index)
+{
+   return MAX2((1u << size_index) / HASH_GROUP_WIDTH, 1);
+}
+
+#ifndef HASH_GROUP_SSE2
+static inline uint64_t
+hash_group_load(const uint8_t *ctrl)
+{
+   uint64_t group;
+   memcpy(&group, ctrl, sizeof(group));
+   return util_le64_to_cpu(group);
+}
+#endif
+
+/* Returns the mask of the control bytes of the group equal to h2.
+ *
+ * Without SIMD, there can be false positives next to a true positive, the
+ * caller compares the keys anyway.
+ */
+static inline uint64_t
+hash_group_match(const uint8_t *ctrl, uint8_t h2)
+{
+#if defined(HASH_GROUP_SSE2)
+   __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+   return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(h2)));
+#elif defined(HASH_GROUP_NEON)
+   uint8x8_t eq = vceq_u8(vld1_u8(ctrl), vdup_n_u8(h2));
+   return vget_lane_u64(vreinterpret_u64_u8(eq), 0) & 0x8080808080808080ull;
+#else
+   uint64_t x = hash_group_load(ctrl) ^ (0x0101010101010101ull * h2);
+   return (x - 0x0101010101010101ull) & ~x & 0x8080808080808080ull;
+#endif
+}
+
+/* Returns the mask of the empty control bytes of the group. */
+static inline uint64_t
+hash_group_match_empty(const uint8_t *ctrl)
+{
+#if defined(HASH_GROUP_SSE2)
+   __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+   return (uint32_t)_mm_movemask_epi8(
+      _mm_cmpeq_epi8(group, _mm_set1_epi8((char)HASH_CTRL_EMPTY)));
+#elif defined(HASH_GROUP_NEON)
+   uint8x8_t eq = vceq_u8(vld1_u8(ctrl), vdup_n_u8(HASH_CTRL_EMPTY));
+   return vget_lane_u64(vreinterpret_u64_u8(eq), 0) & 0x8080808080808080ull;
+#else
+   /* Only HASH_CTRL_EMPTY has the top bit set and bit 1 clear. */
+   uint64_t group = hash_group_load(ctrl);
+   return group & ~(group << 6) & 0x8080808080808080ull;
+#endif
+}
+
+/* Returns the mask of the empty or deleted control bytes of the group. */
+static inline uint64_t
+hash_group_match_available(const uint8_t *ctrl)
+{
+#if defined(HASH_GROUP_SSE2)
+   /* As signed bytes, only empty and deleted entries are below the padding. */
+   __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+   return (uint32_t)_mm_movemask_epi8(
+      _mm_cmpgt_epi8(_mm_set1_epi8((char)HASH_CTRL_PAD), group));
+#elif defined(HASH_GROUP_NEON)
+   uint8x8_t ctrl8 = vld1_u8(ctrl);
+   uint8x8_t avail = vand_u8(vtst_u8(ctrl8, vdup_n_u8(0x80)),
+                             vmvn_u8(vceq_u8(ctrl8, vdup_n_u8(HASH_CTRL_PAD))));
+   return vget_lane_u64(vreinterpret_u64_u8(avail), 0) & 0x8080808080808080ull;
+#else
+   /* The top bit set and bit 0 clear. */
+   uint64_t group = hash_group_load(ctrl);
+   return group & ~(group << 7) & 0x8080808080808080ull;
+#endif
+}
+
+/* Returns the index in the group of the next bit of the mask, and clears
+ * it.
+ */
+static inline unsigned
+hash_group_next(uint64_t *mask)
+{
+   return u_bit_scan64(mask) >> HASH_GROUP_SHIFT;
+}
+
+#endif /* HASH_TABLE_GROUP_H */
@@ -16,6 +16,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/file.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "crc32.h"
@@ -56,6 +57,7 @@ struct mesa_index_db_hash_entry {
    uint64_t last_access_time;
    uint32_t size;
    bool evicted;
+   bool access_dirty;
 };
 
 static inline bool mesa_db_seek_end(FILE *file)
@@ -85,6 +87,11 @@ static inline bool mesa_db_write_data(FILE *file, const void *data, size_t size)
 }
 #define mesa_db_write(file, var) mesa_db_write_data(file, var, sizeof(*(var)))
 
+static inline bool mesa_db_pread(int fd, void *data, size_t size, off_t pos)
+{
+   return pread(fd, data, size, pos) == (ssize_t)size;
+}
+
 static inline bool mesa_db_truncate(FILE *file, long pos)
 {
    return !ftruncate(fileno(file), pos);
@@ -96,6 +103,9 @@ mesa_db_reopen_file(struct mesa_cache_db_file *db_file);
 static void
 mesa_db_close_file(struct mesa_cache_db_file *db_file);
 
+static void
+mesa_db_flush_access_times(struct mesa_cache_db *db);
+
 static int
 mesa_db_flock(FILE *file, int op)
 {
@@ -123,6 +133,8 @@ mesa_db_lock(struct mesa_cache_db *db)
    if (mesa_db_flock(db->index.file, LOCK_EX) < 0)
       goto unlock_cache;
 
+   mesa_db_flush_access_times(db);
+
    return true;
 
 unlock_cache:
@@ -168,6 +180,13 @@ mesa_db_generate_uuid(void)
    return ((os_time_get() / 1000000) << 32) | rand();
 }
 
+static bool
+mesa_db_header_valid(const struct mesa_db_file_header *header)
+{
+   return !strncmp(header->magic, MESA_CACHE_DB_MAGIC, sizeof(header->magic)) &&
+          header->version == MESA_CACHE_DB_VERSION && header->uuid;
+}
+
 static bool
 mesa_db_read_header(FILE *file, struct mesa_db_file_header *header)
 {
@@ -177,11 +196,7 @@ mesa_db_read_header(FILE *file, struct mesa_db_file_header *header)
    if (!mesa_db_read(file, header))
       return false;
 
-   if (strncmp(header->magic, MESA_CACHE_DB_MAGIC, sizeof(header->magic)) ||
-       header->version != MESA_CACHE_DB_VERSION || !header->uuid)
-      return false;
-
-   return true;
+   return mesa_db_header_valid(header);
 }
 
 static bool
@@ -263,7 +278,7 @@ mesa_db_zap(struct mesa_cache_db *db)
 }
 
 static bool
-mesa_db_index_entry_valid(struct mesa_index_db_file_entry *entry)
+mesa_db_index_entry_valid(const struct mesa_index_db_file_entry *entry)
 {
    return entry->size && entry->hash &&
           (int64_t)entry->cache_db_file_offset >= sizeof(struct mesa_db_file_header);
@@ -275,16 +290,50 @@ mesa_db_cache_entry_valid(struct mesa_cache_db_file_entry *entry)
    return entry->size && entry->crc;
 }
 
+static size_t
+mesa_db_add_index_entries(struct mesa_cache_db *db,
+                          const struct mesa_index_db_file_entry *index_entries,
+                          size_t num_entries)
+{
+   const struct mesa_index_db_file_entry *index_entry = index_entries;
+   struct mesa_index_db_hash_entry *hash_entry;
+   size_t i;
+
+   _mesa_hash_table_reserve(db->index_db->table,
+                            _mesa_hash_table_num_entries(db->index_db->table) +
+                            num_entries);
+
+   for (i = 0; i < num_entries; i++, index_entry++) {
+      /* Check whether the index entry looks valid or we have a corrupted DB */
+      if (!mesa_db_index_entry_valid(index_entry))
+         break;
+
+      hash_entry = ralloc(db->mem_ctx, struct mesa_index_db_hash_entry);
+      if (!hash_entry)
+         break;
+
+      hash_entry->cache_db_file_offset = index_entry->cache_db_file_offset;
+      hash_entry->index_db_file_offset = db->index.offset;
+      hash_entry->last_access_time = index_entry->last_access_time;
+      hash_entry->size = index_entry->size;
+      hash_entry->access_dirty = false;
+
+      _mesa_hash_table_u64_insert(db->index_db, index_entry->hash, hash_entry);
+
+      db->index.offset += sizeof(*index_entry);
+   }
+
+   return i;
+}
+
 static bool
 mesa_db_update_index(struct mesa_cache_db *db)
 {
-   struct mesa_index_db_hash_entry *hash_entry;
-   struct mesa_index_db_file_entry *index_entries, *index_entry;
+   struct mesa_index_db_file_entry *index_entries;
    size_t file_length;
-   size_t old_entries, new_entries;
+   size_t new_entries;
    size_t new_index_size;
    bool ret = false;
-   int i;
 
    if (!mesa_db_seek_end(db->index.file))
       return false;
@@ -296,33 +345,13 @@ mesa_db_update_index(struct mesa_cache_db *db)
    if (!mesa_db_seek(db->index.file, db->index.offset))
       return false;
 
-   old_entries = _mesa_hash_table_num_entries(db->index_db->table);
    new_entries = (file_length - db->index.offset) / sizeof(*index_entries);
-   _mesa_hash_table_reserve(db->index_db->table, old_entries + new_entries);
-
    new_index_size = new_entries * sizeof(*index_entries);
    index_entries = malloc(new_index_size);
    if (!mesa_db_read_data(db->index.file, index_entries, new_index_size))
       goto error;
 
-   for (i = 0, index_entry = index_entries; i < new_entries; i++, index_entry++) {
-      /* Check whether the index entry looks valid or we have a corrupted DB */
-      if (!mesa_db_index_entry_valid(index_entry))
-         break;
-
-      hash_entry = ralloc(db->mem_ctx, struct mesa_index_db_hash_entry);
-      if (!hash_entry)
-         break;
-
-      hash_entry->cache_db_file_offset = index_entry->cache_db_file_offset;
-      hash_entry->index_db_file_offset = db->index.offset;
-      hash_entry->last_access_time = index_entry->last_access_time;
-      hash_entry->size = index_entry->size;
-
-      _mesa_hash_table_u64_insert(db->index_db, index_entry->hash, hash_entry);
-
-      db->index.offset += sizeof(*index_entry);
-   }
+   mesa_db_add_index_entries(db, index_entries, new_entries);
 
    if (mesa_db_seek(db->index.file, db->index.offset) &&
        db->index.offset == file_length)
@@ -333,9 +362,118 @@ error:
    return ret;
 }
 
+/* Both file headers still carry the UUID of the in-memory index. */
+static bool
+mesa_db_headers_current(struct mesa_cache_db *db)
+{
+   struct mesa_db_file_header cache_header;
+   struct mesa_db_file_header index_header;
+
+   return mesa_db_pread(db->cache.read_fd, &cache_header,
+                        sizeof(cache_header), 0) &&
+          mesa_db_pread(db->index.read_fd, &index_header,
+                        sizeof(index_header), 0) &&
+          mesa_db_header_valid(&cache_header) &&
+          mesa_db_header_valid(&index_header) &&
+          cache_header.uuid == db->uuid &&
+          index_header.uuid == db->uuid;
+}
+
+/* Compaction marks both files with a zero UUID while it moves entries. */
+static bool
+mesa_db_compaction_in_progress(struct mesa_cache_db *db)
+{
+   struct mesa_db_file_header header;
+
+   return mesa_db_pread(db->cache.read_fd, &header, sizeof(header), 0) &&
+          !strncmp(header.magic, MESA_CACHE_DB_MAGIC, sizeof(header.magic)) &&
+          header.version == MESA_CACHE_DB_VERSION && !header.uuid;
+}
+
+/* Lock-free counterpart of mesa_db_update_index().
+ *
+ * Only whole entries below the file size reported by fstat() are read,
+ * a writer may still be appending past it. A partially added index isn't
+ * an error here, the locked path takes care of real corruption.
+ */
+static bool
+mesa_db_update_index_lockless(struct mesa_cache_db *db)
+{
+   struct mesa_index_db_file_entry *index_entries;
+   size_t new_entries, new_index_size;
+   struct stat st;
+   bool ret;
+
+   if (fstat(db->index.read_fd, &st) < 0 || st.st_size < db->index.offset)
+      return false;
+
+   new_entries = (st.st_size - db->index.offset) / sizeof(*index_entries);
+   if (!new_entries)
+      return true;
+
+   new_index_size = new_entries * sizeof(*index_entries);
+   index_entries = malloc(new_index_size);
+   if (!index_entries)
+      return false;
+
+   ret = mesa_db_pread(db->index.read_fd, index_entries, new_index_size,
+                       db->index.offset);
+   if (ret)
+      mesa_db_add_index_entries(db, index_entries, new_entries);
+
+   free(index_entries);
+   return ret;
+}
+
+/* Write the access times recorded by lock-free reads back to the index
+ * file. Must be called with the lock held. This is best effort, the times
+ * are dropped if another process replaced the database meanwhile.
+ */
+static void
+mesa_db_flush_access_times(struct mesa_cache_db *db)
+{
+   struct mesa_index_db_file_entry index_entry;
+   bool write;
+
+   if (!util_dynarray_num_elements(&db->dirty_access_entries,
+                                   struct mesa_index_db_hash_entry *))
+      return;
+
+   write = !mesa_db_uuid_changed(db);
+
+   util_dynarray_foreach(&db->dirty_access_entries,
+                         struct mesa_index_db_hash_entry *, entry) {
+      struct mesa_index_db_hash_entry *hash_entry = *entry;
+
+      if (!hash_entry->access_dirty)
+         continue;
+
+      hash_entry->access_dirty = false;
+
+      if (!write ||
+          !mesa_db_seek(db->index.file, hash_entry->index_db_file_offset) ||
+          !mesa_db_read(db->index.file, &index_entry) ||
+          !mesa_db_index_entry_valid(&index_entry) ||
+          index_entry.cache_db_file_offset != hash_entry->cache_db_file_offset ||
+          index_entry.size != hash_entry->size)
+         continue;
+
+      index_entry.last_access_time = hash_entry->last_access_time;
+
+      if (!mesa_db_seek(db->index.file, hash_entry->index_db_file_offset) ||
+          !mesa_db_write(db->index.file, &index_entry))
+         write = false;
+   }
+
+   util_dynarray_clear(&db->dirty_access_entries);
+
+   fflush(db->index.file);
+}
+
 static void
 mesa_db_hash_table_reset(struct mesa_cache_db *db)
 {
+   util_dynarray_clear(&db->dirty_access_entries);
    _mesa_hash_table_u64_clear(db->index_db);
    ralloc_free(db->mem_ctx);
    db->mem_ctx = ralloc_context(NULL);
@@ -443,6 +581,8 @@ mesa_db_open_file(struct mesa_cache_db_file *db_file,
       return false;
    }
 
+   db_file->read_fd = -1;
+
    return true;
 }
 
@@ -477,6 +617,42 @@ mesa_db_free_file(struct mesa_cache_db_file *db_file)
    free(db_file->path);
 }
 
+/* Opens the descriptors used by the lock-free read path. They are opened
+ * for each read like the locked path reopens its files, which doesn't hold
+ * descriptors for idle databases and picks up files replaced by another
+ * process.
+ */
+static bool
+mesa_db_open_read_fds(struct mesa_cache_db *db)
+{
+   db->cache.read_fd = open(db->cache.path, O_RDONLY | O_CLOEXEC);
+   if (db->cache.read_fd < 0)
+      return false;
+
+   db->index.read_fd = open(db->index.path, O_RDONLY | O_CLOEXEC);
+   if (db->index.read_fd < 0) {
+      close(db->cache.read_fd);
+      db->cache.read_fd = -1;
+      return false;
+   }
+
+   return true;
+}
+
+static void
+mesa_db_close_read_fds(struct mesa_cache_db *db)
+{
+   if (db->cache.read_fd >= 0) {
+      close(db->cache.read_fd);
+      db->cache.read_fd = -1;
+   }
+
+   if (db->index.read_fd >= 0) {
+      close(db->index.read_fd);
+      db->index.read_fd = -1;
+   }
+}
+
 static bool
 mesa_db_remove_file(struct mesa_cache_db_file *db_file,
                   const char *cache_path,
@@ -697,6 +873,8 @@ mesa_cache_db_open(struct mesa_cache_db *db, const char *cache_path)
 
    simple_mtx_init(&db->flock_mtx, mtx_plain);
 
+   util_dynarray_init(&db->dirty_access_entries, NULL);
+
    db->index_db = _mesa_hash_table_u64_create(NULL);
    if (!db->index_db)
       goto destroy_mtx;
@@ -739,6 +917,14 @@ mesa_db_wipe_path(const char *cache_path)
 void
 mesa_cache_db_close(struct mesa_cache_db *db)
 {
+   /* Taking the lock writes back access times of lock-free reads */
+   if (util_dynarray_num_elements(&db->dirty_access_entries,
+                                  struct mesa_index_db_hash_entry *) &&
+       mesa_db_lock(db))
+      mesa_db_unlock(db);
+
+   util_dynarray_fini(&db->dirty_access_entries);
+
    _mesa_hash_table_u64_destroy(db->index_db);
    simple_mtx_destroy(&db->flock_mtx);
    ralloc_free(db->mem_ctx);
@@ -760,6 +946,104 @@ mesa_cache_db_file_entry_size(void)
    return sizeof(struct mesa_cache_db_file_entry);
 }
 
+/* Look up an entry without taking the file lock.
+ *
+ * Readers only pread() from the database files. Writers only append to
+ * them, while compaction invalidates the header UUID before it moves any
+ * entry and sets a new UUID once it's done. Hence the read entry is
+ * consistent if both file headers carry the UUID of the in-memory index
+ * before and after reading it, and the entry's key and CRC match.
+ *
+ * Returns false if the lookup needs to be redone under the lock, e.g.
+ * because another process has compacted the database. A compaction that
+ * is still running is reported as a miss instead, readers never wait for
+ * it.
+ */
+static bool
+mesa_db_read_entry_lockless(struct mesa_cache_db *db,
+                            const uint8_t *cache_key_160bit,
+                            void **data, size_t *size)
+{
+   uint64_t hash = to_mesa_cache_db_hash(cache_key_160bit);
+   struct mesa_cache_db_file_entry cache_entry;
+   struct mesa_index_db_hash_entry *hash_entry;
+   void *blob = NULL;
+   bool ret = false;
+
+   *data = NULL;
+
+   simple_mtx_lock(&db->flock_mtx);
+
+   if (!db->alive) {
+      ret = true;
+      goto out;
+   }
+
+   if (!mesa_db_open_read_fds(db))
+      goto out;
+
+   if (!mesa_db_headers_current(db) || !mesa_db_update_index_lockless(db))
+      goto out;
+
+   /* Index entries read above may come from a database that was being
+    * compacted, so a miss must be confirmed by re-checking the UUID.
+    */
+   hash_entry = _mesa_hash_table_u64_search(db->index_db, hash);
+   if (!hash_entry) {
+      ret = mesa_db_headers_current(db);
+      goto out;
+   }
+
+   if (!mesa_db_pread(db->cache.read_fd, &cache_entry, sizeof(cache_entry),
+                      hash_entry->cache_db_file_offset) ||
+       !mesa_db_cache_entry_valid(&cache_entry) ||
+       cache_entry.size != hash_entry->size)
+      goto out;
+
+   if (memcmp(cache_entry.key, cache_key_160bit, sizeof(cache_entry.key))) {
+      ret = mesa_db_headers_current(db);
+      goto out;
+   }
+
+   blob = malloc(cache_entry.size);
+   if (!blob) {
+      ret = true;
+      goto out;
+   }
+
+   if (!mesa_db_pread(db->cache.read_fd, blob, cache_entry.size,
+                      hash_entry->cache_db_file_offset + sizeof(cache_entry)) ||
+       util_hash_crc32(blob, cache_entry.size) != cache_entry.crc ||
+       !mesa_db_headers_current(db)) {
+      free(blob);
+      goto out;
+   }
+
+   /* The access time is written to the index file by the next locked
+    * operation, see mesa_db_flush_access_times().
+    */
+   hash_entry->last_access_time = os_time_get_nano();
+   if (!hash_entry->access_dirty) {
+      util_dynarray_append(&db->dirty_access_entries,
+                           struct mesa_index_db_hash_entry *, hash_entry);
+      hash_entry->access_dirty = true;
+   }
+
+   *data = blob;
+   *size = cache_entry.size;
+   ret = true;
+
+out:
+   if (!ret && db->cache.read_fd >= 0)
+      ret = mesa_db_compaction_in_progress(db);
+
+   mesa_db_close_read_fds(db);
+
+   simple_mtx_unlock(&db->flock_mtx);
+
+   return ret;
+}
+
 void *
 mesa_cache_db_read_entry(struct mesa_cache_db *db,
                          const uint8_t *cache_key_160bit,
@@ -771,6 +1055,9 @@ mesa_cache_db_read_entry(struct mesa_cache_db *db,
    struct mesa_index_db_hash_entry *hash_entry;
    void *data = NULL;
 
+   if (mesa_db_read_entry_lockless(db, cache_key_160bit, &data, size))
+      return data;
+
    if (!mesa_db_lock(db))
       return NULL;
 
@@ -836,12 +1123,19 @@ fail:
 }
 
 static bool
-mesa_cache_db_has_space_locked(struct mesa_cache_db *db, size_t blob_size)
+mesa_db_has_space(struct mesa_cache_db *db, uint64_t cache_file_size,
+                  size_t blob_size)
 {
-   return ftell(db->cache.file) + blob_file_size(blob_size) -
+   return cache_file_size + blob_file_size(blob_size) -
           sizeof(struct mesa_db_file_header) <= db->max_cache_size;
 }
 
+static bool
+mesa_cache_db_has_space_locked(struct mesa_cache_db *db, size_t blob_size)
+{
+   return mesa_db_has_space(db, ftell(db->cache.file), blob_size);
+}
+
 static size_t
 mesa_cache_db_eviction_size(struct mesa_cache_db *db)
 {
@@ -906,6 +1200,7 @@ mesa_cache_db_entry_write(struct mesa_cache_db *db,
    hash_entry->index_db_file_offset = ftell(db->index.file);
    hash_entry->last_access_time = index_entry.last_access_time;
    hash_entry->size = index_entry.size;
+   hash_entry->access_dirty = false;
 
    if (!mesa_db_write(db->cache.file, &cache_entry) ||
        !mesa_db_write_data(db->cache.file, blob, blob_size) ||
@@ -981,25 +1276,59 @@ fail:
    return false;
 }
 
+uint64_t
+mesa_cache_db_size(struct mesa_cache_db *db)
+{
+   struct stat st;
+
+   /* Entries are only ever appended to the cache file, it's fine to check
+    * its size without taking the lock.
+    */
+   if (stat(db->cache.path, &st) < 0 ||
+       st.st_size < sizeof(struct mesa_db_file_header))
+      return 0;
+
+   return st.st_size - sizeof(struct mesa_db_file_header);
+}
+
 bool
 mesa_cache_db_has_space(struct mesa_cache_db *db, size_t blob_size)
 {
-   bool has_space;
+   return mesa_db_has_space(db, mesa_cache_db_size(db) +
+                            sizeof(struct mesa_db_file_header), blob_size);
+}
+
+bool
+mesa_cache_db_compact(struct mesa_cache_db *db)
+{
+   uint64_t target_size = db->max_cache_size / 2;
+   uint64_t cache_size;
 
    if (!mesa_db_lock(db))
       return false;
 
+   if (!db->alive)
+      goto fail;
+
+   if (mesa_db_uuid_changed(db) && !mesa_db_reload(db))
+      goto fail_fatal;
+
    if (!mesa_db_seek_end(db->cache.file))
       goto fail_fatal;
 
-   has_space = mesa_cache_db_has_space_locked(db, blob_size);
+   /* Another process may have compacted the DB already */
+   cache_size = ftell(db->cache.file) - sizeof(struct mesa_db_file_header);
+   if (cache_size > target_size &&
+       !mesa_db_compact(db, cache_size - target_size, NULL))
+      goto fail_fatal;
 
    mesa_db_unlock(db);
 
-   return has_space;
+   return true;
 
 fail_fatal:
    mesa_db_zap(db);
+fail:
    mesa_db_unlock(db);
 
    return false;
@@ -16,6 +16,7 @@
 
 #include "detect_os.h"
 #include "simple_mtx.h"
+#include "u_dynarray.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -23,6 +24,7 @@ extern "C" {
 
 struct mesa_cache_db_file {
    FILE *file;
+   int read_fd; /* only open during lock-free reads */
    char *path;
    off_t offset;
    uint64_t uuid;
@@ -37,6 +39,8 @@ struct mesa_cache_db {
    void *mem_ctx;
    uint64_t uuid;
    bool alive;
+   /* Entries whose access time was updated by a lock-free read */
+   struct util_dynarray dirty_access_entries;
 };
 
 #if DETECT_OS_WINDOWS == 0
@@ -73,6 +77,12 @@ mesa_db_wipe_path(const char *cache_path);
 bool
 mesa_cache_db_has_space(struct mesa_cache_db *db, size_t blob_size);
 
+uint64_t
+mesa_cache_db_size(struct mesa_cache_db *db);
+
+bool
+mesa_cache_db_compact(struct mesa_cache_db *db);
+
 double
 mesa_cache_db_eviction_score(struct mesa_cache_db *db);
 #else
@@ -134,6 +144,18 @@ mesa_cache_db_has_space(struct mesa_cache_db *db, size_t blob_size)
    return false;
 }
 
+static inline uint64_t
+mesa_cache_db_size(struct mesa_cache_db *db)
+{
+   return 0;
+}
+
+static inline bool
+mesa_cache_db_compact(struct mesa_cache_db *db)
+{
+   return false;
+}
+
 static inline double
 mesa_cache_db_eviction_score(struct mesa_cache_db *db)
 {
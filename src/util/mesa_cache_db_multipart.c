@@ -9,6 +9,7 @@
 #include "detect_os.h"
 #include "string.h"
 #include "mesa_cache_db_multipart.h"
+#include "u_atomic.h"
 #include "u_debug.h"
 
 bool
@@ -20,6 +21,8 @@ mesa_cache_db_multipart_open(struct mesa_cache_db_multipart *db,
 #else
    db->num_parts = debug_get_num_option("MESA_DISK_CACHE_DATABASE_NUM_PARTS", 50);
    db->cache_path = cache_path;
+   db->compaction_needed = false;
+   db->compaction_queued = false;
    db->parts = calloc(db->num_parts, sizeof(*db->parts));
    if (!db->parts)
       return false;
@@ -128,7 +131,7 @@ mesa_cache_db_multipart_read_entry(struct mesa_cache_db_multipart *db,
                                    const uint8_t *cache_key_160bit,
                                    size_t *size)
 {
-   unsigned last_read_part = db->last_read_part;
+   unsigned last_read_part = p_atomic_read(&db->last_read_part);
 
    for (unsigned int i = 0; i < db->num_parts; i++) {
       unsigned int part = (last_read_part + i) % db->num_parts;
@@ -140,7 +143,7 @@ mesa_cache_db_multipart_read_entry(struct mesa_cache_db_multipart *db,
                                                   cache_key_160bit, size);
       if (cache_item) {
          /* Likely that the next entry lookup will hit the same DB part. */
-         db->last_read_part = part;
+         p_atomic_set(&db->last_read_part, part);
          return cache_item;
       }
    }
@@ -168,12 +171,61 @@ mesa_cache_db_multipart_select_victim_part(struct mesa_cache_db_multipart *db)
    return victim;
 }
 
+/* Whether none of the DB parts has a quarter of its space left. The scan
+ * starts at the part that is being written, which is usually the one that
+ * still has space.
+ */
+static bool
+mesa_cache_db_multipart_nearly_full(struct mesa_cache_db_multipart *db,
+                                    unsigned int first_part)
+{
+   uint64_t free_space = db->max_cache_size / db->num_parts / 4;
+
+   if (!db->max_cache_size)
+      return false;
+
+   for (unsigned int i = 0; i < db->num_parts; i++) {
+      unsigned int part = (first_part + i) % db->num_parts;
+
+      if (!mesa_cache_db_multipart_init_part(db, part) ||
+          mesa_cache_db_has_space(db->parts[part], free_space))
+         return false;
+   }
+
+   return true;
+}
+
+bool
+mesa_cache_db_multipart_should_compact(struct mesa_cache_db_multipart *db)
+{
+   return p_atomic_read(&db->compaction_needed) &&
+          !p_atomic_xchg(&db->compaction_queued, true);
+}
+
+bool
+mesa_cache_db_multipart_compact(struct mesa_cache_db_multipart *db)
+{
+   unsigned int victim;
+   bool ret = false;
+
+   p_atomic_set(&db->compaction_needed, false);
+
+   victim = mesa_cache_db_multipart_select_victim_part(db);
+
+   if (mesa_cache_db_multipart_init_part(db, victim))
+      ret = mesa_cache_db_compact(db->parts[victim]);
+
+   p_atomic_set(&db->compaction_queued, false);
+
+   return ret;
+}
+
 bool
 mesa_cache_db_multipart_entry_write(struct mesa_cache_db_multipart *db,
                                     const uint8_t *cache_key_160bit,
                                     const void *blob, size_t blob_size)
 {
-   unsigned last_written_part = db->last_written_part;
+   unsigned last_written_part = p_atomic_read(&db->last_written_part);
    int wpart = -1;
 
    for (unsigned int i = 0; i < db->num_parts; i++) {
@@ -195,11 +247,15 @@ mesa_cache_db_multipart_entry_write(struct mesa_cache_db_multipart *db,
     */
    if (wpart < 0)
       wpart = mesa_cache_db_multipart_select_victim_part(db);
+   else if (!p_atomic_read(&db->compaction_needed) &&
+            !p_atomic_read(&db->compaction_queued) &&
+            mesa_cache_db_multipart_nearly_full(db, wpart))
+      p_atomic_set(&db->compaction_needed, true);
 
    if (!mesa_cache_db_multipart_init_part(db, wpart))
       return false;
 
-   db->last_written_part = wpart;
+   p_atomic_set(&db->last_written_part, wpart);
 
    return mesa_cache_db_entry_write(db->parts[wpart], cache_key_160bit,
                                     blob, blob_size);
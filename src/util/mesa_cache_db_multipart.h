@@ -13,11 +13,13 @@
 struct mesa_cache_db_multipart {
    struct mesa_cache_db **parts;
    unsigned int num_parts;
-   volatile unsigned int last_read_part;
-   volatile unsigned int last_written_part;
+   unsigned int last_read_part;
+   unsigned int last_written_part;
    const char *cache_path;
    uint64_t max_cache_size;
    simple_mtx_t lock;
+   bool compaction_needed;
+   bool compaction_queued;
 };
 
 bool
@@ -45,4 +47,16 @@ void
 mesa_cache_db_multipart_entry_remove(struct mesa_cache_db_multipart *db,
                                      const uint8_t *cache_key_160bit);
 
+/* Incremental compaction: once the cache is nearly full, the least
+ * recently used DB part is compacted ahead of time, so that writes don't
+ * have to do it once all parts are full. Returns true if the caller should
+ * schedule mesa_cache_db_multipart_compact(), at most one compaction is
+ * scheduled at a time.
+ */
+bool
+mesa_cache_db_multipart_should_compact(struct mesa_cache_db_multipart *db);
+
+bool
+mesa_cache_db_multipart_compact(struct mesa_cache_db_multipart *db);
+
 #endif /* MESA_CACHE_DB_MULTIPART_H */
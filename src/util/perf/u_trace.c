@@ -496,7 +496,7 @@ u_trace_is_enabled(enum u_trace_type type)
 static void
 queue_init(struct u_trace_context *utctx)
 {
-   if (utctx->queue.jobs)
+   if (util_queue_is_initialized(&utctx->queue))
       return;
 
    bool ret = util_queue_init(
@@ -604,7 +604,7 @@ u_trace_context_fini(struct u_trace_context *utctx)
 
    free (utctx->dummy_indirect_data);
 
-   if (!utctx->queue.jobs)
+   if (!util_queue_is_initialized(&utctx->queue))
       return;
    util_queue_finish(&utctx->queue);
    util_queue_destroy(&utctx->queue);
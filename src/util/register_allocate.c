@@ -900,8 +900,8 @@ ra_compute_available_regs(struct ra_graph *g, unsigned int n, BITSET_WORD *regs)
          if (c->contig_len) {
             int start = MAX2(0, (int)n2->reg - c->contig_len + 1);
             int end = MIN2(g->regs->count, n2->reg + n2c->contig_len);
-            for (unsigned i = start; i < end; i++)
-               BITSET_CLEAR(regs, i);
+            if (end > start)
+               BITSET_CLEAR_RANGE(regs, start, end - 1);
          } else {
             for (int j = 0; j < BITSET_WORDS(g->regs->count); j++)
                regs[j] &= ~g->regs->regs[n2->reg].conflicts[j];
@@ -917,6 +917,34 @@ ra_compute_available_regs(struct ra_graph *g, unsigned int n, BITSET_WORD *regs)
    return false;
 }
 
+/* Returns the lowest-numbered reg in the set of available regs starting at
+ * start and wrapping around the end of the register file, or NO_REG if there
+ * is none.
+ */
+static unsigned int
+ra_find_available_reg(const BITSET_WORD *regs, unsigned int count,
+                      unsigned int start)
+{
+   const unsigned int words = BITSET_WORDS(count);
+
+   start %= count;
+   unsigned int i = start / BITSET_WORDBITS;
+   BITSET_WORD word = regs[i] & ~BITFIELD_MASK(start % BITSET_WORDBITS);
+
+   /* The first word is visited twice: once for the regs after start and once
+    * for the regs before it after wrapping around.
+    */
+   for (unsigned int visited = 0; visited <= words; visited++) {
+      if (word)
+         return i * BITSET_WORDBITS + ffs(word) - 1;
+
+      i = (i + 1) % words;
+      word = regs[i];
+   }
+
+   return NO_REG;
+}
+
 /**
  * Pops nodes from the stack back into the graph, coloring them with
  * registers as they go.
@@ -928,58 +956,51 @@ static bool
 ra_select(struct ra_graph *g)
 {
    int start_search_reg = 0;
-   BITSET_WORD *select_regs = NULL;
-
-   if (g->select_reg_callback)
-      select_regs = malloc(BITSET_WORDS(g->regs->count) * sizeof(BITSET_WORD));
+   BITSET_WORD *select_regs =
+      malloc(BITSET_WORDS(g->regs->count) * sizeof(BITSET_WORD));
 
    while (g->tmp.stack_count != 0) {
-      unsigned int ri;
-      unsigned int r = -1;
+      unsigned int r;
       int n = g->tmp.stack[g->tmp.stack_count - 1];
-      struct ra_class *c = g->regs->classes[g->nodes[n].class];
 
       /* set this to false even if we return here so that
        * ra_get_best_spill_node() considers this node later.
        */
       BITSET_CLEAR(g->tmp.in_stack, n);
 
-      if (g->select_reg_callback) {
+      /* With round-robin allocation the reg after the previously picked one
+       * is usually free, so try it alone before gathering the whole set.
+       */
+      r = NO_REG;
+      if (g->regs->round_robin && !g->select_reg_callback) {
+         struct ra_class *c = g->regs->classes[g->nodes[n].class];
+         r = ra_find_available_reg(c->regs, g->regs->count, start_search_reg);
+         if (r != NO_REG && ra_find_conflicting_neighbor(g, n, r))
+            r = NO_REG;
+      }
+
+      if (r == NO_REG) {
+         /* Gather the regs of our class which are not used by a member of
+          * the graph adjacent to us in a single walk of the adjacency list,
+          * rather than walking it again for each reg we try.
+          */
          if (!ra_compute_available_regs(g, n, select_regs)) {
             free(select_regs);
             return false;
          }
 
-         r = g->select_reg_callback(n, select_regs, g->select_reg_callback_data);
-         assert(r < g->regs->count);
-      } else {
-         /* Find the lowest-numbered reg which is not used by a member
-          * of the graph adjacent to us.
-          */
-         for (ri = 0; ri < g->regs->count; ri++) {
-            r = (start_search_reg + ri) % g->regs->count;
-            if (!reg_belongs_to_class(r, c))
-               continue;
-
-            struct ra_node *conflicting = ra_find_conflicting_neighbor(g, n, r);
-            if (!conflicting) {
-               /* Found a reg! */
-               break;
-            }
-            if (g->regs->classes[conflicting->class]->contig_len) {
-               /* Skip to point at the last base reg of the conflicting reg
-                * allocation -- the loop will increment us to check the next reg
-                * after the conflicting allocaiton.
-                */
-               unsigned conflicting_end = (conflicting->reg +
-                                           g->regs->classes[conflicting->class]->contig_len - 1);
-               assert(conflicting_end >= r);
-               ri += conflicting_end - r;
-            }
+         if (g->select_reg_callback) {
+            r = g->select_reg_callback(n, select_regs,
+                                       g->select_reg_callback_data);
+            assert(r < g->regs->count);
+         } else {
+            /* Find the lowest-numbered available reg after the starting
+             * point.
+             */
+            r = ra_find_available_reg(select_regs, g->regs->count,
+                                      start_search_reg);
+            assert(r != NO_REG);
          }
-
-         if (ri >= g->regs->count)
-            return false;
       }
 
       g->nodes[n].reg = r;
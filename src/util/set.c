@@ -40,58 +40,11 @@
 #include "macros.h"
 #include "ralloc.h"
 #include "set.h"
-#include "fast_urem_by_const.h"
-
-/*
- * From Knuth -- a good choice for hash/rehash values is p, p-2 where
- * p and p-2 are both prime.  These tables are sized to have an extra 10%
- * free to avoid exponential performance degradation as the hash table fills
- */
+#include "hash_table_group.h"
 
 static const uint32_t deleted_key_value;
 static const void *deleted_key = &deleted_key_value;
 
-static const struct {
-   uint32_t max_entries, size, rehash;
-   uint64_t size_magic, rehash_magic;
-} hash_sizes[] = {
-#define ENTRY(max_entries, size, rehash) \
-   { max_entries, size, rehash, \
-      REMAINDER_MAGIC(size), REMAINDER_MAGIC(rehash) }
-
-   ENTRY(2,            5,            3            ),
-   ENTRY(4,            7,            5            ),
-   ENTRY(8,            13,           11           ),
-   ENTRY(16,           19,           17           ),
-   ENTRY(32,           43,           41           ),
-   ENTRY(64,           73,           71           ),
-   ENTRY(128,          151,          149          ),
-   ENTRY(256,          283,          281          ),
-   ENTRY(512,          571,          569          ),
-   ENTRY(1024,         1153,         1151         ),
-   ENTRY(2048,         2269,         2267         ),
-   ENTRY(4096,         4519,         4517         ),
-   ENTRY(8192,         9013,         9011         ),
-   ENTRY(16384,        18043,        18041        ),
-   ENTRY(32768,        36109,        36107        ),
-   ENTRY(65536,        72091,        72089        ),
-   ENTRY(131072,       144409,       144407       ),
-   ENTRY(262144,       288361,       288359       ),
-   ENTRY(524288,       576883,       576881       ),
-   ENTRY(1048576,      1153459,      1153457      ),
-   ENTRY(2097152,      2307163,      2307161      ),
-   ENTRY(4194304,      4613893,      4613891      ),
-   ENTRY(8388608,      9227641,      9227639      ),
-   ENTRY(16777216,     18455029,     18455027     ),
-   ENTRY(33554432,     36911011,     36911009     ),
-   ENTRY(67108864,     73819861,     73819859     ),
-   ENTRY(134217728,    147639589,    147639587    ),
-   ENTRY(268435456,    295279081,    295279079    ),
-   ENTRY(536870912,    590559793,    590559791    ),
-   ENTRY(1073741824,   1181116273,   1181116271   ),
-   ENTRY(2147483648ul, 2362232233ul, 2362232231ul )
-};
-
 ASSERTED static inline bool
 key_pointer_is_reserved(const void *key)
 {
@@ -99,21 +52,37 @@ key_pointer_is_reserved(const void *key)
 }
 
 static int
-entry_is_free(struct set_entry *entry)
+entry_is_present(struct set_entry *entry)
 {
-   return entry->key == NULL;
+   return entry->key != NULL && entry->key != deleted_key;
 }
 
-static int
-entry_is_deleted(struct set_entry *entry)
+/**
+ * Allocates the entries of a set of size 1 << size_index, followed by
+ * their control bytes, so that freeing ht->table frees both.
+ */
+static struct set_entry *
+set_alloc(void *mem_ctx, unsigned size_index, uint8_t **ctrl)
 {
-   return entry->key == deleted_key;
+   uint32_t size = 1u << size_index;
+   struct set_entry *table =
+      ralloc_size(mem_ctx, size * sizeof(struct set_entry) +
+                           hash_ctrl_size(size));
+   if (table == NULL)
+      return NULL;
+
+   memset(table, 0, size * sizeof(struct set_entry));
+   *ctrl = (uint8_t *)(table + size);
+   hash_ctrl_init(*ctrl, size);
+   return table;
 }
 
-static int
-entry_is_present(struct set_entry *entry)
+static void
+set_set_size(struct set *ht, unsigned size_index)
 {
-   return entry->key != NULL && entry->key != deleted_key;
+   ht->size_index = size_index;
+   ht->size = 1u << size_index;
+   ht->max_entries = hash_max_entries(size_index);
 }
 
 bool
@@ -122,15 +91,10 @@ _mesa_set_init(struct set *ht, void *mem_ctx,
                  bool (*key_equals_function)(const void *a,
                                              const void *b))
 {
-   ht->size_index = 0;
-   ht->size = hash_sizes[ht->size_index].size;
-   ht->rehash = hash_sizes[ht->size_index].rehash;
-   ht->size_magic = hash_sizes[ht->size_index].size_magic;
-   ht->rehash_magic = hash_sizes[ht->size_index].rehash_magic;
-   ht->max_entries = hash_sizes[ht->size_index].max_entries;
+   set_set_size(ht, HASH_MIN_SIZE_INDEX);
    ht->key_hash_function = key_hash_function;
    ht->key_equals_function = key_equals_function;
-   ht->table = rzalloc_array(mem_ctx, struct set_entry, ht->size);
+   ht->table = set_alloc(mem_ctx, ht->size_index, &ht->ctrl);
    ht->entries = 0;
    ht->deleted_entries = 0;
 
@@ -188,13 +152,17 @@ _mesa_set_clone(struct set *set, void *dst_mem_ctx)
 
    memcpy(clone, set, sizeof(struct set));
 
-   clone->table = ralloc_array(clone, struct set_entry, clone->size);
+   size_t table_size = clone->size * sizeof(struct set_entry) +
+                       hash_ctrl_size(clone->size);
+
+   clone->table = ralloc_size(clone, table_size);
    if (clone->table == NULL) {
       ralloc_free(clone);
       return NULL;
    }
 
-   memcpy(clone->table, set->table, clone->size * sizeof(struct set_entry));
+   memcpy(clone->table, set->table, table_size);
+   clone->ctrl = (uint8_t *)(clone->table + clone->size);
 
    return clone;
 }
@@ -224,7 +192,8 @@ _mesa_set_destroy(struct set *ht, void (*delete_function)(struct set_entry *entr
 static void
 set_clear_fast(struct set *ht)
 {
-   memset(ht->table, 0, sizeof(struct set_entry) * hash_sizes[ht->size_index].size);
+   memset(ht->table, 0, sizeof(struct set_entry) * ht->size);
+   hash_ctrl_init(ht->ctrl, ht->size);
    ht->entries = ht->deleted_entries = 0;
 }
 
@@ -249,6 +218,7 @@ _mesa_set_clear(struct set *set, void (*delete_function)(struct set_entry *entry
 
          entry->key = NULL;
       }
+      hash_ctrl_init(set->ctrl, set->size);
       set->entries = 0;
       set->deleted_entries = 0;
    } else
@@ -265,26 +235,28 @@ set_search(const struct set *ht, uint32_t hash, const void *key)
 {
    assert(!key_pointer_is_reserved(key));
 
-   uint32_t size = ht->size;
-   uint32_t start_address = util_fast_urem32(hash, size, ht->size_magic);
-   uint32_t double_hash = util_fast_urem32(hash, ht->rehash,
-                                           ht->rehash_magic) + 1;
-   uint32_t hash_address = start_address;
-   do {
-      struct set_entry *entry = ht->table + hash_address;
+   struct hash_probe probe = hash_probe_start(hash, ht->size_index);
+   uint32_t num_groups = hash_num_groups(ht->size_index);
 
-      if (entry_is_free(entry)) {
-         return NULL;
-      } else if (entry_is_present(entry) && entry->hash == hash) {
-         if (ht->key_equals_function(key, entry->key)) {
+   for (uint32_t i = 0; i < num_groups; i++) {
+      const uint8_t *ctrl = ht->ctrl + probe.pos;
+      uint64_t match = hash_group_match(ctrl, probe.h2);
+
+      while (match) {
+         struct set_entry *entry =
+            ht->table + probe.pos + hash_group_next(&match);
+
+         if (entry->hash == hash &&
+             ht->key_equals_function(key, entry->key))
             return entry;
-         }
       }
 
-      hash_address += double_hash;
-      if (hash_address >= size)
-         hash_address -= size;
-   } while (hash_address != start_address);
+      /* The key would have been added in the empty entry. */
+      if (hash_group_match_empty(ctrl))
+         return NULL;
+
+      hash_probe_next(&probe);
+   }
 
    return NULL;
 }
@@ -308,22 +280,22 @@ _mesa_set_search_pre_hashed(const struct set *set, uint32_t hash,
 static void
 set_add_rehash(struct set *ht, uint32_t hash, const void *key)
 {
-   uint32_t size = ht->size;
-   uint32_t start_address = util_fast_urem32(hash, size, ht->size_magic);
-   uint32_t double_hash = util_fast_urem32(hash, ht->rehash,
-                                           ht->rehash_magic) + 1;
-   uint32_t hash_address = start_address;
+   struct hash_probe probe = hash_probe_start(hash, ht->size_index);
+
    do {
-      struct set_entry *entry = ht->table + hash_address;
-      if (likely(entry->key == NULL)) {
+      uint64_t empty = hash_group_match_empty(ht->ctrl + probe.pos);
+
+      if (likely(empty)) {
+         uint32_t index = probe.pos + hash_group_next(&empty);
+         struct set_entry *entry = ht->table + index;
+
+         ht->ctrl[index] = probe.h2;
          entry->hash = hash;
          entry->key = key;
          return;
       }
 
-      hash_address = hash_address + double_hash;
-      if (hash_address >= size)
-         hash_address -= size;
+      hash_probe_next(&probe);
    } while (true);
 }
 
@@ -339,23 +311,19 @@ set_rehash(struct set *ht, unsigned new_size_index)
       return;
    }
 
-   if (new_size_index >= ARRAY_SIZE(hash_sizes))
+   if (new_size_index > 31)
       return;
 
-   table = rzalloc_array(ralloc_parent(ht->table), struct set_entry,
-                         hash_sizes[new_size_index].size);
+   uint8_t *ctrl;
+   table = set_alloc(ralloc_parent(ht->table), new_size_index, &ctrl);
    if (table == NULL)
       return;
 
    old_ht = *ht;
 
    ht->table = table;
-   ht->size_index = new_size_index;
-   ht->size = hash_sizes[ht->size_index].size;
-   ht->rehash = hash_sizes[ht->size_index].rehash;
-   ht->size_magic = hash_sizes[ht->size_index].size_magic;
-   ht->rehash_magic = hash_sizes[ht->size_index].rehash_magic;
-   ht->max_entries = hash_sizes[ht->size_index].max_entries;
+   ht->ctrl = ctrl;
+   set_set_size(ht, new_size_index);
    ht->entries = 0;
    ht->deleted_entries = 0;
 
@@ -375,8 +343,8 @@ _mesa_set_resize(struct set *set, uint32_t entries)
    if (set->entries > entries)
       entries = set->entries;
 
-   unsigned size_index = 0;
-   while (hash_sizes[size_index].max_entries < entries)
+   unsigned size_index = HASH_MIN_SIZE_INDEX;
+   while (hash_max_entries(size_index) < entries)
       size_index++;
 
    set_rehash(set, size_index);
@@ -402,39 +370,47 @@ set_search_or_add(struct set *ht, uint32_t hash, const void *key, bool *found)
       set_rehash(ht, ht->size_index);
    }
 
-   uint32_t size = ht->size;
-   uint32_t start_address = util_fast_urem32(hash, size, ht->size_magic);
-   uint32_t double_hash = util_fast_urem32(hash, ht->rehash,
-                                           ht->rehash_magic) + 1;
-   uint32_t hash_address = start_address;
-   do {
-      struct set_entry *entry = ht->table + hash_address;
-
-      if (!entry_is_present(entry)) {
-         /* Stash the first available entry we find */
-         if (available_entry == NULL)
-            available_entry = entry;
-         if (entry_is_free(entry))
-            break;
+   struct hash_probe probe = hash_probe_start(hash, ht->size_index);
+   uint32_t num_groups = hash_num_groups(ht->size_index);
+   uint32_t available_index = 0;
+
+   for (uint32_t i = 0; i < num_groups; i++) {
+      const uint8_t *ctrl = ht->ctrl + probe.pos;
+      uint64_t match = hash_group_match(ctrl, probe.h2);
+
+      while (match) {
+         struct set_entry *entry =
+            ht->table + probe.pos + hash_group_next(&match);
+
+         if (entry->hash == hash &&
+             ht->key_equals_function(key, entry->key)) {
+            if (found)
+               *found = true;
+            return entry;
+         }
       }
 
-      if (!entry_is_deleted(entry) &&
-          entry->hash == hash &&
-          ht->key_equals_function(key, entry->key)) {
-         if (found)
-            *found = true;
-         return entry;
+      /* Stash the first available entry we find */
+      if (available_entry == NULL) {
+         uint64_t available = hash_group_match_available(ctrl);
+
+         if (available) {
+            available_index = probe.pos + hash_group_next(&available);
+            available_entry = ht->table + available_index;
+         }
       }
 
-      hash_address = hash_address + double_hash;
-      if (hash_address >= size)
-         hash_address -= size;
-   } while (hash_address != start_address);
+      if (hash_group_match_empty(ctrl))
+         break;
+
+      hash_probe_next(&probe);
+   }
 
    if (available_entry) {
       /* There is no matching entry, create it. */
-      if (entry_is_deleted(available_entry))
+      if (ht->ctrl[available_index] == HASH_CTRL_DELETED)
          ht->deleted_entries--;
+      ht->ctrl[available_index] = probe.h2;
       available_entry->hash = hash;
       available_entry->key = key;
       ht->entries++;
@@ -546,9 +522,21 @@ _mesa_set_remove(struct set *ht, struct set_entry *entry)
    if (!entry)
       return;
 
-   entry->key = deleted_key;
+   uint32_t index = entry - ht->table;
+
+   /* Probing stops at the first group with an empty entry, so if the group
+    * has one, no other key depends on this entry being used and it can
+    * become empty instead of deleted.
+    */
+   if (hash_group_match_empty(ht->ctrl + (index & ~(HASH_GROUP_WIDTH - 1)))) {
+      ht->ctrl[index] = HASH_CTRL_EMPTY;
+      entry->key = NULL;
+   } else {
+      ht->ctrl[index] = HASH_CTRL_DELETED;
+      entry->key = deleted_key;
+      ht->deleted_entries++;
+   }
    ht->entries--;
-   ht->deleted_entries++;
 }
 
 /**
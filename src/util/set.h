@@ -31,6 +31,8 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include "hash_table.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -43,12 +45,10 @@ struct set_entry {
 struct set {
    void *mem_ctx;
    struct set_entry *table;
+   uint8_t *ctrl; /* one control byte per entry, see hash_table_group.h */
    uint32_t (*key_hash_function)(const void *key);
    bool (*key_equals_function)(const void *a, const void *b);
    uint32_t size;
-   uint32_t rehash;
-   uint64_t size_magic;
-   uint64_t rehash_magic;
    uint32_t max_entries;
    uint32_t size_index;
    uint32_t entries;
@@ -137,7 +137,9 @@ _mesa_set_intersects(struct set *a, struct set *b);
 #define set_foreach_remove(set, entry)                              \
    for (struct set_entry *entry = _mesa_set_next_entry_unsafe(set, NULL);  \
         (set)->entries;                                              \
-        entry->hash = 0, entry->key = (void*)NULL, (set)->entries--, entry = _mesa_set_next_entry_unsafe(set, entry))
+        entry->hash = 0, entry->key = (void*)NULL,                  \
+        (set)->ctrl[entry - (set)->table] = HASH_CTRL_EMPTY,         \
+        (set)->entries--, entry = _mesa_set_next_entry_unsafe(set, entry))
 
 #ifdef __cplusplus
 } /* extern C */
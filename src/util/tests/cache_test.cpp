@@ -37,11 +37,13 @@
 #include <time.h>
 #include <unistd.h>
 #include <utime.h>
+#include <sys/wait.h>
 
 #include "util/detect_os.h"
 #include "util/mesa-sha1.h"
 #include "util/disk_cache.h"
 #include "util/disk_cache_os.h"
+#include "util/os_time.h"
 #include "util/ralloc.h"
 
 #ifdef FOZ_DB_UTIL_DYNAMIC_LIST
@@ -731,6 +733,11 @@ protected:
 
    Cache() {
       mem_ctx = ralloc_context(NULL);
+
+      /* Most tests check what ends up on disk, the in-memory cache in front
+       * of it is tested on its own.
+       */
+      setenv("MESA_SHADER_CACHE_MEMORY_MAX_SIZE", "0", 1);
    }
    ~Cache() {
       ralloc_free(mem_ctx);
@@ -1338,6 +1345,519 @@ TEST_F(Cache, DatabaseMultipartEviction)
 #endif
 }
 
+static unsigned
+multi_process_read_worker(const char *driver_id, cache_key *keys,
+                          unsigned num_keys, unsigned num_iterations,
+                          size_t blob_size)
+{
+   struct disk_cache *cache = disk_cache_create("test", driver_id, 0);
+   unsigned misses = 0;
+   char *result;
+   size_t size;
+
+   for (unsigned n = 0; n < num_iterations; n++) {
+      for (unsigned i = 0; i < num_keys; i++) {
+         result = (char *) disk_cache_get(cache, keys[i], &size);
+         if (!result || size != blob_size ||
+             result[0] != (char)i || result[blob_size - 1] != (char)i)
+            misses++;
+         free(result);
+      }
+   }
+
+   disk_cache_destroy(cache);
+
+   return misses;
+}
+
+/* Hammer a single database with reader processes while another process
+ * keeps writing to it. Every lookup must hit, and the resulting hit
+ * throughput is reported.
+ */
+static void
+test_multi_process_read(const char *driver_id)
+{
+   const unsigned num_procs = 8, num_iterations = 200;
+   const size_t blob_size = 4096;
+   cache_key keys[64], new_key;
+   struct disk_cache *cache;
+   pid_t pids[num_procs];
+   uint8_t *blob;
+   unsigned i;
+   int status;
+
+   setenv("MESA_SHADER_CACHE_MAX_SIZE", "64M", 1);
+
+   blob = (uint8_t *) malloc(blob_size);
+
+   cache = disk_cache_create("test", driver_id, 0);
+
+   for (i = 0; i < ARRAY_SIZE(keys); i++) {
+      memset(blob, i, blob_size);
+      disk_cache_compute_key(cache, blob, blob_size, keys[i]);
+      disk_cache_put(cache, keys[i], blob, blob_size, NULL);
+   }
+
+   disk_cache_wait_for_idle(cache);
+   disk_cache_destroy(cache);
+
+   int64_t start = os_time_get_nano();
+
+   for (i = 0; i < num_procs; i++) {
+      pids[i] = fork();
+      ASSERT_GE(pids[i], 0) << "fork";
+
+      if (!pids[i]) {
+         unsigned misses = multi_process_read_worker(driver_id, keys,
+                                                     ARRAY_SIZE(keys),
+                                                     num_iterations,
+                                                     blob_size);
+         _exit(MIN2(misses, 255));
+      }
+   }
+
+   /* Keep appending to the database while the readers run */
+   cache = disk_cache_create("test", driver_id, 0);
+
+   for (i = 0; i < 256; i++) {
+      memset(blob, i, blob_size);
+      blob[0] = ~blob[0];
+      disk_cache_compute_key(cache, blob, blob_size, new_key);
+      disk_cache_put(cache, new_key, blob, blob_size, NULL);
+      disk_cache_wait_for_idle(cache);
+   }
+
+   disk_cache_destroy(cache);
+
+   for (i = 0; i < num_procs; i++) {
+      EXPECT_EQ(waitpid(pids[i], &status, 0), pids[i]) << "waitpid";
+      EXPECT_TRUE(WIFEXITED(status)) << "reader process exited";
+      EXPECT_EQ(WEXITSTATUS(status), 0) << "reader process cache misses";
+   }
+
+   double secs = (os_time_get_nano() - start) / 1e9;
+   printf("%u processes: %.0f cache hits/s\n", num_procs,
+          num_procs * num_iterations * ARRAY_SIZE(keys) / secs);
+
+   free(blob);
+
+   unsetenv("MESA_SHADER_CACHE_MAX_SIZE");
+}
+
+TEST_F(Cache, DatabaseMultiProcessRead)
+{
+   const char *driver_id = "make_check_uncompressed";
+
+#ifndef ENABLE_SHADER_CACHE
+   GTEST_SKIP() << "ENABLE_SHADER_CACHE not defined.";
+#else
+   setenv("MESA_DISK_CACHE_DATABASE_NUM_PARTS", "1", 1);
+
+   test_disk_cache_create(mem_ctx, CACHE_DIR_NAME_DB, driver_id);
+
+   test_multi_process_read(driver_id);
+
+   unsetenv("MESA_DISK_CACHE_DATABASE_NUM_PARTS");
+
+   int err = rmrf_local(CACHE_TEST_TMP);
+   EXPECT_EQ(err, 0) << "Removing " CACHE_TEST_TMP " again";
+#endif
+}
+
+static int
+compare_latency(const void *a, const void *b)
+{
+   int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+
+   return x < y ? -1 : x > y;
+}
+
+static double
+p99_latency_us(int64_t *latencies, unsigned count)
+{
+   qsort(latencies, count, sizeof(*latencies), compare_latency);
+
+   return latencies[count * 99 / 100] / 1000.0;
+}
+
+static void
+fill_compaction_blob(uint8_t *blob, size_t blob_size, unsigned i)
+{
+   memset(blob, i, blob_size);
+   blob[0] = ~blob[0];
+   blob[1] = i >> 8;
+}
+
+/* Keep a writer process putting entries into a nearly full database,
+ * which makes it compact DB parts continuously, and measure the p99
+ * latency of puts and of gets issued by another process meanwhile.
+ * The put latency is the time until the entry can be read back.
+ */
+static void
+test_compaction_latency(const char *driver_id)
+{
+   const unsigned num_puts = 2048;
+   unsigned num_gets = 0, max_gets = 4096;
+   const size_t blob_size = 2048;
+   int64_t *latencies;
+   struct disk_cache *cache;
+   cache_key keys[64], key;
+   uint8_t *blob;
+   char *result;
+   size_t size;
+   unsigned i;
+   int status;
+
+   setenv("MESA_SHADER_CACHE_MAX_SIZE", "1M", 1);
+
+   blob = (uint8_t *) malloc(blob_size);
+
+   cache = disk_cache_create("test", driver_id, 0);
+
+   for (i = 0; i < ARRAY_SIZE(keys); i++) {
+      memset(blob, i, blob_size);
+      disk_cache_compute_key(cache, blob, blob_size, keys[i]);
+      disk_cache_put(cache, keys[i], blob, blob_size, NULL);
+   }
+
+   disk_cache_wait_for_idle(cache);
+   disk_cache_destroy(cache);
+
+   pid_t pid = fork();
+   ASSERT_GE(pid, 0) << "fork";
+
+   if (!pid) {
+      cache = disk_cache_create("test", driver_id, 0);
+      latencies = (int64_t *) malloc(num_puts * sizeof(*latencies));
+
+      for (i = 0; i < num_puts; i++) {
+         fill_compaction_blob(blob, blob_size, i);
+         disk_cache_compute_key(cache, blob, blob_size, key);
+
+         /* Measure how long it takes until the entry can be read back,
+          * a compaction that runs in the background isn't waited for.
+          */
+         int64_t start = os_time_get_nano();
+         int64_t deadline = start + 10 * 1000000000ll;
+         disk_cache_put(cache, key, blob, blob_size, NULL);
+         while (!(result = (char *) disk_cache_get(cache, key, &size))) {
+            if (os_time_get_nano() > deadline) {
+               fprintf(stderr, "entry %u not readable 10s after put\n", i);
+               _exit(1);
+            }
+            usleep(10);
+         }
+         latencies[i] = os_time_get_nano() - start;
+         free(result);
+      }
+
+      disk_cache_wait_for_idle(cache);
+
+      printf("put p99 latency during compaction: %.1f us\n",
+             p99_latency_us(latencies, num_puts));
+      fflush(stdout);
+
+      free(latencies);
+      disk_cache_destroy(cache);
+      _exit(0);
+   }
+
+   cache = disk_cache_create("test", driver_id, 0);
+   latencies = (int64_t *) malloc(max_gets * sizeof(*latencies));
+
+   /* Keep reading until the writer is done */
+   while (!waitpid(pid, &status, WNOHANG)) {
+      if (num_gets == max_gets) {
+         max_gets *= 2;
+         latencies = (int64_t *) realloc(latencies, max_gets * sizeof(*latencies));
+      }
+
+      int64_t start = os_time_get_nano();
+      result = (char *) disk_cache_get(cache, keys[num_gets % ARRAY_SIZE(keys)], &size);
+      latencies[num_gets++] = os_time_get_nano() - start;
+
+      if (result)
+         EXPECT_EQ(size, blob_size) << "disk_cache_get with existent item (size)";
+      free(result);
+   }
+
+   if (num_gets) {
+      printf("get p99 latency during compaction: %.1f us\n",
+             p99_latency_us(latencies, num_gets));
+   }
+
+   EXPECT_TRUE(WIFEXITED(status) && !WEXITSTATUS(status)) << "writer process";
+
+   /* The most recently written entry must survive the compactions */
+   fill_compaction_blob(blob, blob_size, num_puts - 1);
+   disk_cache_compute_key(cache, blob, blob_size, key);
+
+   result = (char *) disk_cache_get(cache, key, &size);
+   EXPECT_NE(result, nullptr) << "disk_cache_get with existent item (pointer)";
+   EXPECT_EQ(size, blob_size) << "disk_cache_get with existent item (size)";
+   free(result);
+
+   free(latencies);
+   disk_cache_destroy(cache);
+   free(blob);
+
+   unsetenv("MESA_SHADER_CACHE_MAX_SIZE");
+}
+
+TEST_F(Cache, DatabaseCompactionLatency)
+{
+   const char *driver_id = "make_check_uncompressed";
+
+#ifndef ENABLE_SHADER_CACHE
+   GTEST_SKIP() << "ENABLE_SHADER_CACHE not defined.";
+#else
+   setenv("MESA_DISK_CACHE_DATABASE_NUM_PARTS", "8", 1);
+
+   test_disk_cache_create(mem_ctx, CACHE_DIR_NAME_DB, driver_id);
+
+   test_compaction_latency(driver_id);
+
+   unsetenv("MESA_DISK_CACHE_DATABASE_NUM_PARTS");
+
+   int err = rmrf_local(CACHE_TEST_TMP);
+   EXPECT_EQ(err, 0) << "Removing " CACHE_TEST_TMP " again";
+#endif
+}
+
+/* Entries sharing most of their content, like binaries produced by one
+ * driver do.
+ */
+static size_t
+fill_dict_test_blob(char *blob, size_t blob_size, unsigned seed)
+{
+   size_t size = snprintf(blob, blob_size, "// entry %u\n", seed);
+   uint32_t state = 1;
+
+   /* Content that only compresses well against the other entries. */
+   for (unsigned i = 0; i < 64; i++) {
+      state = state * 1103515245 + 12345;
+      size += snprintf(blob + size, blob_size - size,
+                       "uniform vec4 u%08x;\n", state);
+   }
+
+   for (unsigned i = 0; size + 64 < blob_size; i++) {
+      size += snprintf(blob + size, blob_size - size,
+                       "vec4 r%u = texture(s%u, uv%u) * c[%u];\n",
+                       i, (seed + i) % 16, i % 4, (seed * i) % 64);
+   }
+
+   return size;
+}
+
+static void
+test_compression_dict(const char *driver_id)
+{
+   const unsigned num_entries = 256;
+   const size_t blob_size = 8192;
+   cache_key *keys = (cache_key *) malloc(num_entries * sizeof(cache_key));
+   char *blob = (char *) malloc(blob_size);
+   unsigned i;
+
+   struct disk_cache *cache = disk_cache_create("test", driver_id, 0);
+
+   /* The first half of the entries is written without dictionary and used
+    * to train one, the second half is compressed against it.
+    */
+   for (i = 0; i < num_entries; i++) {
+      size_t size = fill_dict_test_blob(blob, blob_size, i);
+      disk_cache_compute_key(cache, blob, size, keys[i]);
+      disk_cache_put(cache, keys[i], blob, size, NULL);
+      disk_cache_wait_for_idle(cache);
+   }
+
+#ifdef HAVE_ZSTD
+   EXPECT_NE(cache->dict.dict, nullptr) << "dictionary trained";
+#endif
+
+   /* Read the entries back from this cache and from one that loads the
+    * dictionary written by the first one.
+    */
+   for (unsigned c = 0; c < 2; c++) {
+      for (i = 0; i < num_entries; i++) {
+         size_t size = fill_dict_test_blob(blob, blob_size, i);
+         size_t result_size;
+         char *result = (char *) disk_cache_get(cache, keys[i], &result_size);
+         EXPECT_NE(result, nullptr) << "disk_cache_get with existent item";
+         if (result) {
+            EXPECT_EQ(result_size, size);
+            EXPECT_EQ(memcmp(result, blob, size), 0);
+         }
+         free(result);
+      }
+
+      if (c == 1)
+         break;
+
+      disk_cache_destroy(cache);
+      cache = disk_cache_create("test", driver_id, 0);
+#ifdef HAVE_ZSTD
+      EXPECT_NE(cache->dict.dict, nullptr) << "dictionary loaded";
+#endif
+   }
+
+#ifdef HAVE_ZSTD
+   /* Entries compressed against a dictionary that went missing are misses,
+    * the others are still found.
+    */
+   char *dict_filename = strdup(cache->dict.filename);
+   disk_cache_destroy(cache);
+   EXPECT_EQ(unlink(dict_filename), 0) << "removing the dictionary";
+   free(dict_filename);
+
+   cache = disk_cache_create("test", driver_id, 0);
+   EXPECT_EQ(cache->dict.dict, nullptr) << "no dictionary loaded";
+
+   char *result = (char *) disk_cache_get(cache, keys[0], NULL);
+   EXPECT_NE(result, nullptr) << "disk_cache_get without dictionary";
+   free(result);
+
+   result = (char *) disk_cache_get(cache, keys[num_entries - 1], NULL);
+   EXPECT_EQ(result, nullptr) << "disk_cache_get with missing dictionary";
+   free(result);
+#endif
+
+   disk_cache_destroy(cache);
+
+   free(blob);
+   free(keys);
+}
+
+TEST_F(Cache, CompressionDictionary)
+{
+   const char *driver_id = "make_check";
+
+#ifndef ENABLE_SHADER_CACHE
+   GTEST_SKIP() << "ENABLE_SHADER_CACHE not defined.";
+#else
+   test_disk_cache_create(mem_ctx, CACHE_DIR_NAME_DB, driver_id);
+
+   test_compression_dict(driver_id);
+
+   /* Fossilize databases get copied around without the dictionary. */
+   setenv("MESA_DISK_CACHE_SINGLE_FILE", "true", 1);
+   struct disk_cache *cache = disk_cache_create("test", driver_id, 0);
+   EXPECT_EQ(cache->dict.filename, nullptr) << "no dictionary for foz";
+   disk_cache_destroy(cache);
+   setenv("MESA_DISK_CACHE_SINGLE_FILE", "false", 1);
+
+   int err = rmrf_local(CACHE_TEST_TMP);
+   EXPECT_EQ(err, 0) << "Removing " CACHE_TEST_TMP " again";
+#endif
+}
+
+static void
+check_memory_cache_get(struct disk_cache *cache, const cache_key key,
+                       const char *blob, size_t blob_size, bool from_memory)
+{
+   unsigned memory_hits = cache->stats.memory_hits;
+   size_t size;
+
+   char *result = (char *) disk_cache_get(cache, key, &size);
+   EXPECT_NE(result, nullptr) << "disk_cache_get with existent item";
+   if (result) {
+      EXPECT_EQ(size, blob_size);
+      EXPECT_EQ(memcmp(result, blob, size), 0);
+   }
+   free(result);
+
+   EXPECT_EQ(cache->stats.memory_hits - memory_hits, from_memory ? 1 : 0)
+      << "disk_cache_get from memory";
+}
+
+static void
+test_memory_cache(const char *driver_id)
+{
+   const unsigned num_entries = 32;
+   const size_t blob_size = 4096;
+   char blobs[num_entries][blob_size];
+   cache_key keys[num_entries];
+   char large_blob[20 * 1024];
+   cache_key large_key;
+   unsigned i;
+
+   setenv("MESA_SHADER_CACHE_MEMORY_MAX_SIZE", "64K", 1);
+   setenv("MESA_SHADER_CACHE_SHOW_STATS", "true", 1);
+
+   struct disk_cache *cache = disk_cache_create("test", driver_id, 0);
+
+   for (i = 0; i < num_entries; i++) {
+      memset(blobs[i], i, blob_size);
+      disk_cache_compute_key(cache, blobs[i], blob_size, keys[i]);
+   }
+
+   /* Items that were just put are read back from memory. */
+   for (i = 0; i < 8; i++)
+      disk_cache_put(cache, keys[i], blobs[i], blob_size, NULL);
+   disk_cache_wait_for_idle(cache);
+
+   for (i = 0; i < 8; i++)
+      check_memory_cache_get(cache, keys[i], blobs[i], blob_size, true);
+
+   /* Only 16 items fit, the least recently used ones are read from disk. */
+   for (i = 8; i < num_entries; i++)
+      disk_cache_put(cache, keys[i], blobs[i], blob_size, NULL);
+   disk_cache_wait_for_idle(cache);
+
+   EXPECT_LE(cache->mem.size, 64 * 1024) << "memory cache size limit";
+   check_memory_cache_get(cache, keys[0], blobs[0], blob_size, false);
+   check_memory_cache_get(cache, keys[0], blobs[0], blob_size, true);
+   check_memory_cache_get(cache, keys[num_entries - 1],
+                          blobs[num_entries - 1], blob_size, true);
+
+   /* Large items aren't kept in memory. */
+   memset(large_blob, 0xff, sizeof(large_blob));
+   disk_cache_compute_key(cache, large_blob, sizeof(large_blob), large_key);
+   disk_cache_put(cache, large_key, large_blob, sizeof(large_blob), NULL);
+   disk_cache_wait_for_idle(cache);
+   check_memory_cache_get(cache, large_key, large_blob, sizeof(large_blob),
+                          false);
+
+   /* Removed items are gone from memory as well. */
+   disk_cache_remove(cache, keys[0]);
+   char *result = (char *) disk_cache_get(cache, keys[0], NULL);
+   EXPECT_EQ(result, nullptr) << "disk_cache_get with removed item";
+   free(result);
+
+   disk_cache_destroy(cache);
+
+   /* A new cache starts out empty, prefetching loads the items into
+    * memory.
+    */
+   cache = disk_cache_create("test", driver_id, 0);
+
+   disk_cache_prefetch(cache, keys + 1, 8);
+   disk_cache_wait_for_idle(cache);
+
+   for (i = 1; i < 9; i++)
+      check_memory_cache_get(cache, keys[i], blobs[i], blob_size, true);
+   check_memory_cache_get(cache, keys[9], blobs[9], blob_size, false);
+
+   disk_cache_destroy(cache);
+
+   unsetenv("MESA_SHADER_CACHE_SHOW_STATS");
+}
+
+TEST_F(Cache, MemoryCache)
+{
+   const char *driver_id = "make_check";
+
+#ifndef ENABLE_SHADER_CACHE
+   GTEST_SKIP() << "ENABLE_SHADER_CACHE not defined.";
+#else
+   test_disk_cache_create(mem_ctx, CACHE_DIR_NAME_DB, driver_id);
+
+   test_memory_cache(driver_id);
+
+   int err = rmrf_local(CACHE_TEST_TMP);
+   EXPECT_EQ(err, 0) << "Removing " CACHE_TEST_TMP " again";
+#endif
+}
+
 static void
 test_put_and_get_disabled(const char *driver_id)
 {
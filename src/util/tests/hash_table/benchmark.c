@@ -0,0 +1,172 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Measures hash_table and set operations on key distributions seen in
+ * practice: heap pointers (NIR instructions and variables), small GL object
+ * names with u32 keys, identifier strings, and 20-byte cache keys.
+ *
+ * The number of keys can be given as the first argument.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash_table.h"
+#include "os_time.h"
+#include "ralloc.h"
+#include "set.h"
+
+struct cache_key {
+   uint8_t sha1[20];
+};
+
+DERIVE_HASH_TABLE(cache_key);
+
+static uint32_t num_keys = 100000;
+static uint32_t rand_state = 1;
+
+static uint32_t
+rand_u32(void)
+{
+   /* xorshift32, reproducible across platforms */
+   rand_state ^= rand_state << 13;
+   rand_state ^= rand_state >> 17;
+   rand_state ^= rand_state << 5;
+   return rand_state;
+}
+
+static void
+report(const char *name, const char *op, int64_t start, uint32_t count)
+{
+   int64_t ns = os_time_get_nano() - start;
+   printf("%-10s %-12s %8.2f ns/op\n", name, op, (double)ns / count);
+}
+
+/* Inserts, searches hits and misses, then removes and re-adds a quarter of
+ * the keys to leave deleted entries behind, like passes removing and
+ * re-adding instructions.
+ */
+static void
+bench_table(const char *name, struct hash_table *ht,
+            const void **keys, const void **missing_keys)
+{
+   volatile uint32_t found = 0;
+   int64_t start;
+
+   start = os_time_get_nano();
+   for (uint32_t i = 0; i < num_keys; i++)
+      _mesa_hash_table_insert(ht, keys[i], (void *)keys[i]);
+   report(name, "insert", start, num_keys);
+
+   start = os_time_get_nano();
+   for (uint32_t i = 0; i < num_keys; i++)
+      found += _mesa_hash_table_search(ht, keys[rand_u32() % num_keys]) != NULL;
+   report(name, "search hit", start, num_keys);
+
+   start = os_time_get_nano();
+   for (uint32_t i = 0; i < num_keys; i++)
+      found += _mesa_hash_table_search(ht, missing_keys[i]) != NULL;
+   report(name, "search miss", start, num_keys);
+
+   start = os_time_get_nano();
+   for (uint32_t n = 0; n < 4; n++) {
+      for (uint32_t i = n; i < num_keys; i += 4)
+         _mesa_hash_table_remove_key(ht, keys[i]);
+      for (uint32_t i = n; i < num_keys; i += 4)
+         _mesa_hash_table_insert(ht, keys[i], (void *)keys[i]);
+   }
+   report(name, "remove+add", start, num_keys * 2);
+
+   start = os_time_get_nano();
+   for (uint32_t i = 0; i < num_keys; i++)
+      found += _mesa_hash_table_search(ht, keys[rand_u32() % num_keys]) != NULL;
+   report(name, "search hit", start, num_keys);
+
+   if (found != 2 * num_keys)
+      fprintf(stderr, "%s: unexpected number of keys found\n", name);
+}
+
+static void
+bench_set(const char *name, struct set *set,
+          const void **keys, const void **missing_keys)
+{
+   volatile uint32_t found = 0;
+   int64_t start;
+
+   start = os_time_get_nano();
+   for (uint32_t i = 0; i < num_keys; i++)
+      _mesa_set_add(set, keys[i]);
+   report(name, "add", start, num_keys);
+
+   start = os_time_get_nano();
+   for (uint32_t i = 0; i < num_keys; i++)
+      found += _mesa_set_search(set, keys[rand_u32() % num_keys]) != NULL;
+   report(name, "search hit", start, num_keys);
+
+   start = os_time_get_nano();
+   for (uint32_t i = 0; i < num_keys; i++)
+      found += _mesa_set_search(set, missing_keys[i]) != NULL;
+   report(name, "search miss", start, num_keys);
+
+   if (found != num_keys)
+      fprintf(stderr, "%s: unexpected number of keys found\n", name);
+}
+
+int
+main(int argc, char **argv)
+{
+   if (argc > 1)
+      num_keys = MAX2(strtoul(argv[1], NULL, 0), 1);
+
+   void *mem_ctx = ralloc_context(NULL);
+   const void **keys = ralloc_array(mem_ctx, const void *, num_keys);
+   const void **missing_keys = ralloc_array(mem_ctx, const void *, num_keys);
+
+   /* Heap pointers of objects of varying sizes, as with NIR instructions. */
+   for (uint32_t i = 0; i < num_keys; i++) {
+      keys[i] = ralloc_size(mem_ctx, 48 + (rand_u32() % 4) * 16);
+      missing_keys[i] = ralloc_size(mem_ctx, 48);
+   }
+   bench_table("pointer", _mesa_pointer_hash_table_create(mem_ctx),
+               keys, missing_keys);
+   bench_set("pointer", _mesa_pointer_set_create(mem_ctx), keys, missing_keys);
+
+   /* GL object names: small consecutive integers. */
+   for (uint32_t i = 0; i < num_keys; i++) {
+      keys[i] = (const void *)(uintptr_t)(i + 2);
+      missing_keys[i] = (const void *)(uintptr_t)(num_keys + i + 2);
+   }
+   bench_table("u32", _mesa_hash_table_create_u32_keys(mem_ctx),
+               keys, missing_keys);
+
+   /* Identifiers, with long common prefixes. */
+   for (uint32_t i = 0; i < num_keys; i++) {
+      keys[i] = ralloc_asprintf(mem_ctx, "u_material.layer[%u].color", i);
+      missing_keys[i] = ralloc_asprintf(mem_ctx, "u_material.layer[%u].normal", i);
+   }
+   bench_table("string", _mesa_string_hash_table_create(mem_ctx),
+               keys, missing_keys);
+
+   /* Shader cache keys: uniformly distributed bytes. */
+   for (uint32_t i = 0; i < num_keys; i++) {
+      struct cache_key *key = ralloc(mem_ctx, struct cache_key);
+      struct cache_key *missing_key = ralloc(mem_ctx, struct cache_key);
+
+      for (unsigned j = 0; j < sizeof(key->sha1); j++) {
+         key->sha1[j] = rand_u32();
+         missing_key->sha1[j] = rand_u32();
+      }
+      keys[i] = key;
+      missing_keys[i] = missing_key;
+   }
+   bench_table("cache key", cache_key_table_create(mem_ctx),
+               keys, missing_keys);
+
+   ralloc_free(mem_ctx);
+   return 0;
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Measures ra_allocate() on large interference graphs built from random
+ * live intervals, like the ones the backends produce for big shaders with
+ * large register files. Register sets with contiguous classes (as with
+ * ra_alloc_contig_reg_class) and with explicit conflicts between classes
+ * are both covered, with and without round-robin allocation.
+ *
+ * The number of nodes can be given as the first argument, and the number
+ * of repetitions of each case as the second.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "os_time.h"
+#include "ralloc.h"
+#include "register_allocate.h"
+
+#define NUM_REGS 512
+#define MAX_LIVE 400
+
+static unsigned num_nodes = 20000;
+static unsigned num_iterations = 5;
+static uint32_t rand_state;
+
+static uint32_t
+rand_u32(void)
+{
+   /* xorshift32, reproducible across platforms */
+   rand_state ^= rand_state << 13;
+   rand_state ^= rand_state >> 17;
+   rand_state ^= rand_state << 5;
+   return rand_state;
+}
+
+static struct ra_regs *
+create_reg_set(void *mem_ctx, bool contig, struct ra_class **classes)
+{
+   struct ra_regs *regs = ra_alloc_reg_set(mem_ctx, NUM_REGS, true);
+
+   if (contig) {
+      /* Sizes 1, 2 and 4 at aligned offsets. */
+      for (unsigned c = 0; c < 3; c++) {
+         classes[c] = ra_alloc_contig_reg_class(regs, 1 << c);
+         for (unsigned r = 0; r + (1 << c) <= NUM_REGS; r += 1 << c)
+            ra_class_add_reg(classes[c], r);
+      }
+   } else {
+      /* 256 single registers, 128 pairs aliasing them and 128 registers
+       * aliasing the pairs, all set up with transitive conflicts.
+       */
+      classes[0] = ra_alloc_reg_class(regs);
+      for (unsigned r = 0; r < 256; r++)
+         ra_class_add_reg(classes[0], r);
+
+      classes[1] = ra_alloc_reg_class(regs);
+      for (unsigned r = 0; r < 128; r++) {
+         ra_class_add_reg(classes[1], 256 + r);
+         ra_add_transitive_reg_conflict(regs, 2 * r, 256 + r);
+         ra_add_transitive_reg_conflict(regs, 2 * r + 1, 256 + r);
+      }
+
+      classes[2] = ra_alloc_reg_class(regs);
+      for (unsigned r = 0; r < 128; r++) {
+         ra_class_add_reg(classes[2], 384 + r);
+         ra_add_transitive_reg_conflict(regs, 256 + r, 384 + r);
+      }
+   }
+
+   ra_set_finalize(regs, NULL);
+
+   return regs;
+}
+
+/* Nodes start at evenly spaced instructions and stay live for a random
+ * number of them; every pair of overlapping nodes interferes.
+ */
+static struct ra_graph *
+create_graph(struct ra_regs *regs, struct ra_class **classes, unsigned *start,
+             unsigned *end)
+{
+   struct ra_graph *g = ra_alloc_interference_graph(regs, num_nodes);
+
+   rand_state = 1;
+   for (unsigned n = 0; n < num_nodes; n++) {
+      start[n] = n * 2;
+      end[n] = start[n] + 1 + rand_u32() % MAX_LIVE;
+      ra_set_node_class(g, n, classes[rand_u32() % 3]);
+      ra_set_node_spill_cost(g, n, 1.0f);
+   }
+
+   for (unsigned a = 0; a < num_nodes; a++) {
+      for (unsigned b = a + 1; b < num_nodes && start[b] < end[a]; b++)
+         ra_add_node_interference(g, a, b);
+   }
+
+   return g;
+}
+
+static void
+bench_allocate(bool contig, bool round_robin)
+{
+   void *mem_ctx = ralloc_context(NULL);
+   unsigned *start = malloc(num_nodes * sizeof(*start));
+   unsigned *end = malloc(num_nodes * sizeof(*end));
+   struct ra_class *classes[3];
+   int64_t total = 0;
+   bool success = false;
+
+   struct ra_regs *regs = create_reg_set(mem_ctx, contig, classes);
+   if (round_robin)
+      ra_set_allocate_round_robin(regs);
+
+   for (unsigned i = 0; i < num_iterations; i++) {
+      struct ra_graph *g = create_graph(regs, classes, start, end);
+
+      int64_t begin = os_time_get_nano();
+      success = ra_allocate(g);
+      total += os_time_get_nano() - begin;
+
+      ralloc_free(g);
+   }
+
+   printf("%-10s %-11s %10.2f ms/allocation (%s)\n",
+          contig ? "contig" : "conflicts",
+          round_robin ? "round-robin" : "dense",
+          (double)total / num_iterations / 1000000.0,
+          success ? "colored" : "spilled");
+
+   free(start);
+   free(end);
+   ralloc_free(mem_ctx);
+}
+
+int
+main(int argc, char **argv)
+{
+   if (argc > 1)
+      num_nodes = strtoul(argv[1], NULL, 0);
+   if (argc > 2)
+      num_iterations = strtoul(argv[2], NULL, 0);
+
+   for (unsigned contig = 0; contig < 2; contig++) {
+      for (unsigned round_robin = 0; round_robin < 2; round_robin++)
+         bench_allocate(contig, round_robin);
+   }
+
+   return 0;
+}
@@ -279,3 +279,75 @@ TEST_F(ra_test, serialization_roundtrip)
    blob_finish(&blob);
 }
 
+
+/* Builds the interference graph of a large number of randomly placed live
+ * ranges of 1, 2 and 4 registers, as a backend would for a long shader, and
+ * checks that the allocation doesn't assign conflicting registers to
+ * interfering nodes.
+ */
+static void
+allocate_large_graph(void *mem_ctx, bool round_robin)
+{
+   const unsigned num_regs = 128;
+   const unsigned num_nodes = 20000;
+   const unsigned num_ips = 40000;
+
+   struct ra_regs *regs = ra_alloc_reg_set(mem_ctx, num_regs, false);
+   if (round_robin)
+      ra_set_allocate_round_robin(regs);
+
+   struct ra_class *classes[3];
+   for (unsigned c = 0; c < 3; c++) {
+      classes[c] = ra_alloc_contig_reg_class(regs, 1 << c);
+      for (unsigned r = 0; r + (1 << c) <= num_regs; r += 1 << c)
+         ra_class_add_reg(classes[c], r);
+   }
+   ra_set_finalize(regs, NULL);
+
+   struct ra_graph *g = ra_alloc_interference_graph(regs, num_nodes);
+   ralloc_steal(mem_ctx, g);
+
+   unsigned *start = ralloc_array(mem_ctx, unsigned, num_nodes);
+   unsigned *end = ralloc_array(mem_ctx, unsigned, num_nodes);
+
+   /* Live ranges are sorted by start, with a small deterministic LCG for the
+    * lengths so that the register pressure stays well below num_regs.
+    */
+   uint32_t seed = 1;
+   for (unsigned n = 0; n < num_nodes; n++) {
+      seed = seed * 1103515245 + 12345;
+      start[n] = (uint64_t)n * num_ips / num_nodes;
+      end[n] = start[n] + 1 + (seed >> 16) % 48;
+      ra_set_node_class(g, n, classes[(seed >> 8) % 3]);
+   }
+
+   for (unsigned n1 = 0; n1 < num_nodes; n1++) {
+      for (unsigned n2 = n1 + 1; n2 < num_nodes && start[n2] < end[n1]; n2++)
+         ra_add_node_interference(g, n1, n2);
+   }
+
+   ASSERT_TRUE(ra_allocate(g));
+
+   for (unsigned n1 = 0; n1 < num_nodes; n1++) {
+      struct ra_class *c1 = ra_get_node_class(g, n1);
+      unsigned r1 = ra_get_node_reg(g, n1);
+
+      ASSERT_TRUE(BITSET_TEST(c1->regs, r1));
+
+      for (unsigned n2 = n1 + 1; n2 < num_nodes && start[n2] < end[n1]; n2++) {
+         ASSERT_FALSE(ra_class_allocations_conflict(c1, r1,
+                                                    ra_get_node_class(g, n2),
+                                                    ra_get_node_reg(g, n2)));
+      }
+   }
+}
+
+TEST_F(ra_test, large_graph)
+{
+   allocate_large_graph(mem_ctx, false);
+}
+
+TEST_F(ra_test, large_graph_round_robin)
+{
+   allocate_large_graph(mem_ctx, true);
+}
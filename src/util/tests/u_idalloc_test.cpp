@@ -0,0 +1,83 @@
+/*
+ * Copyright © 2026 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <gtest/gtest.h>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "util/u_idalloc.h"
+
+/* The bits of buffer IDs that u_threaded_context hashes. */
+#define TC_ID_MASK ((1u << 14) - 1)
+
+static std::vector<unsigned>
+alloc_ids(struct util_idalloc_mt *buf, unsigned num)
+{
+   std::vector<unsigned> ids;
+
+   for (unsigned i = 0; i < num; i++)
+      ids.push_back(util_idalloc_mt_alloc(buf));
+   return ids;
+}
+
+TEST(util_idalloc_mt, tc_single_thread_is_dense)
+{
+   struct util_idalloc_mt buf;
+   util_idalloc_mt_init_tc(&buf);
+
+   /* Many more live IDs than the 2K that each shard starts apart. */
+   std::vector<unsigned> ids = alloc_ids(&buf, 8192);
+   std::set<unsigned> unique(ids.begin(), ids.end());
+   std::set<unsigned> masked;
+   for (unsigned id : ids) {
+      EXPECT_NE(id, 0u);
+      masked.insert(id & TC_ID_MASK);
+   }
+
+   EXPECT_EQ(unique.size(), ids.size());
+   EXPECT_EQ(masked.size(), ids.size());
+
+   /* Freed IDs are reused. */
+   util_idalloc_mt_free(&buf, ids[100]);
+   EXPECT_EQ(util_idalloc_mt_alloc(&buf), ids[100]);
+
+   util_idalloc_mt_fini(&buf);
+}
+
+TEST(util_idalloc_mt, tc_threads_differ_in_low_bits)
+{
+   const unsigned num_threads = 8, num_ids = 1500;
+   std::vector<std::vector<unsigned>> ids(num_threads);
+   std::vector<std::thread> threads;
+   struct util_idalloc_mt buf;
+   util_idalloc_mt_init_tc(&buf);
+
+   for (unsigned t = 0; t < num_threads; t++) {
+      threads.emplace_back([&, t] {
+         ids[t] = alloc_ids(&buf, num_ids);
+      });
+   }
+   for (std::thread &thread : threads)
+      thread.join();
+
+   std::set<unsigned> unique, masked;
+   for (const std::vector<unsigned> &thread_ids : ids) {
+      for (unsigned id : thread_ids) {
+         unique.insert(id);
+         masked.insert(id & TC_ID_MASK);
+      }
+   }
+
+   EXPECT_EQ(unique.size(), num_threads * num_ids);
+   /* The threads may share a shard, but mostly hash to different values. */
+   EXPECT_GT(masked.size(), num_threads * num_ids * 3 / 4);
+
+   for (const std::vector<unsigned> &thread_ids : ids) {
+      for (unsigned id : thread_ids)
+         util_idalloc_mt_free(&buf, id);
+   }
+   util_idalloc_mt_fini(&buf);
+}
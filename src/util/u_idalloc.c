@@ -33,7 +33,10 @@
  */
 
 #include "util/u_idalloc.h"
+#include "c11/threads.h"
+#include "util/u_atomic.h"
 #include "util/u_math.h"
+#include "util/u_memory.h"
 #include <stdlib.h>
 
 ASSERTED static bool
@@ -185,6 +188,66 @@ util_idalloc_reserve(struct util_idalloc *buf, unsigned id)
  * util_idalloc_mt
  *********************************************/
 
+/* The threaded context only hashes the low 14 bits of buffer IDs. The
+ * shards take turns owning blocks of 16K IDs, so the IDs of one thread
+ * cover all 16K hash values, like a dense allocator. Within its blocks,
+ * each shard starts at a different 2K offset, so the first IDs allocated by
+ * different threads don't hash to the same values either.
+ */
+#define IDALLOC_MT_NUM_SHARDS 8
+#define IDALLOC_MT_BLOCK_BITS 14
+#define IDALLOC_MT_SHARD_OFFSET \
+   ((1u << IDALLOC_MT_BLOCK_BITS) / IDALLOC_MT_NUM_SHARDS)
+
+/* Shards are cache line aligned to keep their locks in different cache
+ * lines.
+ */
+struct util_idalloc_mt_shard {
+   alignas(CACHE_LINE_SIZE)
+   simple_mtx_t mutex;
+   struct util_idalloc buf;
+};
+
+/* The shard IDs are mapped to, from interleaved blocks of IDs. */
+static unsigned
+shard_of_id(unsigned id)
+{
+   return (id >> IDALLOC_MT_BLOCK_BITS) % IDALLOC_MT_NUM_SHARDS;
+}
+
+static unsigned
+id_to_shard_id(unsigned id)
+{
+   unsigned shard = shard_of_id(id);
+
+   return (id >> IDALLOC_MT_BLOCK_BITS) / IDALLOC_MT_NUM_SHARDS
+          << IDALLOC_MT_BLOCK_BITS |
+          ((id - shard * IDALLOC_MT_SHARD_OFFSET) &
+           BITFIELD_MASK(IDALLOC_MT_BLOCK_BITS));
+}
+
+static unsigned
+shard_id_to_id(unsigned shard, unsigned shard_id)
+{
+   return ((shard_id >> IDALLOC_MT_BLOCK_BITS) * IDALLOC_MT_NUM_SHARDS + shard)
+          << IDALLOC_MT_BLOCK_BITS |
+          ((shard_id + shard * IDALLOC_MT_SHARD_OFFSET) &
+           BITFIELD_MASK(IDALLOC_MT_BLOCK_BITS));
+}
+
+/* Spreads threads evenly over the shards. */
+static unsigned
+get_thread_shard(void)
+{
+   static unsigned num_threads;
+   static thread_local unsigned thread_shard;
+
+   if (unlikely(!thread_shard))
+      thread_shard = p_atomic_inc_return(&num_threads);
+
+   return thread_shard % IDALLOC_MT_NUM_SHARDS;
+}
+
 void
 util_idalloc_mt_init(struct util_idalloc_mt *buf,
                      unsigned initial_num_ids, bool skip_zero)
@@ -192,6 +255,7 @@ util_idalloc_mt_init(struct util_idalloc_mt *buf,
    simple_mtx_init(&buf->mutex, mtx_plain);
    util_idalloc_init(&buf->buf, initial_num_ids);
    buf->skip_zero = skip_zero;
+   buf->shards = NULL;
 
    if (skip_zero) {
       ASSERTED unsigned zero = util_idalloc_alloc(&buf->buf);
@@ -199,16 +263,61 @@ util_idalloc_mt_init(struct util_idalloc_mt *buf,
    }
 }
 
-/* Callback for drivers using u_threaded_context (abbreviated as tc). */
+/* For allocators used by many threads at once. The initial number of IDs
+ * is split between the shards.
+ */
+void
+util_idalloc_mt_init_sharded(struct util_idalloc_mt *buf,
+                             unsigned initial_num_ids, bool skip_zero)
+{
+   unsigned shard_num_ids = MAX2(initial_num_ids / IDALLOC_MT_NUM_SHARDS, 1);
+
+   buf->shards = align_calloc(IDALLOC_MT_NUM_SHARDS * sizeof(*buf->shards),
+                              CACHE_LINE_SIZE);
+   if (!buf->shards) {
+      util_idalloc_mt_init(buf, initial_num_ids, skip_zero);
+      return;
+   }
+
+   buf->skip_zero = skip_zero;
+
+   for (unsigned i = 0; i < IDALLOC_MT_NUM_SHARDS; i++) {
+      simple_mtx_init(&buf->shards[i].mutex, mtx_plain);
+      util_idalloc_init(&buf->shards[i].buf, shard_num_ids);
+   }
+
+   /* ID 0 is the first ID of the first shard. */
+   if (skip_zero) {
+      ASSERTED unsigned zero = util_idalloc_alloc(&buf->shards[0].buf);
+      assert(zero == 0);
+   }
+}
+
+/* Callback for drivers using u_threaded_context (abbreviated as tc).
+ *
+ * Buffers are created from several threads with multiple contexts, so the
+ * allocator is sharded. The IDs of each shard still cover all values of the
+ * 14 bits that the threaded context hashes.
+ */
 void
 util_idalloc_mt_init_tc(struct util_idalloc_mt *buf)
 {
-   util_idalloc_mt_init(buf, 1 << 16, true);
+   util_idalloc_mt_init_sharded(buf, 1 << 16, true);
 }
 
 void
 util_idalloc_mt_fini(struct util_idalloc_mt *buf)
 {
+   if (buf->shards) {
+      for (unsigned i = 0; i < IDALLOC_MT_NUM_SHARDS; i++) {
+         util_idalloc_fini(&buf->shards[i].buf);
+         simple_mtx_destroy(&buf->shards[i].mutex);
+      }
+      align_free(buf->shards);
+      buf->shards = NULL;
+      return;
+   }
+
    util_idalloc_fini(&buf->buf);
    simple_mtx_destroy(&buf->mutex);
 }
@@ -216,6 +325,15 @@ util_idalloc_mt_fini(struct util_idalloc_mt *buf)
 unsigned
 util_idalloc_mt_alloc(struct util_idalloc_mt *buf)
 {
+   if (buf->shards) {
+      unsigned shard = get_thread_shard();
+
+      simple_mtx_lock(&buf->shards[shard].mutex);
+      unsigned shard_id = util_idalloc_alloc(&buf->shards[shard].buf);
+      simple_mtx_unlock(&buf->shards[shard].mutex);
+      return shard_id_to_id(shard, shard_id);
+   }
+
    simple_mtx_lock(&buf->mutex);
    unsigned id = util_idalloc_alloc(&buf->buf);
    simple_mtx_unlock(&buf->mutex);
@@ -228,6 +346,15 @@ util_idalloc_mt_free(struct util_idalloc_mt *buf, unsigned id)
    if (id == 0 && buf->skip_zero)
       return;
 
+   if (buf->shards) {
+      unsigned shard = shard_of_id(id);
+
+      simple_mtx_lock(&buf->shards[shard].mutex);
+      util_idalloc_free(&buf->shards[shard].buf, id_to_shard_id(id));
+      simple_mtx_unlock(&buf->shards[shard].mutex);
+      return;
+   }
+
    simple_mtx_lock(&buf->mutex);
    util_idalloc_free(&buf->buf, id);
    simple_mtx_unlock(&buf->mutex);
@@ -85,17 +85,30 @@ util_idalloc_reserve(struct util_idalloc *buf, unsigned id);
          if ((_bit = u_bit_scan(&_mask), id = _i * 32 + _bit), \
              (buf)->data[_i] & BITFIELD_BIT(_bit))
 
-/* Thread-safe variant. */
+struct util_idalloc_mt_shard;
+
+/* Thread-safe variant.
+ *
+ * A sharded allocator splits the IDs between several allocators, each with
+ * its own lock, and threads allocate from different shards. Each shard owns
+ * interleaved blocks of 16K consecutive IDs, so the IDs are less dense, but
+ * the IDs of one thread still cover all values of their low 14 bits.
+ */
 struct util_idalloc_mt {
    struct util_idalloc buf;
    simple_mtx_t mutex;
    bool skip_zero;
+   struct util_idalloc_mt_shard *shards; /* NULL if not sharded */
 };
 
 void
 util_idalloc_mt_init(struct util_idalloc_mt *buf,
                      unsigned initial_num_ids, bool skip_zero);
 
+void
+util_idalloc_mt_init_sharded(struct util_idalloc_mt *buf,
+                             unsigned initial_num_ids, bool skip_zero);
+
 void
 util_idalloc_mt_init_tc(struct util_idalloc_mt *buf);
 
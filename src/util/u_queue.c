@@ -27,8 +27,10 @@
 #include "u_queue.h"
 
 #include "c11/threads.h"
+#include "util/u_atomic.h"
 #include "util/u_cpu_detect.h"
 #include "util/os_time.h"
+#include "util/simple_mtx.h"
 #include "util/u_string.h"
 #include "util/u_thread.h"
 #include "util/timespec.h"
@@ -222,6 +224,62 @@ util_queue_fence_destroy(struct util_queue_fence *fence)
 }
 #endif
 
+/****************************************************************************
+ * Threads shared by all queues created with UTIL_QUEUE_INIT_USE_SHARED_THREADS
+ *
+ * Such queues don't have any threads or jobs of their own. Their jobs are
+ * added to a process-wide queue, which remembers the queue each job belongs
+ * to, so that the queue can wait for its own jobs and keep statistics. This
+ * avoids every subsystem spawning its own set of mostly idle threads.
+ */
+
+static simple_mtx_t shared_queue_mtx = SIMPLE_MTX_INITIALIZER;
+static struct util_queue shared_queue;
+static unsigned shared_queue_refcount;
+
+static struct util_queue *
+shared_queue_ref(void)
+{
+   struct util_queue *queue = &shared_queue;
+
+   simple_mtx_lock(&shared_queue_mtx);
+   if (!shared_queue_refcount &&
+       !util_queue_init(&shared_queue, "shared", 32,
+                        MAX2(util_get_cpu_caps()->nr_cpus, 1),
+                        UTIL_QUEUE_INIT_RESIZE_IF_FULL |
+                        UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY |
+                        UTIL_QUEUE_INIT_SET_FULL_THREAD_AFFINITY, NULL))
+      queue = NULL;
+   else
+      shared_queue_refcount++;
+   simple_mtx_unlock(&shared_queue_mtx);
+
+   return queue;
+}
+
+static void
+shared_queue_unref(void)
+{
+   simple_mtx_lock(&shared_queue_mtx);
+   assert(shared_queue_refcount);
+   if (--shared_queue_refcount == 0)
+      util_queue_destroy(&shared_queue);
+   simple_mtx_unlock(&shared_queue_mtx);
+}
+
+/* Called when a job of a queue using the shared threads has completed or
+ * has been dropped.
+ */
+static void
+util_queue_owner_job_done(struct util_queue *owner)
+{
+   mtx_lock(&owner->lock);
+   assert(owner->num_queued > 0);
+   owner->num_queued--;
+   cnd_broadcast(&owner->has_space_cond);
+   mtx_unlock(&owner->lock);
+}
+
 /****************************************************************************
  * util_queue implementation
  */
@@ -268,7 +326,7 @@ util_queue_thread_func(void *input)
       struct util_queue_job job;
 
       mtx_lock(&queue->lock);
-      assert(queue->num_queued >= 0 && queue->num_queued <= queue->max_jobs);
+      assert(queue->num_queued >= 0);
 
       /* wait if the queue is empty */
       while (thread_index < queue->num_threads && queue->num_queued == 0)
@@ -280,37 +338,73 @@ util_queue_thread_func(void *input)
          break;
       }
 
-      job = queue->jobs[queue->read_idx];
-      memset(&queue->jobs[queue->read_idx], 0, sizeof(struct util_queue_job));
-      queue->read_idx = (queue->read_idx + 1) % queue->max_jobs;
+      /* take the oldest job of the highest priority */
+      struct util_queue_ring *ring = queue->rings;
+      while (ring->num_queued == 0)
+         ring++;
 
+      job = ring->jobs[ring->read_idx];
+      memset(&ring->jobs[ring->read_idx], 0, sizeof(struct util_queue_job));
+      ring->read_idx = (ring->read_idx + 1) % ring->max_jobs;
+
+      ring->num_queued--;
       queue->num_queued--;
-      cnd_signal(&queue->has_space_cond);
+      /* Waiters may be waiting for space in any of the rings. */
+      cnd_broadcast(&queue->has_space_cond);
       if (job.job)
          queue->total_jobs_size -= job.job_size;
       mtx_unlock(&queue->lock);
 
       if (job.job) {
+         bool collect_stats =
+            (queue->flags & UTIL_QUEUE_INIT_COLLECT_STATS) ||
+            (job.owner && job.owner->flags & UTIL_QUEUE_INIT_COLLECT_STATS);
+         int64_t start = collect_stats ? os_time_get_nano() : 0;
+
          job.execute(job.job, job.global_data, thread_index);
          if (job.fence)
             util_queue_fence_signal(job.fence);
          if (job.cleanup)
             job.cleanup(job.job, job.global_data, thread_index);
+
+         if (unlikely(collect_stats)) {
+            int64_t busy_time = os_time_get_nano() - start;
+
+            if (queue->flags & UTIL_QUEUE_INIT_COLLECT_STATS) {
+               p_atomic_inc(&queue->stats.num_jobs);
+               p_atomic_add(&queue->stats.busy_time_ns, busy_time);
+            }
+            if (job.owner &&
+                job.owner->flags & UTIL_QUEUE_INIT_COLLECT_STATS) {
+               p_atomic_inc(&job.owner->stats.num_jobs);
+               p_atomic_add(&job.owner->stats.busy_time_ns, busy_time);
+            }
+         }
+
+         if (job.owner)
+            util_queue_owner_job_done(job.owner);
       }
    }
 
    /* signal remaining jobs if all threads are being terminated */
    mtx_lock(&queue->lock);
    if (queue->num_threads == 0) {
-      for (unsigned i = queue->read_idx; i != queue->write_idx;
-           i = (i + 1) % queue->max_jobs) {
-         if (queue->jobs[i].job) {
-            if (queue->jobs[i].fence)
-               util_queue_fence_signal(queue->jobs[i].fence);
-            queue->jobs[i].job = NULL;
+      for (unsigned p = 0; p < UTIL_QUEUE_NUM_PRIORITIES; p++) {
+         struct util_queue_ring *ring = &queue->rings[p];
+
+         for (unsigned i = ring->read_idx; i != ring->write_idx;
+              i = (i + 1) % ring->max_jobs) {
+            if (ring->jobs[i].job) {
+               if (ring->jobs[i].fence)
+                  util_queue_fence_signal(ring->jobs[i].fence);
+               if (ring->jobs[i].owner)
+                  util_queue_owner_job_done(ring->jobs[i].owner);
+               ring->jobs[i].job = NULL;
+            }
          }
+         ring->read_idx = ring->write_idx;
+         ring->num_queued = 0;
       }
-      queue->read_idx = queue->write_idx;
       queue->num_queued = 0;
    }
    mtx_unlock(&queue->lock);
@@ -351,6 +445,10 @@ void
 util_queue_adjust_num_threads(struct util_queue *queue, unsigned num_threads,
                               bool locked)
 {
+   /* The shared threads are managed by the shared queue. */
+   if (queue->shared)
+      return;
+
    num_threads = MIN2(num_threads, queue->max_threads);
    num_threads = MAX2(num_threads, 1);
 
@@ -427,11 +525,25 @@ util_queue_init(struct util_queue *queue,
       snprintf(queue->name, sizeof(queue->name), "%s", name);
    }
 
+   if (flags & UTIL_QUEUE_INIT_USE_SHARED_THREADS) {
+      queue->shared = shared_queue_ref();
+      if (!queue->shared) {
+         memset(queue, 0, sizeof(*queue));
+         return false;
+      }
+
+      queue->flags = flags;
+      queue->global_data = global_data;
+      (void) mtx_init(&queue->lock, mtx_plain);
+      cnd_init(&queue->has_queued_cond);
+      cnd_init(&queue->has_space_cond);
+      return true;
+   }
+
    queue->create_threads_on_demand = true;
    queue->flags = flags;
    queue->max_threads = num_threads;
    queue->num_threads = 1;
-   queue->max_jobs = max_jobs;
    queue->global_data = global_data;
 
    (void) mtx_init(&queue->lock, mtx_plain);
@@ -440,10 +552,13 @@ util_queue_init(struct util_queue *queue,
    cnd_init(&queue->has_queued_cond);
    cnd_init(&queue->has_space_cond);
 
-   queue->jobs = (struct util_queue_job*)
-                 calloc(max_jobs, sizeof(struct util_queue_job));
-   if (!queue->jobs)
-      goto fail;
+   for (i = 0; i < UTIL_QUEUE_NUM_PRIORITIES; i++) {
+      queue->rings[i].max_jobs = max_jobs;
+      queue->rings[i].jobs = (struct util_queue_job*)
+                             calloc(max_jobs, sizeof(struct util_queue_job));
+      if (!queue->rings[i].jobs)
+         goto fail;
+   }
 
    queue->threads = (thrd_t*) calloc(queue->max_threads, sizeof(thrd_t));
    if (!queue->threads)
@@ -469,12 +584,12 @@ util_queue_init(struct util_queue *queue,
 fail:
    free(queue->threads);
 
-   if (queue->jobs) {
-      cnd_destroy(&queue->has_space_cond);
-      cnd_destroy(&queue->has_queued_cond);
-      mtx_destroy(&queue->lock);
-      free(queue->jobs);
-   }
+   cnd_destroy(&queue->has_space_cond);
+   cnd_destroy(&queue->has_queued_cond);
+   mtx_destroy(&queue->lock);
+   for (i = 0; i < UTIL_QUEUE_NUM_PRIORITIES; i++)
+      free(queue->rings[i].jobs);
+
    /* also util_queue_is_initialized can be used to check for success */
    memset(queue, 0, sizeof(*queue));
    return false;
@@ -526,6 +641,12 @@ util_queue_finish_execute(void *data, void *gdata, int num_thread)
 void
 util_queue_destroy(struct util_queue *queue)
 {
+   if (queue->shared) {
+      /* The shared threads may still reference the queue. */
+      util_queue_finish(queue);
+      shared_queue_unref();
+   }
+
    util_queue_kill_threads(queue, 0, false);
 
    /* This makes it safe to call on a queue that failed util_queue_init. */
@@ -535,19 +656,23 @@ util_queue_destroy(struct util_queue *queue)
    cnd_destroy(&queue->has_space_cond);
    cnd_destroy(&queue->has_queued_cond);
    mtx_destroy(&queue->lock);
-   free(queue->jobs);
+   for (unsigned i = 0; i < UTIL_QUEUE_NUM_PRIORITIES; i++)
+      free(queue->rings[i].jobs);
    free(queue->threads);
 }
 
-static void
+static bool
 util_queue_add_job_locked(struct util_queue *queue,
+                          struct util_queue *owner,
                           void *job,
                           struct util_queue_fence *fence,
                           util_queue_execute_func execute,
                           util_queue_execute_func cleanup,
                           const size_t job_size,
+                          enum util_queue_priority priority,
                           bool locked)
 {
+   struct util_queue_ring *ring = &queue->rings[priority];
    struct util_queue_job *ptr;
 
    if (!locked)
@@ -558,13 +683,13 @@ util_queue_add_job_locked(struct util_queue *queue,
       /* well no good option here, but any leaks will be
        * short-lived as things are shutting down..
        */
-      return;
+      return false;
    }
 
    if (fence)
       util_queue_fence_reset(fence);
 
-   assert(queue->num_queued >= 0 && queue->num_queued <= queue->max_jobs);
+   assert(ring->num_queued >= 0 && ring->num_queued <= ring->max_jobs);
 
    /* Scale the number of threads up if there's already one job waiting. */
    if (queue->num_queued > 0 &&
@@ -574,13 +699,13 @@ util_queue_add_job_locked(struct util_queue *queue,
       util_queue_adjust_num_threads(queue, queue->num_threads + 1, true);
    }
 
-   if (queue->num_queued == queue->max_jobs) {
+   if (ring->num_queued == ring->max_jobs) {
       if (queue->flags & UTIL_QUEUE_INIT_RESIZE_IF_FULL &&
           queue->total_jobs_size + job_size < S_256MB) {
          /* If the queue is full, make it larger to avoid waiting for a free
           * slot.
           */
-         unsigned new_max_jobs = queue->max_jobs + 8;
+         unsigned new_max_jobs = ring->max_jobs + 8;
          struct util_queue_job *jobs =
             (struct util_queue_job*)calloc(new_max_jobs,
                                            sizeof(struct util_queue_job));
@@ -588,43 +713,67 @@ util_queue_add_job_locked(struct util_queue *queue,
 
          /* Copy all queued jobs into the new list. */
          unsigned num_jobs = 0;
-         unsigned i = queue->read_idx;
+         unsigned i = ring->read_idx;
 
          do {
-            jobs[num_jobs++] = queue->jobs[i];
-            i = (i + 1) % queue->max_jobs;
-         } while (i != queue->write_idx);
+            jobs[num_jobs++] = ring->jobs[i];
+            i = (i + 1) % ring->max_jobs;
+         } while (i != ring->write_idx);
 
-         assert(num_jobs == queue->num_queued);
+         assert(num_jobs == ring->num_queued);
 
-         free(queue->jobs);
-         queue->jobs = jobs;
-         queue->read_idx = 0;
-         queue->write_idx = num_jobs;
-         queue->max_jobs = new_max_jobs;
+         free(ring->jobs);
+         ring->jobs = jobs;
+         ring->read_idx = 0;
+         ring->write_idx = num_jobs;
+         ring->max_jobs = new_max_jobs;
       } else {
          /* Wait until there is a free slot. */
-         while (queue->num_queued == queue->max_jobs)
+         while (ring->num_queued == ring->max_jobs)
             cnd_wait(&queue->has_space_cond, &queue->lock);
       }
    }
 
-   ptr = &queue->jobs[queue->write_idx];
+   ptr = &ring->jobs[ring->write_idx];
    assert(ptr->job == NULL);
    ptr->job = job;
-   ptr->global_data = queue->global_data;
+   ptr->global_data = owner ? owner->global_data : queue->global_data;
+   ptr->owner = owner;
    ptr->fence = fence;
    ptr->execute = execute;
    ptr->cleanup = cleanup;
    ptr->job_size = job_size;
 
-   queue->write_idx = (queue->write_idx + 1) % queue->max_jobs;
+   ring->write_idx = (ring->write_idx + 1) % ring->max_jobs;
    queue->total_jobs_size += ptr->job_size;
 
+   ring->num_queued++;
    queue->num_queued++;
    cnd_signal(&queue->has_queued_cond);
    if (!locked)
       mtx_unlock(&queue->lock);
+   return true;
+}
+
+static void
+util_queue_add_shared_job(struct util_queue *queue,
+                          void *job,
+                          struct util_queue_fence *fence,
+                          util_queue_execute_func execute,
+                          util_queue_execute_func cleanup,
+                          const size_t job_size,
+                          enum util_queue_priority priority)
+{
+   /* Count the job before it's visible to the shared threads, so that
+    * util_queue_finish can't miss it.
+    */
+   mtx_lock(&queue->lock);
+   queue->num_queued++;
+   mtx_unlock(&queue->lock);
+
+   if (!util_queue_add_job_locked(queue->shared, queue, job, fence, execute,
+                                  cleanup, job_size, priority, false))
+      util_queue_owner_job_done(queue);
 }
 
 void
@@ -635,8 +784,27 @@ util_queue_add_job(struct util_queue *queue,
                    util_queue_execute_func cleanup,
                    const size_t job_size)
 {
-   util_queue_add_job_locked(queue, job, fence, execute, cleanup, job_size,
-                             false);
+   util_queue_add_job_with_priority(queue, job, fence, execute, cleanup,
+                                    job_size, UTIL_QUEUE_PRIORITY_NORMAL);
+}
+
+void
+util_queue_add_job_with_priority(struct util_queue *queue,
+                                 void *job,
+                                 struct util_queue_fence *fence,
+                                 util_queue_execute_func execute,
+                                 util_queue_execute_func cleanup,
+                                 const size_t job_size,
+                                 enum util_queue_priority priority)
+{
+   if (queue->shared) {
+      util_queue_add_shared_job(queue, job, fence, execute, cleanup, job_size,
+                                priority);
+      return;
+   }
+
+   util_queue_add_job_locked(queue, NULL, job, fence, execute, cleanup,
+                             job_size, priority, false);
 }
 
 /**
@@ -652,26 +820,39 @@ util_queue_add_job(struct util_queue *queue,
 void
 util_queue_drop_job(struct util_queue *queue, struct util_queue_fence *fence)
 {
+   struct util_queue *owner = queue->shared ? queue : NULL;
    bool removed = false;
 
    if (util_queue_fence_is_signalled(fence))
       return;
 
+   /* The jobs of queues using the shared threads are in the shared queue. */
+   if (queue->shared)
+      queue = queue->shared;
+
    mtx_lock(&queue->lock);
-   for (unsigned i = queue->read_idx; i != queue->write_idx;
-        i = (i + 1) % queue->max_jobs) {
-      if (queue->jobs[i].fence == fence) {
-         if (queue->jobs[i].cleanup)
-            queue->jobs[i].cleanup(queue->jobs[i].job, queue->global_data, -1);
-
-         /* Just clear it. The threads will treat as a no-op job. */
-         memset(&queue->jobs[i], 0, sizeof(queue->jobs[i]));
-         removed = true;
-         break;
+   for (unsigned p = 0; p < UTIL_QUEUE_NUM_PRIORITIES && !removed; p++) {
+      struct util_queue_ring *ring = &queue->rings[p];
+
+      for (unsigned i = ring->read_idx; i != ring->write_idx;
+           i = (i + 1) % ring->max_jobs) {
+         if (ring->jobs[i].fence == fence && ring->jobs[i].owner == owner) {
+            if (ring->jobs[i].cleanup)
+               ring->jobs[i].cleanup(ring->jobs[i].job,
+                                     ring->jobs[i].global_data, -1);
+
+            /* Just clear it. The threads will treat as a no-op job. */
+            memset(&ring->jobs[i], 0, sizeof(ring->jobs[i]));
+            removed = true;
+            break;
+         }
       }
    }
    mtx_unlock(&queue->lock);
 
+   if (removed && owner)
+      util_queue_owner_job_done(owner);
+
    if (removed)
       util_queue_fence_signal(fence);
    else
@@ -687,6 +868,18 @@ util_queue_finish(struct util_queue *queue)
    util_barrier barrier;
    struct util_queue_fence *fences;
 
+   /* Wait for the jobs of this queue only, the shared threads may be busy
+    * with jobs of other queues. This also waits for jobs added while
+    * waiting.
+    */
+   if (queue->shared) {
+      mtx_lock(&queue->lock);
+      while (queue->num_queued)
+         cnd_wait(&queue->has_space_cond, &queue->lock);
+      mtx_unlock(&queue->lock);
+      return;
+   }
+
    /* If 2 threads were adding jobs for 2 different barries at the same time,
     * a deadlock would happen, because 1 barrier requires that all threads
     * wait for it exclusively.
@@ -710,10 +903,14 @@ util_queue_finish(struct util_queue *queue)
    fences = malloc(queue->num_threads * sizeof(*fences));
    util_barrier_init(&barrier, queue->num_threads);
 
+   /* The barrier jobs have the lowest priority, so that they are only
+    * executed after all jobs added before them.
+    */
    for (unsigned i = 0; i < queue->num_threads; ++i) {
       util_queue_fence_init(&fences[i]);
-      util_queue_add_job_locked(queue, &barrier, &fences[i],
-                                util_queue_finish_execute, NULL, 0, true);
+      util_queue_add_job_locked(queue, NULL, &barrier, &fences[i],
+                                util_queue_finish_execute, NULL, 0,
+                                UTIL_QUEUE_PRIORITY_LOW, true);
    }
    queue->create_threads_on_demand = true;
    mtx_unlock(&queue->lock);
@@ -735,3 +932,10 @@ util_queue_get_thread_time_nano(struct util_queue *queue, unsigned thread_index)
 
    return util_thread_get_time_nano(queue->threads[thread_index]);
 }
+
+void
+util_queue_get_stats(struct util_queue *queue, struct util_queue_stats *stats)
+{
+   stats->num_jobs = p_atomic_read(&queue->stats.num_jobs);
+   stats->busy_time_ns = p_atomic_read(&queue->stats.busy_time_ns);
+}
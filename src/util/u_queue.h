@@ -51,6 +51,27 @@ extern "C" {
 #define UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY      (1 << 0)
 #define UTIL_QUEUE_INIT_RESIZE_IF_FULL            (1 << 1)
 #define UTIL_QUEUE_INIT_SET_FULL_THREAD_AFFINITY  (1 << 2)
+/* Don't create threads for this queue, execute its jobs on the threads of
+ * a process-wide queue shared by all queues created with this flag. The
+ * shared threads have the minimum priority, the full thread affinity and
+ * their queue is resized when full. num_threads and max_jobs are ignored,
+ * and the thread index passed to jobs is the index of the shared thread.
+ */
+#define UTIL_QUEUE_INIT_USE_SHARED_THREADS        (1 << 3)
+/* Count the executed jobs and the time spent executing them, see
+ * util_queue_get_stats. This reads the clock twice per job.
+ */
+#define UTIL_QUEUE_INIT_COLLECT_STATS             (1 << 4)
+
+/* Threads execute all queued jobs of a higher priority before those of a
+ * lower priority, jobs of the same priority are executed in order.
+ */
+enum util_queue_priority {
+   UTIL_QUEUE_PRIORITY_HIGH,
+   UTIL_QUEUE_PRIORITY_NORMAL,
+   UTIL_QUEUE_PRIORITY_LOW,
+   UTIL_QUEUE_NUM_PRIORITIES,
+};
 
 #if UTIL_FUTEX_SUPPORTED
 #define UTIL_QUEUE_FENCE_FUTEX
@@ -218,6 +239,20 @@ struct util_queue_job {
    struct util_queue_fence *fence;
    util_queue_execute_func execute;
    util_queue_execute_func cleanup;
+   struct util_queue *owner; /* the queue the job was added to, if shared */
+};
+
+struct util_queue_stats {
+   uint64_t num_jobs;       /* number of executed jobs */
+   uint64_t busy_time_ns;   /* time spent executing them */
+};
+
+/* Jobs of one priority. */
+struct util_queue_ring {
+   int num_queued;
+   int max_jobs;
+   int write_idx, read_idx; /* ring buffer pointers */
+   struct util_queue_job *jobs;
 };
 
 /* Put this into your context. */
@@ -229,15 +264,20 @@ struct util_queue {
    cnd_t has_space_cond;
    thrd_t *threads;
    unsigned flags;
-   int num_queued;
+   int num_queued; /* sum over all rings */
    unsigned max_threads;
    unsigned num_threads; /* decreasing this number will terminate threads */
-   int max_jobs;
-   int write_idx, read_idx; /* ring buffer pointers */
    size_t total_jobs_size;  /* memory use of all jobs in the queue */
-   struct util_queue_job *jobs;
+   struct util_queue_ring rings[UTIL_QUEUE_NUM_PRIORITIES];
    void *global_data;
 
+   /* The queue executing the jobs with UTIL_QUEUE_INIT_USE_SHARED_THREADS.
+    * num_queued then counts the jobs that haven't completed.
+    */
+   struct util_queue *shared;
+
+   struct util_queue_stats stats;
+
    /* for cleanup at exit(), protected by exit_mutex */
    struct list_head head;
 };
@@ -257,6 +297,13 @@ void util_queue_add_job(struct util_queue *queue,
                         util_queue_execute_func execute,
                         util_queue_execute_func cleanup,
                         const size_t job_size);
+void util_queue_add_job_with_priority(struct util_queue *queue,
+                                      void *job,
+                                      struct util_queue_fence *fence,
+                                      util_queue_execute_func execute,
+                                      util_queue_execute_func cleanup,
+                                      const size_t job_size,
+                                      enum util_queue_priority priority);
 void util_queue_drop_job(struct util_queue *queue,
                          struct util_queue_fence *fence);
 
@@ -273,11 +320,14 @@ util_queue_adjust_num_threads(struct util_queue *queue, unsigned num_threads,
 int64_t util_queue_get_thread_time_nano(struct util_queue *queue,
                                         unsigned thread_index);
 
+void util_queue_get_stats(struct util_queue *queue,
+                          struct util_queue_stats *stats);
+
 /* util_queue needs to be cleared to zeroes for this to work */
 static inline bool
 util_queue_is_initialized(struct util_queue *queue)
 {
-   return queue->threads != NULL;
+   return queue->threads != NULL || queue->shared != NULL;
 }
 
 /* Convenient structure for monitoring the queue externally and passing
@@ -293,6 +343,13 @@ struct util_queue_monitoring
    unsigned num_direct_items;
    unsigned num_syncs;
    unsigned num_batches;
+
+   /* Why the producer waited for the consumer. num_syncs includes
+    * num_call_syncs, which are the syncs required by API calls.
+    */
+   unsigned num_call_syncs;
+   unsigned num_partial_syncs; /* waits for a specific earlier item */
+   unsigned stall_time_us;     /* waits for a free slot in the queue */
 };
 
 #ifdef __cplusplus